@@ -0,0 +1,63 @@
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "cache.h"
+
+#include "../common/l2_trace.h"
+
+/*
+Capture-only module: an L2 "prefetcher" that never issues, it only records the access stream.
+
+Every access is written to <Capture_dir>/<cache name>.l2t in the packed format of common/l2_trace.h, or to the
+directory named by the CAPTURE_DIR environment variable. Since nothing is prefetched, the hit bits are those of the
+cache with no prefetcher, which is what ORACLE/oracle.cc needs to find the misses to come and what tools/replay
+should be fed. LSTM/lstm.cc's Capture_trace records the same format, but with LSTM's own prefetches in the hit bits
+once a model is loaded, so use it for training data only.
+*/
+
+namespace {
+
+const std::string Capture_dir = "traces";           // Unless CAPTURE_DIR is set, the directory oracle.cc reads
+
+std::map<CACHE*, std::unique_ptr<l2_trace_writer>> writers;
+
+} // namespace
+
+void CACHE::prefetcher_initialize() {
+    const char* env_dir = std::getenv("CAPTURE_DIR");
+    std::string path = (env_dir != nullptr ? env_dir : Capture_dir) + "/" + NAME + ".l2t";
+    std::unique_ptr<l2_trace_writer>& writer = ::writers[this];
+    writer = std::make_unique<l2_trace_writer>();
+    if (!writer->open(path)) {
+        std::cerr << "Could not create trace capture file " << path << std::endl;
+    }
+}
+
+void CACHE::prefetcher_cycle_operate() {}
+
+uint32_t CACHE::prefetcher_cache_operate(uint64_t addr, uint64_t ip, uint8_t cache_hit, bool useful_prefetch, uint8_t type, uint32_t metadata_in) {
+    l2_trace_writer& writer = *::writers[this];
+    if (writer.is_open()) {
+        writer.append(addr, ip, current_cycle, type, cache_hit);
+    }
+    return metadata_in;
+}
+
+uint32_t CACHE::prefetcher_cache_fill(uint64_t addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_addr, uint32_t metadata_in) {
+    return metadata_in;
+}
+
+void CACHE::prefetcher_final_stats() {
+    l2_trace_writer& writer = *::writers[this];
+    if (!writer.is_open()) {
+        return;
+    }
+    writer.close();
+    std::cout << "----- capture " << NAME << " -----\n";
+    std::cout << "Captured Trace Records: " << writer.records() << "\n";
+    std::cout << "Capture Buffer Full Waits: " << writer.full_waits << "\n";
+}
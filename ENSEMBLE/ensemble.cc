@@ -0,0 +1,386 @@
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include "cache.h"
+
+#include "../MISB/misb.h"
+#include "../TCP/tcp.h"
+#include "../T_SKID/t_skid.h"
+#include "../common/pf_candidate_queue.h"
+#include "../common/pf_component.h"
+#include "../common/pf_issue.h"
+#include "../common/pf_placement.h"
+#include "../common/pf_profile.h"
+#include "../common/pf_row_filter.h"
+#include "../common/pf_stats.h"
+
+/*
+Ensemble prefetcher: runs TCP, MISB and T-SKID side by side on one cache and lets an arbiter decide whose
+candidates get prefetch slots.
+
+Every component sees every access and fill and keeps training, whatever the arbiter does. Its candidates go through
+an arbiter_issuer, which refuses the ones the current policy does not allow, so a component that is not selected
+behaves as if the prefetch queue was full. The arbiter learns from usefulness feedback: the component that issued a
+line is remembered, a demand hit on it (useful_prefetch) credits that component and an eviction before any use
+charges it.
+
+Two policies, picked with Arbitration:
+  SET_DUELING  Every Leader_spacing-th set is a leader set of one component, and only that component may prefetch
+               on accesses to it. Each epoch of Epoch_accesses, the component with the best (useful - useless) score
+               from its own leader sets wins the follower sets, which are all other sets. Scores are halved at the end
+               of each epoch, so the winner follows program phases.
+  BANDIT       Discounted UCB1 over the components. For an epoch of Bandit_epoch_accesses one component prefetches
+               for every set. Its reward is the share of that epoch's demand misses it covered.
+Each access gets at most Slots_per_access prefetches, across all components.
+
+Candidates first go through the issue filter (common/pf_issue.h), so null and redundant ones never take a slot.
+Candidates the arbiter allows then go through the DRAM row filter (common/pf_row_filter.h), which reports the row
+activations of each component. The ones the cache refuses wait in the candidate queue (common/pf_candidate_queue.h),
+which all components share and retry in confidence order. Whether a candidate fills this level or the next is decided
+per candidate by the placement policy (common/pf_placement.h), from its confidence and the triggering PC. A
+candidate the row filter delays or the queue holds takes its slot at once, but only counts as issued, for the
+component's score, the issue filter and the quality stats, once the ensemble hears it went out (held_outcome).
+
+Build it in place of a single prefetcher module. Per component statistics are exported as ensemble_<component>,
+see common/pf_stats.h.
+*/
+
+enum class arbiter_policy { SET_DUELING, BANDIT };
+const arbiter_policy Arbitration = arbiter_policy::SET_DUELING;   // How the arbiter picks which component prefetches
+
+const int Num_components = 3;
+const int Slots_per_access = 4;                     // Prefetches issued per access, over all components
+const uint32_t Leader_spacing = 32;                 // One in this many sets leads for each component (set dueling)
+const uint64_t Epoch_accesses = 16384;              // Accesses between winner updates (set dueling)
+const uint64_t Bandit_epoch_accesses = 4096;        // Accesses each bandit pull lasts
+const double Bandit_discount = 0.95;                // Weight kept by past rewards at each pull
+const double Bandit_exploration = 0.5;              // UCB exploration constant
+const std::size_t Owner_table_size = 4096;          // Issued lines remembered for credit (power of two)
+
+const char* const Component_names[Num_components] = {"tcp", "misb", "t_skid"};
+
+struct ensemble : pf_held_listener {
+    struct owner_entry {
+        uint64_t line = 0;                          // Line number + 1, 0 is empty
+        int component = 0;
+        bool leader = false;                        // Issued on an access to the component's leader set
+    };
+
+    // Per component feedback and counters
+    struct component_score {
+        double score = 0;                           // Set dueling: decayed useful - useless from leader sets
+        uint64_t epoch_useful = 0;                  // Bandit: useful prefetches credited during the current pull
+        double reward_sum = 0;                      // Bandit: discounted reward
+        double pulls = 0;                           // Bandit: discounted number of pulls
+        uint64_t issued = 0;                        // Accepted by prefetch_line, at once or on a retry
+        uint64_t refused = 0;                       // Candidates the arbiter did not allow
+        uint64_t useful = 0;
+        uint64_t useless = 0;
+        uint64_t epochs_won = 0;
+    };
+
+    // Passes a component's candidates to the cache if the arbiter allows them
+    // Every candidate it is handed is recorded in the ensemble's quality stats, a refused one as dropped
+    class arbiter_issuer : public pf_issuer {
+    public:
+        arbiter_issuer(ensemble& owner_, CACHE* cache_, uint64_t trigger_addr_, uint64_t trigger_ip_, int component_, bool allowed_, bool leader_)
+            : owner(owner_), cache(cache_), trigger_addr(trigger_addr_), trigger_ip(trigger_ip_), component(component_), allowed(allowed_),
+              leader(leader_) {}
+
+        pf_issue_result issue(uint64_t pf_addr, bool fill_this_level, uint32_t metadata, int confidence) override {
+            pf_issue_result result = arbitrate(pf_addr, fill_this_level, metadata, confidence);
+            owner.stats.on_prefetch(cache->warmup, pf_addr, trigger_ip, result);
+            return result;
+        }
+
+    private:
+        ensemble& owner;
+        CACHE* cache;
+        uint64_t trigger_addr;
+        uint64_t trigger_ip;
+        int component;
+        bool allowed;
+        bool leader;
+
+        pf_issue_result arbitrate(uint64_t pf_addr, bool fill_this_level, uint32_t metadata, int confidence) {
+            if (!allowed || owner.slots_left == 0) {
+                owner.scores[component].refused++;
+                return pf_issue_result::REFUSED;
+            }
+            pf_cache_issuer to_cache(cache);
+            pf_candidate_queue_issuer to_queue(owner.candidate_queue, to_cache, cache->current_cycle, trigger_addr, trigger_ip, component);
+            pf_issue_result result = owner.row_filter.issue(to_queue, cache->current_cycle, trigger_ip, component, pf_addr, fill_this_level, metadata,
+                                                            confidence);
+            if (result == pf_issue_result::REFUSED) {
+                return result;
+            }
+            owner.slots_left--;
+            if (result == pf_issue_result::ISSUED) {
+                owner.scores[component].issued++;
+            }
+            owner.owner_of(pf_addr) = {line_key(pf_addr), component, leader};
+            return result;
+        }
+    };
+
+    tcp::TagCorrelatingPrefetcher tcp_component{"ensemble_tcp"};
+    misb::MISBPrefetcher misb_component{"ensemble_misb"};
+    t_skid::tracker t_skid_component{"ensemble_t_skid"};
+    std::array<pf_component*, Num_components> components{&tcp_component, &misb_component, &t_skid_component};
+
+    std::array<component_score, Num_components> scores;
+    std::vector<owner_entry> owners = std::vector<owner_entry>(Owner_table_size);
+    int winner = 0;                                 // Component prefetching for the follower sets (or all, bandit)
+    int slots_left = 0;
+    bool warmup = false;                            // The cache's, as of the last access or cycle
+    uint64_t accesses = 0;
+    uint64_t epoch_misses = 0;                      // Demand misses in the current bandit pull
+    uint64_t total_pulls = 0;
+    pf_stats stats{"ensemble"};
+    pf_issue_filter issue_filter{{Component_names[0], Component_names[1], Component_names[2]}};
+    pf_row_filter row_filter{{Component_names[0], Component_names[1], Component_names[2]}, this};
+    pf_candidate_queue candidate_queue{{Component_names[0], Component_names[1], Component_names[2]}, this};
+    pf_placement placement{"ensemble"};
+
+    static uint64_t line_key(uint64_t addr) { return (addr >> LOG2_BLOCK_SIZE) + 1; }
+
+    owner_entry& owner_of(uint64_t addr) {
+        uint64_t line = addr >> LOG2_BLOCK_SIZE;
+        return owners[(line ^ (line >> 12)) & (Owner_table_size - 1)];
+    }
+
+    // Component whose leader set this is, or -1 for a follower set
+    int leader_of(CACHE* cache, uint64_t addr) const {
+        if (Arbitration != arbiter_policy::SET_DUELING) {
+            return -1;
+        }
+        uint32_t set = static_cast<uint32_t>((addr >> LOG2_BLOCK_SIZE) % cache->NUM_SET);
+        uint32_t slot = set % Leader_spacing;
+        return slot < Num_components ? static_cast<int>(slot) : -1;
+    }
+
+    void operate(CACHE* cache, uint64_t addr, uint64_t ip, bool cache_hit, bool useful_prefetch, uint8_t type, uint32_t metadata_in) {
+        warmup = cache->warmup;
+        stats.on_access(cache->warmup, addr, cache_hit, useful_prefetch);
+        accesses++;
+        if (!cache_hit) {
+            epoch_misses++;
+            row_filter.on_demand_miss(cache->current_cycle, addr);
+        }
+
+        // Credit the component that brought the line in, and only tell that one its prefetch was useful
+        int useful_component = -1;
+        owner_entry& entry = owner_of(addr);
+        if (useful_prefetch && entry.line == line_key(addr)) {
+            useful_component = entry.component;
+            scores[entry.component].useful++;
+            scores[entry.component].epoch_useful++;
+            if (entry.leader) {
+                scores[entry.component].score += 1;
+            }
+            entry.line = 0;
+        }
+
+        issue_filter.on_demand(addr);
+        candidate_queue.on_demand(addr);
+        placement.on_access(addr, cache_hit, useful_prefetch);
+
+        // The winner runs first so it gets the slots before anyone else
+        int leader = leader_of(cache, addr);
+        slots_left = Slots_per_access;
+        for (int n = 0; n < Num_components; ++n) {
+            int i = (winner + n) % Num_components;
+            bool allowed = leader == -1 ? i == winner : i == leader;
+            arbiter_issuer to_arbiter(*this, cache, addr, ip, i, allowed, leader == i);
+            pf_issue_filter_issuer to_filter(issue_filter, to_arbiter, addr, i);
+            pf_placement_issuer issuer(placement, to_filter, ip);
+            components[i]->operate(cache, addr, ip, cache_hit, useful_component == i, type, metadata_in, issuer);
+        }
+
+        if (Arbitration == arbiter_policy::SET_DUELING && accesses % Epoch_accesses == 0) {
+            end_dueling_epoch();
+        } else if (Arbitration == arbiter_policy::BANDIT && accesses % Bandit_epoch_accesses == 0) {
+            end_bandit_pull();
+        }
+    }
+
+    // Retries the held candidates, the candidate queue's and then the row filter's, call every cycle
+    void cycle(CACHE* cache) {
+        warmup = cache->warmup;
+        pf_cache_issuer to_cache(cache);
+        candidate_queue.cycle(to_cache, cache->current_cycle);
+        // Each retry the row filter lets out goes through the shared candidate queue as its own component's
+        row_filter.cycle([&](int source, uint64_t trigger_ip, uint64_t pf_addr, bool fill_this_level, uint32_t metadata, int confidence) {
+            return candidate_queue.issue(to_cache, cache->current_cycle, 0, trigger_ip, source, pf_addr, fill_this_level, metadata, confidence);
+        }, cache->current_cycle);
+    }
+
+    // A held candidate of component source went out or was dropped, its component's stats hear it too
+    void held_outcome(int source, uint64_t pf_addr, uint64_t trigger_ip, bool issued) override {
+        if (issued) {
+            scores[source].issued++;
+        }
+        issue_filter.on_held_outcome(source, pf_addr, issued);
+        stats.on_held_outcome(warmup, pf_addr, trigger_ip, issued);
+        if (pf_stats* component_stats = components[source]->quality_stats()) {
+            component_stats->on_held_outcome(warmup, pf_addr, trigger_ip, issued);
+        }
+    }
+
+    void fill(CACHE* cache, uint64_t addr, bool prefetch, uint64_t evicted_addr) {
+        stats.on_fill(cache->warmup, addr, prefetch, evicted_addr);
+        placement.on_fill(addr, prefetch, evicted_addr);
+        if (evicted_addr != 0) {
+            owner_entry& victim = owner_of(evicted_addr);
+            if (victim.line == line_key(evicted_addr)) {
+                scores[victim.component].useless++;
+                if (victim.leader) {
+                    scores[victim.component].score -= 1;
+                }
+                victim.line = 0;
+            }
+        }
+        for (pf_component* component : components) {
+            component->fill(cache, addr, prefetch, evicted_addr);
+        }
+    }
+
+    void end_dueling_epoch() {
+        int best = winner;
+        for (int i = 0; i < Num_components; ++i) {
+            if (scores[i].score > scores[best].score) {
+                best = i;
+            }
+        }
+        winner = best;
+        scores[winner].epochs_won++;
+        for (component_score& s : scores) {
+            s.score /= 2;
+        }
+    }
+
+    void end_bandit_pull() {
+        component_score& pulled = scores[winner];
+        double reward = epoch_misses + pulled.epoch_useful == 0 ? 0.0
+                                                                : static_cast<double>(pulled.epoch_useful) / static_cast<double>(epoch_misses + pulled.epoch_useful);
+        for (component_score& s : scores) {
+            s.reward_sum *= Bandit_discount;
+            s.pulls *= Bandit_discount;
+            s.epoch_useful = 0;
+        }
+        pulled.reward_sum += reward;
+        pulled.pulls += 1;
+        pulled.epochs_won++;
+        total_pulls++;
+        epoch_misses = 0;
+
+        // Untried components first, then the best upper confidence bound
+        int best = -1;
+        double best_bound = 0;
+        for (int i = 0; i < Num_components; ++i) {
+            if (scores[i].pulls == 0) {
+                best = i;
+                break;
+            }
+            double total = 0;
+            for (const component_score& s : scores) {
+                total += s.pulls;
+            }
+            double bound = scores[i].reward_sum / scores[i].pulls + Bandit_exploration * std::sqrt(std::log(total) / scores[i].pulls);
+            if (best == -1 || bound > best_bound) {
+                best = i;
+                best_bound = bound;
+            }
+        }
+        winner = best;
+    }
+
+    void final_stats(CACHE* cache) {
+        std::cout << "----- Ensemble " << cache->NAME << " Arbitration ("
+                  << (Arbitration == arbiter_policy::SET_DUELING ? "set dueling" : "bandit") << ") -----\n";
+        std::cout << "Component | Issued | Refused | Useful | Useless | Epochs Won\n";
+        for (int i = 0; i < Num_components; ++i) {
+            const component_score& s = scores[i];
+            std::cout << Component_names[i] << " | " << s.issued << " | " << s.refused << " | " << s.useful << " | " << s.useless << " | "
+                      << s.epochs_won << "\n";
+        }
+        std::cout << "Final Winner: " << Component_names[winner] << "\n";
+
+        stats.report(cache->NAME);
+        issue_filter.report(cache->NAME);
+        row_filter.report(cache->NAME);
+        candidate_queue.report(cache->NAME);
+        placement.report(cache->NAME);
+        for (pf_component* component : components) {
+            component->final_stats(cache);
+        }
+    }
+
+    void footprint(pf_profile& profile) const {
+        profile.structure("owner_table", pf_vector_bytes(owners), 1);
+        profile.structure("issue_filter", issue_filter.footprint_bytes(), 1);
+        profile.structure("row_filter", row_filter.footprint_bytes(), 2);
+        profile.structure("candidate_queue", candidate_queue.footprint_bytes(), 1);
+        profile.structure("placement", placement.footprint_bytes(), 3);
+        for (const pf_component* component : components) {
+            component->footprint(profile);
+        }
+    }
+};
+
+// One ensemble for each cache using this module, allocated once since it holds all three prefetchers
+std::map<CACHE*, std::unique_ptr<ensemble>> ensembles;
+
+ensemble& ensemble_for(CACHE* cache)
+{
+    std::unique_ptr<ensemble>& e = ensembles[cache];
+    if (!e) {
+        e = std::make_unique<ensemble>();
+    }
+    return *e;
+}
+
+// Reports every component's structures to the host time profile (-DPF_PROFILE), see common/pf_profile.h
+void profile_footprint(pf_profile& profile, CACHE* cache) { ensemble_for(cache).footprint(profile); }
+
+void CACHE::prefetcher_initialize()
+{
+    PF_PROFILE_HOOK(this, "ensemble", initialize);
+    for (pf_component* component : ensemble_for(this).components) {
+        component->initialize(this);
+    }
+}
+
+uint32_t CACHE::prefetcher_cache_operate(uint64_t addr, uint64_t ip, uint8_t cache_hit, bool useful_prefetch, uint8_t type, uint32_t metadata_in)
+{
+    PF_PROFILE_HOOK(this, "ensemble", cache_operate);
+    PF_PROFILE_FOOTPRINT(this, "ensemble", profile_footprint);
+    ensemble_for(this).operate(this, addr, ip, cache_hit, useful_prefetch, type, metadata_in);
+    return metadata_in;
+}
+
+uint32_t CACHE::prefetcher_cache_fill(uint64_t addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_addr, uint32_t metadata_in)
+{
+    PF_PROFILE_HOOK(this, "ensemble", cache_fill);
+    ensemble_for(this).fill(this, addr, prefetch, evicted_addr);
+    return metadata_in;
+}
+
+void CACHE::prefetcher_cycle_operate()
+{
+    PF_PROFILE_HOOK(this, "ensemble", cycle_operate);
+    ensemble& e = ensemble_for(this);
+    for (pf_component* component : e.components) {
+        component->cycle(this);
+    }
+    e.cycle(this);
+}
+
+void CACHE::prefetcher_final_stats()
+{
+    ensemble_for(this).final_stats(this);
+    PF_PROFILE_REPORT(this, "ensemble", profile_footprint);
+}
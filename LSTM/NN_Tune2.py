@@ -1,3 +1,4 @@
+import argparse
 import tensorflow as tf
 import numpy as np
 from tensorflow.keras.models import Sequential
@@ -5,6 +6,7 @@ from tensorflow.keras.layers import LSTM, Dense
 from tensorflow.keras.optimizers import Adam
 from keras_tuner import BayesianOptimization
 from sklearn.model_selection import train_test_split
+import packed_trace
 
 
 # Global declaration of the outputs list
@@ -108,8 +110,16 @@ def tuner_setup():                              # This function sets up the tune
     return tuner
 
 if __name__ == "__main__":
-    file_path = 'postprocess.txt'                              # Sets file path
-    sequences, outputs = preprocess_file(file_path)             # Creates the input and output sequence arrays
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--input', default='postprocess.txt', help='preprocessed text file, or a packed .l2t trace from the capture hook or tools/l2clog_to_trace')
+    parser.add_argument('--misses-only', action='store_true', help='tune on the misses of a .l2t trace, the stream lstm.cc infers on with Infer_on_miss_only')
+    args = parser.parse_args()
+
+    file_path = args.input                                      # Input file path
+    if file_path.endswith('.l2t'):                              # Packed trace from the capture hook or tools/l2clog_to_trace
+        sequences, outputs = packed_trace.preprocess_file(file_path, args.misses_only)
+    else:
+        sequences, outputs = preprocess_file(file_path)         # Creates the input and output sequence arrays
     sequences = sequences.reshape((sequences.shape[0], 2, 49))  # Reshapes the input array to be 3-D
 
     # Splits data into training and testing sets, 80% training, 20% validating, random state ensures reproducability
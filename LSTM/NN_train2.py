@@ -1,14 +1,27 @@
+import argparse
+from collections import Counter
 import numpy as np
 import tensorflow as tf
-from tensorflow.keras.models import Sequential
-from tensorflow.keras.layers import LSTM, Dense
+from tensorflow.keras.models import Sequential, Model
+from tensorflow.keras.layers import LSTM, Dense, Input
 from tensorflow.keras.optimizers import Adam
-from tensorflow.keras.losses import BinaryCrossentropy
+from tensorflow.keras.losses import BinaryCrossentropy, SparseCategoricalCrossentropy
 from sklearn.model_selection import train_test_split
+import packed_trace
 
 # Global declaration of the outputs list
 outputs = []
 
+# Stateful mode settings, must match the constants in lstm.cc
+LSTM_UNITS = [192, 192, 64]         # Units in each LSTM layer (Lstm_units)
+SEQUENCE_LENGTH = 32                # Timesteps per truncated backpropagation window
+STATEFUL_BATCH = 64                 # Number of contiguous streams trained side by side
+STATE_RESET_INTERVAL = 100000       # Steps between state resets (State_reset_interval)
+
+# Delta mode settings
+DELTA_VOCAB_SIZE = 127              # Most frequent cache line deltas given their own class, the rest share class 0
+LOG2_BLOCK_SIZE = 6                 # 64 byte cache lines, as in ChampSim
+
 # Custom Loss Function (currently none functioning)
 def custom_loss(y_true, y_pred):
     standard_loss = BinaryCrossentropy()(y_true, y_pred)
@@ -37,6 +50,11 @@ def output_process(line):
     output_sequence = parts[1].zfill(12)            # Page Offset should be 12 bits
     return [int(bit) for bit in output_sequence]    # Iterates over each character in string, returns a binary int
 
+# Full address of a preprocessed line, used for the delta labels
+def line_address(line):
+    parts = line.strip().split()
+    return (int(parts[0], 2) << 12) | int(parts[1], 2)
+
 # File Preprocessing
 def preprocess_file(file_path):
     global outputs                                  # Declares the global variable to be used in the function
@@ -61,37 +79,226 @@ def preprocess_file(file_path):
 
     return np.array(sequences), np.array(outputs)               # Returns the two arrays
 
+# Stream Preprocessing for the stateful model
+# Every record is one timestep, the label of step i is the page offset of record i+1
+def preprocess_stream(file_path):
+    with open(file_path, 'r') as file:              # Opens the file at the file_path
+        lines = file.readlines()                    # Reads all lines from the list, each element is a string
+
+    steps = []                                      # Input vector of each timestep
+    labels = []                                     # Output vector of each timestep
+    deltas = []                                     # Cache line delta from each timestep to the next
+
+    for i in range(len(lines) - 1):
+        curr_input = input_process(lines[i])        # Process the current line
+        next_input = input_process(lines[i+1])      # Only used to check that the label line is valid
+
+        if curr_input is not None and next_input is not None:
+            steps.append(curr_input)
+            labels.append(output_process(lines[i+1]))
+            deltas.append((line_address(lines[i+1]) >> LOG2_BLOCK_SIZE) - (line_address(lines[i]) >> LOG2_BLOCK_SIZE))
+
+    return np.array(steps), np.array(labels), np.array(deltas)
+
+# Delta vocabulary, the most frequent non-zero deltas in order of their class (class 0 is "other")
+def build_delta_vocab(deltas):
+    counts = Counter(int(d) for d in deltas if d != 0)
+    return [delta for delta, _ in counts.most_common(DELTA_VOCAB_SIZE)]
+
+# Written one delta per line, read by load_delta_vocab() in lstm.cc
+def save_delta_vocab(vocab, path):
+    with open(path, 'w') as file:
+        for delta in vocab:
+            file.write(f"{delta}\n")
+
+# Maps each delta to its class, deltas outside the vocabulary go to class 0
+def to_delta_classes(deltas, vocab):
+    classes = {delta: i + 1 for i, delta in enumerate(vocab)}
+    return np.array([classes.get(int(d), 0) for d in deltas])
+
+# Output layer and loss for either the 12 offset bits or the delta softmax
+def output_layer(delta_classes=None):
+    if delta_classes:
+        return Dense(delta_classes, activation='softmax')
+    return Dense(12, activation='sigmoid')                      # Sigmoid converts values to be from 0 - 1
+
+def output_loss(delta_classes=None):
+    return SparseCategoricalCrossentropy() if delta_classes else BinaryCrossentropy()
+
 # LSTM Model Definition using best hyperparameters
-def create_lstm_model():
+def create_lstm_model(delta_classes=None):
     model = Sequential([                                        # Initialize a new 'Sequential' model (linear stack of layers in Keras)   
         LSTM(192, input_shape=(2, 49), return_sequences=True),  # Add LSTM layer of 192 units, input shape() specifies input data shape, 2 time steps, 49 features, r_s means the full sequence is returned in the next layer
         LSTM(192, return_sequences=True),                       # Second LSTM layer which returns sequences, will pass only to next layer rather than output
         LSTM(64, return_sequences=False),                       # Third LSTM layer, only returns the output of the last time step, into a single vector (transition layer)
-        Dense(12, activation='sigmoid')                         # Last Dense (fully connected) layer, Sigmoid converts values to be from 0 - 1
+        output_layer(delta_classes)                             # Last Dense (fully connected) layer, offset bits or delta classes
     ])
 
     # Using best learning rate found from tuning (example: 0.0005)
     adam_optimizer = Adam(learning_rate=0.0005)                 # Uses ADAM optimizer (good for binary), learning rate controls update of model in response to estimation error when model weights updated
-    model.compile(optimizer=adam_optimizer, loss=BinaryCrossentropy(), metrics=['accuracy'])    # Configures for training, ADAM, BCE loss function (good for binary), accuracy shows when prediction equal labels
+    model.compile(optimizer=adam_optimizer, loss=output_loss(delta_classes), metrics=['accuracy'])    # Configures for training, ADAM, BCE loss function (good for binary), accuracy shows when prediction equal labels
+    return model
+
+# Stateful LSTM used for training, state is carried from one batch to the next
+def create_stateful_lstm_model(batch_size, delta_classes=None):
+    model = Sequential([
+        LSTM(LSTM_UNITS[0], batch_input_shape=(batch_size, SEQUENCE_LENGTH, 49), return_sequences=True, stateful=True),
+        LSTM(LSTM_UNITS[1], return_sequences=True, stateful=True),
+        LSTM(LSTM_UNITS[2], return_sequences=True, stateful=True),  # Every timestep has a label, so the full sequence is returned
+        output_layer(delta_classes)                                 # Applied to each timestep
+    ])
+
+    adam_optimizer = Adam(learning_rate=0.0005)
+    model.compile(optimizer=adam_optimizer, loss=output_loss(delta_classes), metrics=['accuracy'])
+    return model
+
+# Single step model with explicit (h, c) inputs and outputs, this is what lstm.cc runs
+def create_step_model(trained_model, delta_classes=None):
+    lstm_input = Input(batch_shape=(1, 1, 49), name='lstm_input')
+    states_in = []
+    states_out = []
+    x = lstm_input
+    for layer, units in enumerate(LSTM_UNITS):
+        h = Input(batch_shape=(1, units), name=f'state_h{layer}')
+        c = Input(batch_shape=(1, units), name=f'state_c{layer}')
+        states_in += [h, c]
+        x, h_out, c_out = LSTM(units, return_sequences=True, return_state=True)(x, initial_state=[h, c])
+        states_out += [h_out, c_out]
+    output = output_layer(delta_classes)(x[:, -1, :])
+
+    step_model = Model(inputs=[lstm_input] + states_in, outputs=[output] + states_out)
+
+    # Copy the trained weights layer by layer (both models have the LSTM layers followed by the Dense layer)
+    trained_layers = [l for l in trained_model.layers if isinstance(l, (LSTM, Dense))]
+    step_layers = [l for l in step_model.layers if isinstance(l, (LSTM, Dense))]
+    for trained, step in zip(trained_layers, step_layers):
+        step.set_weights(trained.get_weights())
+    return step_model
+
+# Saves the step model with named inputs and outputs for C++ use
+# Outputs are a dict so the serving signature flattens them in sorted key order: output, state_c*, state_h*
+def export_stateful_model(step_model, path):
+    specs = [tf.TensorSpec([1, 1, 49], tf.float32, name='lstm_input')]
+    for layer, units in enumerate(LSTM_UNITS):
+        specs.append(tf.TensorSpec([1, units], tf.float32, name=f'state_h{layer}'))
+        specs.append(tf.TensorSpec([1, units], tf.float32, name=f'state_c{layer}'))
+
+    @tf.function(input_signature=specs)
+    def serve(lstm_input, *states):
+        results = step_model([lstm_input] + list(states))
+        named = {'output': results[0]}
+        for layer in range(len(LSTM_UNITS)):
+            named[f'state_h{layer}'] = results[1 + 2 * layer]
+            named[f'state_c{layer}'] = results[2 + 2 * layer]
+        return named
+
+    tf.saved_model.save(step_model, path, signatures={'serving_default': serve})
+
+# Saves the LSTM and Dense weights in the binary layout read by native_lstm::load() (lstm_native.h)
+def export_native_weights(model, path):
+    lstm_layers = [l for l in model.layers if isinstance(l, LSTM)]
+    dense = [l for l in model.layers if isinstance(l, Dense)][-1]
+    with open(path, 'wb') as file:
+        file.write(b'LSTW')
+        file.write(np.array([1, len(lstm_layers)], dtype='<u4').tobytes())
+        for layer in lstm_layers:
+            kernel, recurrent, bias = layer.get_weights()           # Keras layout, gates in i, f, c, o order
+            file.write(np.array(kernel.shape[0:1] + (layer.units,), dtype='<u4').tobytes())
+            for weights in (kernel, recurrent, bias):
+                file.write(np.asarray(weights, dtype='<f4').tobytes())
+        kernel, bias = dense.get_weights()
+        softmax = 1 if dense.get_config()['activation'] == 'softmax' else 0
+        file.write(np.array([kernel.shape[0], kernel.shape[1], softmax], dtype='<u4').tobytes())
+        file.write(np.asarray(kernel, dtype='<f4').tobytes())
+        file.write(np.asarray(bias, dtype='<f4').tobytes())
+
+# Splits a stream of timesteps into STATEFUL_BATCH contiguous streams cut into SEQUENCE_LENGTH windows
+def to_stateful_batches(steps, labels):
+    stream_length = (len(steps) // STATEFUL_BATCH) // SEQUENCE_LENGTH * SEQUENCE_LENGTH
+    used = stream_length * STATEFUL_BATCH
+    x = steps[:used].reshape((STATEFUL_BATCH, stream_length, 49))
+    y = labels[:used].reshape((STATEFUL_BATCH, stream_length) + labels.shape[1:])   # Offset bits or delta classes
+    return x, y, stream_length // SEQUENCE_LENGTH
+
+# Trains the stateful model in trace order, carrying state across windows and resetting like lstm.cc does
+def train_stateful(steps, labels, epochs, delta_classes=None):
+    split = int(len(steps) * 0.8)                               # Trace order matters, so the last 20% is held out instead of shuffled
+    x_train, y_train, train_windows = to_stateful_batches(steps[:split], labels[:split])
+    x_test, y_test, test_windows = to_stateful_batches(steps[split:], labels[split:])
+    resets_every = max(1, STATE_RESET_INTERVAL // SEQUENCE_LENGTH)
+
+    model = create_stateful_lstm_model(STATEFUL_BATCH, delta_classes)
+    for epoch in range(epochs):
+        model.reset_states()
+        for window in range(train_windows):
+            if window > 0 and window % resets_every == 0:
+                model.reset_states()
+            cut = slice(window * SEQUENCE_LENGTH, (window + 1) * SEQUENCE_LENGTH)
+            loss, accuracy = model.train_on_batch(x_train[:, cut, :], y_train[:, cut])
+        print(f"Epoch {epoch + 1}: loss {loss}, accuracy {accuracy}")
+
+    print("Evaluating model...")
+    model.reset_states()
+    results = []
+    for window in range(test_windows):
+        cut = slice(window * SEQUENCE_LENGTH, (window + 1) * SEQUENCE_LENGTH)
+        results.append(model.test_on_batch(x_test[:, cut, :], y_test[:, cut]))
+    loss, accuracy = np.mean(results, axis=0)
+    print(f"Test loss: {loss}, Test accuracy: {accuracy}")
     return model
 
 # Main script
 if __name__ == "__main__":
-    file_path = 'postprocess2.txt'                               # Input file path   
-    sequences, outputs = preprocess_file(file_path)             # Creates input and output data arrays from the preprocessing function
-    sequences = sequences.reshape((sequences.shape[0], 2, 49))  # Reshape the sequence array to a 3-D shape suitable for LSTM model (number of samples, time steps, features)
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--stateful', action='store_true', help='train the stateful single step model used by Stateful_mode in lstm.cc')
+    parser.add_argument('--delta', action='store_true', help='train the delta softmax model used by Delta_mode in lstm.cc')
+    parser.add_argument('--input', default='postprocess2.txt', help='preprocessed text file, or a packed .l2t trace from the capture hook or tools/l2clog_to_trace')
+    parser.add_argument('--misses-only', action='store_true', help='train on the misses of a .l2t trace, the stream lstm.cc infers on with Infer_on_miss_only')
+    args = parser.parse_args()
 
-    # Splits data into training and testing sets, 80% training, 20% validating, random state ensures reproducability
-    X_train, X_test, y_train, y_test = train_test_split(sequences, outputs, test_size=0.2, random_state=123)
-    model = create_lstm_model()                                 # Calls function used to create the model
+    file_path = args.input                                      # Input file path
+    packed = file_path.endswith('.l2t')                         # Packed traces are read with packed_trace instead of line by line
+    delta_classes = None                                        # Number of softmax classes in delta mode
+
+    if args.stateful or args.delta:
+        if packed:
+            steps, labels, deltas = packed_trace.preprocess_stream(file_path, args.misses_only)
+        else:
+            steps, labels, deltas = preprocess_stream(file_path)    # One timestep per record, in trace order
+        if args.delta:
+            vocab = build_delta_vocab(deltas)                   # Classes are learned from this trace
+            save_delta_vocab(vocab, 'model6/delta_vocab.txt')   # Saves vocabulary for C++ use
+            labels = to_delta_classes(deltas, vocab)
+            delta_classes = len(vocab) + 1
+
+    if args.stateful:
+        model = train_stateful(steps, labels, epochs=3, delta_classes=delta_classes)
+        model_dir = 'model6/model_delta_stateful' if args.delta else 'model6/model_stateful'
+        export_stateful_model(create_step_model(model, delta_classes), model_dir)   # Saves step model for C++ use
+        model.save('test6_stateful.keras')                      # Saves training model for Python use
+        export_native_weights(model, 'model6/native_weights.bin')   # Saves weights for the native C++ backend
+    else:
+        if args.delta:
+            sequences = np.stack([steps[:-1], steps[1:]], axis=1)   # Same previous + current window as preprocess_file
+            outputs = labels[1:]
+        elif packed:
+            sequences, outputs = packed_trace.preprocess_file(file_path, args.misses_only)
+        else:
+            sequences, outputs = preprocess_file(file_path)             # Creates input and output data arrays from the preprocessing function
+        sequences = sequences.reshape((sequences.shape[0], 2, 49))  # Reshape the sequence array to a 3-D shape suitable for LSTM model (number of samples, time steps, features)
+
+        # Splits data into training and testing sets, 80% training, 20% validating, random state ensures reproducability
+        X_train, X_test, y_train, y_test = train_test_split(sequences, outputs, test_size=0.2, random_state=123)
+        model = create_lstm_model(delta_classes)                    # Calls function used to create the model
     
-    # Trains the model using the specified data above, epochs = one complete data representation, batch is an iteration of the data
-    model.fit(X_train, y_train, epochs=3, batch_size=1000, validation_data=(X_test, y_test))  # Adjust epochs and batch size as needed
+        # Trains the model using the specified data above, epochs = one complete data representation, batch is an iteration of the data
+        model.fit(X_train, y_train, epochs=3, batch_size=1000, validation_data=(X_test, y_test))  # Adjust epochs and batch size as needed
 
-    print("Evaluating model...")
-    loss, accuracy = model.evaluate(X_test, y_test)             # Evalues the traied model on the test set, final validation 
-    print(f"Test loss: {loss}, Test accuracy: {accuracy}")      # print final loss and acuracy of the test data to the console
+        print("Evaluating model...")
+        loss, accuracy = model.evaluate(X_test, y_test)             # Evalues the traied model on the test set, final validation 
+        print(f"Test loss: {loss}, Test accuracy: {accuracy}")      # print final loss and acuracy of the test data to the console
 
-    # Save the trained model
-    model.save('model6/model')              # Saves model for C++ use
-    model.save('test6.keras')               # Saves model for Python use
+        # Save the trained model
+        model.save('model6/model_delta' if args.delta else 'model6/model')   # Saves model for C++ use
+        model.save('test6.keras')               # Saves model for Python use
+        export_native_weights(model, 'model6/native_weights.bin')   # Saves weights for the native C++ backend
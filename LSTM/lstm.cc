@@ -1,9 +1,14 @@
 #include "cache.h"
+#ifndef LSTM_NATIVE_ONLY
 #include "tensorflow/c/c_api.h"
+#endif
+#include <algorithm>
+#include <cmath>
 #include <vector>
 #include <bitset>
 #include <memory>
 #include <ostream>
+#ifndef LSTM_NATIVE_ONLY
 #include "tensorflow/c/tf_tensor.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/public/session.h"
@@ -14,31 +19,285 @@
 #include "tensorflow/core/protobuf/meta_graph.pb.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/graph/graph.h"
+#endif
 
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <numeric>
 
+#include "lstm_native.h"
+#include "../common/l2_trace.h"
+#include "../common/pf_profile.h"
+#include "../common/pf_pipeline.h"
+#include "../common/pf_stats.h"
+
+// Building with -DLSTM_NATIVE_ONLY leaves TensorFlow out entirely, only the native backend is available then
+#ifndef LSTM_NATIVE_ONLY
 using namespace tensorflow;
+#endif
 
 //GraphDef graph_def;
 
-static std::vector<float> previous_input_vector;    // Buffer for the previous input vector
-
 const int Page_number_size = 14;                    // Sets Page Number to 14 bits
 const int Page_offset_size = 12;                    // Sets Page Offset to 12 bits
 const int Cycle_delta_size = 22;                    // Sets Cycle Delta to 22 bits
 const int Type_size = 1;                            // Type 1 bit
 
-unsigned int Cycle = 0;                             // Global variable for Cycle
-unsigned int Cycle_buf = 0;                         // Global variable for Previous Cycle
-
+#ifndef LSTM_NATIVE_ONLY
 tensorflow::SessionOptions session_options_ = tensorflow::SessionOptions();                     // Configuration Options for TF session
 tensorflow::RunOptions run_options_ = tensorflow::RunOptions();                                 // Run-time options for TF session (debug)
 tensorflow::SavedModelBundle model_ = tensorflow::SavedModelBundle();                           // Object where saved model is stored
 //tensorflow::Status status;
 std::unique_ptr<Session> session;                                                               // Pointer for session (to be used)
+#endif
 const std::string export_dir = "/mnt/md0/jupyter/students/nathanielbush/test/model4/model";     // Directory for model
+bool model_loaded = false;                                                                      // Set once the model has been loaded by the first cache
+
+// Stateful mode //
+// Instead of rebuilding a 2-timestep window from zero state on every access, the stateful model takes one timestep
+// plus the (h, c) of each LSTM layer and returns the updated states, so each access costs one LSTM step.
+// The stateful model is exported by NN_train2.py --stateful.
+const bool Stateful_mode = false;                                                               // Run the single-step stateful model
+const uint64_t State_reset_interval = 100000;                                                   // Zero (h, c) after this many steps, 0 never resets
+const std::string stateful_export_dir = "/mnt/md0/jupyter/students/nathanielbush/test/model4/model_stateful";  // Directory for stateful model
+const int Num_lstm_layers = 3;                                                                  // Layers in the trained model
+const int Lstm_units[Num_lstm_layers] = {192, 192, 64};                                         // Units per layer, must match NN_train2.py
+
+// Signature outputs are flattened in sorted key order: output, state_c0..state_c2, state_h0..state_h2
+const int Output_index = 0;
+const int State_c_output_index = 1;
+const int State_h_output_index = 1 + Num_lstm_layers;
+
+// Per cache LSTM state carried between accesses
+struct lstm_state {
+#ifndef LSTM_NATIVE_ONLY
+    std::vector<tensorflow::Tensor> h;              // Hidden state for each layer, shape {1, units}
+    std::vector<tensorflow::Tensor> c;              // Cell state for each layer, shape {1, units}
+#endif
+    native_lstm::state native;                      // (h, c) of the native backend
+    uint64_t steps = 0;                             // Steps since the last reset
+
+    std::vector<float> previous_input_vector;       // Input of the last inferred access, first timestep of the window
+    unsigned int cycle = 0;                         // prefetcher_cycle_operate calls of this cache
+    unsigned int cycle_buf = 0;                     // cycle at the last inferred access
+};
+
+std::map<CACHE*, lstm_state> lstm_states;
+
+// Native backend //
+// lstm_native.h runs the same LSTM stack in plain C++ from the weights NN_train2.py exports. It works in every mode
+// above and is the only backend that can be trained online.
+enum class lstm_backend { TENSORFLOW, NATIVE };
+#ifndef LSTM_NATIVE_ONLY
+const lstm_backend Inference_backend = lstm_backend::TENSORFLOW;                               // Backend used for inference
+#else
+const lstm_backend Inference_backend = lstm_backend::NATIVE;
+#endif
+const std::string native_weights_path = "/mnt/md0/jupyter/students/nathanielbush/test/model4/native_weights.bin";  // Written by export_native_weights()
+
+std::shared_ptr<const native_lstm::model> native_weights;                                       // Weights used for inference
+
+// Online training //
+// Every inferred miss labels the previous one with its own address (offset bits, or delta class in delta mode).
+// Once Online_batch_size labeled samples are collected they are handed to a background thread that runs truncated
+// BPTT SGD on a copy of the weights and publishes the result. Inference picks up the new weights on its next run
+// and never waits; a batch that arrives while the trainer is still busy is dropped.
+const bool Online_training = false;                                                            // Native backend only
+const int Online_batch_size = 256;                                                              // Labeled misses per training batch
+const int Online_bptt_length = 16;                                                              // Truncated BPTT window in stateful mode
+const float Online_learning_rate = 0.001;                                                       // SGD step size
+
+native_lstm::online_trainer trainer;
+bool trainer_started = false;
+uint64_t trained_batches_seen = 0;                  // Trainer batches already picked up by inference
+
+// Samples collected by each cache for the next training batch
+struct online_samples {
+    bool has_pending = false;
+    std::vector<float> pending_input;               // Last inferred input (pair in windowed mode), labeled by the next miss
+    uint64_t pending_addr = 0;
+    std::vector<float> inputs;
+    std::vector<float> targets;
+    int count = 0;
+};
+
+std::map<CACHE*, online_samples> online_samples_by_cache;
+
+// Delta mode //
+// The delta model outputs a softmax over a vocabulary of cache line deltas instead of 12 page offset bits, so one
+// inference can issue several prefetches, including ones that cross the page.
+// The model and delta_vocab.txt are exported by NN_train2.py --delta (add --stateful for the stateful variant).
+const bool Delta_mode = false;                                                                  // Run the delta softmax model
+const int Max_delta_candidates = 4;                                                             // Most candidates kept per inference, the throttle's degree sets how many are issued (K)
+const float Delta_probability_threshold = 0.1;                                                  // Candidates below this probability are not issued
+const std::string delta_export_dir = "/mnt/md0/jupyter/students/nathanielbush/test/model4/model_delta";                    // Directory for delta model
+const std::string delta_stateful_export_dir = "/mnt/md0/jupyter/students/nathanielbush/test/model4/model_delta_stateful";  // Directory for stateful delta model
+const std::string delta_vocab_path = "/mnt/md0/jupyter/students/nathanielbush/test/model4/delta_vocab.txt";               // One delta per line for classes 1..N
+
+std::vector<int64_t> delta_vocab;                   // Class index to delta in cache lines, class 0 is "other" and never issued
+
+// Inference gating //
+// The model was trained on PREFETCH_TRAIN miss records only, so by default hits neither run the model nor advance
+// its inputs. Low-margin outputs (bits close to 0.5) are not issued.
+const bool Infer_on_miss_only = true;                                                           // Skip inference on cache hits
+const uint64_t Inference_sample_period = 1;                                                     // Infer on every Nth eligible access, 1 infers on all (must be at least 1)
+const float Confidence_margin = 0.1;                                                            // Drop the prefetch if any bit has |p - 0.5| below this
+
+// Per cache statistics printed by prefetcher_final_stats()
+struct lstm_stats {
+    uint64_t accesses = 0;                          // Calls to prefetcher_cache_operate
+    uint64_t misses = 0;                            // Accesses that missed
+    uint64_t useful_hits = 0;                       // Hits on a line brought in by a prefetch
+    uint64_t skipped_hits = 0;                      // Hits that did not run the model
+    uint64_t skipped_samples = 0;                   // Eligible accesses skipped by the sample period
+    uint64_t eligible = 0;                          // Accesses that passed the miss filter
+    uint64_t inferences = 0;                        // Model runs
+    uint64_t issued = 0;                            // Prefetch candidates handed to the pipeline
+    uint64_t low_confidence = 0;                    // Inferences dropped by the confidence margin
+    double bit_margin_sum[Page_offset_size] = {};   // Sum of |p - 0.5| for each output bit
+    uint64_t bit_low_margin[Page_offset_size] = {}; // Times each output bit was below the margin
+
+    pf_stats quality{"lstm"};                       // Prefetch quality and memo hit rate, exported at final stats
+    const int memo_lookup = quality.add_structure("memo");
+};
+
+std::map<CACHE*, lstm_stats> lstm_stats_by_cache;
+
+// Throttle, placement, filters and candidate queue in front of each cache, see common/pf_pipeline.h
+// The issue filter drops page crossing candidates, placement sends low confidence deltas to the LLC and the
+// throttle's degree is K, the delta candidates issued per inference (at most Max_delta_candidates)
+std::map<CACHE*, pf_pipeline> pipelines;
+
+// Prediction memo //
+// In windowed mode the prediction only depends on the previous and current input, and loops repeat the same pairs,
+// so the last prediction for each pair is kept and reused without running the model. The stateful model depends on
+// its whole history, so the memo is only used in windowed mode.
+const bool Memo_enabled = true;                     // Look up the memo before running the windowed model
+const int Memo_sets = 256;                          // Sets in the memo table (power of two)
+const int Memo_ways = 4;                            // Ways per set, LRU replacement
+
+uint64_t model_generation = 0;                      // Bumped by every model load, memo entries from older models are dropped
+
+// What one inference decided to prefetch, stored in the memo so a hit can replay it
+struct lstm_prediction {
+    bool issue = false;                             // False when the confidence gate dropped the inference
+    uint64_t offset = 0;                            // Offset bit mode: page offset to prefetch
+    int num_deltas = 0;                             // Delta mode: number of line deltas to prefetch
+    int64_t deltas[Max_delta_candidates] = {};
+    int confidence[Max_delta_candidates] = {};      // Of each delta, offset bit mode only uses the first
+};
+
+class prediction_memo {
+public:
+    struct memo_entry {
+        bool valid = false;
+        uint64_t prev_input = 0;                    // Packed 49-bit previous input
+        uint64_t curr_input = 0;                    // Packed 49-bit current input
+        uint64_t lru = 0;
+        lstm_prediction prediction;
+    };
+
+    uint64_t lookups = 0;
+    uint64_t hits = 0;
+
+    prediction_memo() : entries(Memo_sets * Memo_ways) {}
+
+    // Returns the stored prediction for this input pair, or nullptr on a miss
+    const lstm_prediction* find(uint64_t prev_input, uint64_t curr_input) {
+        sync_generation();
+        lookups++;
+        memo_entry* set = &entries[set_index(prev_input, curr_input) * Memo_ways];
+        for (int way = 0; way < Memo_ways; ++way) {
+            if (set[way].valid && set[way].prev_input == prev_input && set[way].curr_input == curr_input) {
+                set[way].lru = ++lru_count;
+                hits++;
+                return &set[way].prediction;
+            }
+        }
+        return nullptr;
+    }
+
+    // Stores a prediction, replacing the least recently used way of the set
+    void insert(uint64_t prev_input, uint64_t curr_input, const lstm_prediction& prediction) {
+        sync_generation();
+        memo_entry* set = &entries[set_index(prev_input, curr_input) * Memo_ways];
+        memo_entry* victim = &set[0];
+        for (int way = 0; way < Memo_ways; ++way) {
+            if (!set[way].valid) {
+                victim = &set[way];
+                break;
+            }
+            if (set[way].lru < victim->lru) {
+                victim = &set[way];
+            }
+        }
+        *victim = {true, prev_input, curr_input, ++lru_count, prediction};
+    }
+
+    uint64_t footprint_bytes() const { return pf_vector_bytes(entries); }
+
+private:
+    std::vector<memo_entry> entries;
+    uint64_t lru_count = 0;
+    uint64_t generation = 0;
+
+    // Clears the table when the model has been reloaded since the last access
+    void sync_generation() {
+        if (generation != model_generation) {
+            std::fill(entries.begin(), entries.end(), memo_entry());
+            generation = model_generation;
+        }
+    }
+
+    static size_t set_index(uint64_t prev_input, uint64_t curr_input) {
+        uint64_t hash = (prev_input * 0x9E3779B97F4A7C15ULL) ^ curr_input;
+        hash ^= hash >> 29;
+        hash *= 0xBF58476D1CE4E5B9ULL;
+        hash ^= hash >> 32;
+        return hash & (Memo_sets - 1);
+    }
+};
+
+std::map<CACHE*, prediction_memo> memos;
+
+// Training trace capture //
+// Writes every access seen by the prefetcher to <capture_dir>/<cache name>.l2t in the packed format of
+// common/l2_trace.h, which NN_train2.py and NN_Tune2.py read directly. This replaces dumping and parsing the
+// text l2clog. The records go through a ring buffer to a writer thread, so capture barely slows the simulation.
+// Once a model is loaded the hit bits include LSTM's own prefetches, so traces for ORACLE/oracle.cc and tools/replay
+// come from CAPTURE/capture.cc, which never prefetches.
+const bool Capture_trace = false;                   // Record the access stream for training
+const std::string capture_dir = "/mnt/md0/jupyter/students/nathanielbush/test/traces";     // Directory for captured traces
 
+std::map<CACHE*, std::unique_ptr<l2_trace_writer>> trace_writers;
 
+// Returns the capture writer for this cache, opening it on first use, or nullptr if the file can't be created
+l2_trace_writer* capture_writer(CACHE* cache)
+{
+    std::unique_ptr<l2_trace_writer>& writer = trace_writers[cache];
+    if (!writer) {
+        writer = std::make_unique<l2_trace_writer>();
+        std::string path = capture_dir + "/" + cache->NAME + ".l2t";
+        if (!writer->open(path)) {
+            std::cerr << "Could not create trace capture file " << path << std::endl;
+        }
+    }
+    return writer->is_open() ? writer.get() : nullptr;
+}
+
+// Packs a 49 element 0/1 input vector into the low bits of an integer, first element highest
+uint64_t pack_input(const std::vector<float>& input)
+{
+    uint64_t packed = 0;
+    for (float bit : input) {
+        packed = (packed << 1) | (bit > 0.5f ? 1 : 0);
+    }
+    return packed;
+}
+
+
+#ifndef LSTM_NATIVE_ONLY
 // Tensor building function
 tensorflow::Tensor build_input_tensor(const std::vector<float>& prev_input, const std::vector<float>& curr_input) 
 {
@@ -61,6 +320,37 @@ tensorflow::Tensor build_input_tensor(const std::vector<float>& prev_input, cons
 
 }
 
+// Builds the single timestep input tensor used by the stateful model
+tensorflow::Tensor build_step_tensor(const std::vector<float>& curr_input)
+{
+    // Shape is 1 sample, 1 step, 49 features
+    tensorflow::Tensor input_tensor(tensorflow::DT_FLOAT, tensorflow::TensorShape({1, 1, 49}));
+    auto input_tensor_map = input_tensor.tensor<float, 3>();
+
+    for (int i = 0; i < 49; ++i) {
+        input_tensor_map(0, 0, i) = curr_input[i];
+    }
+
+    return input_tensor;
+}
+
+// Zeros the (h, c) of every layer, used on the first step and every State_reset_interval steps
+void reset_state(lstm_state& state)
+{
+    state.h.clear();
+    state.c.clear();
+    for (int layer = 0; layer < Num_lstm_layers; ++layer) {
+        tensorflow::Tensor h(tensorflow::DT_FLOAT, tensorflow::TensorShape({1, Lstm_units[layer]}));
+        tensorflow::Tensor c(tensorflow::DT_FLOAT, tensorflow::TensorShape({1, Lstm_units[layer]}));
+        h.flat<float>().setZero();
+        c.flat<float>().setZero();
+        state.h.push_back(h);
+        state.c.push_back(c);
+    }
+    state.steps = 0;
+}
+#endif
+
 // Function to convert an input to a binary vector
 std::vector<float> int_to_binary_vector(uint64_t value, int bit_size) 
 {
@@ -75,7 +365,7 @@ std::vector<float> int_to_binary_vector(uint64_t value, int bit_size)
     return binary_vector;
 }
 
-std::vector<float> process_input1(uint64_t addr, uint8_t type) 
+std::vector<float> process_input1(lstm_state& state, uint64_t addr, uint8_t type) 
 {
     //std::cout << "process input startup" << std::endl;
     //std::cout << std::flush;
@@ -85,8 +375,8 @@ std::vector<float> process_input1(uint64_t addr, uint8_t type)
     uint64_t page_offset = addr & 0xFFF;        // Mask for the offset
 
     // Get the cycle delta
-    uint64_t cycle_delta = Cycle - Cycle_buf;   // Uses global variables to find cycle delta
-    Cycle_buf = Cycle;                          // Sets buffer to current
+    uint64_t cycle_delta = state.cycle - state.cycle_buf;   // Cycles since this cache's last inferred access
+    state.cycle_buf = state.cycle;                          // Sets buffer to current
 
     // Convert to binary format using function
     std::vector<float> page_number_vector = int_to_binary_vector(page_number, Page_number_size);
@@ -134,6 +424,48 @@ uint64_t process_output(uint64_t current_addr, const std::vector<float>& output_
     return (page_number << 12) | result;
 }
 
+// Picks up to Max_delta_candidates classes above the probability threshold, most likely first, with their probability
+std::vector<std::pair<int64_t, float>> select_delta_candidates(const std::vector<float>& probabilities)
+{
+    // Sort class indices by probability, only the top K matter
+    std::vector<size_t> classes(std::min(probabilities.size(), delta_vocab.size()));
+    std::iota(classes.begin(), classes.end(), 0);
+    size_t k = std::min<size_t>(Max_delta_candidates + 1, classes.size());     // One extra in case "other" is in the top K
+    std::partial_sort(classes.begin(), classes.begin() + k, classes.end(), [&](size_t a, size_t b) {
+        return probabilities[a] > probabilities[b];
+    });
+
+    std::vector<std::pair<int64_t, float>> deltas;
+    for (size_t i = 0; i < k && deltas.size() < static_cast<size_t>(Max_delta_candidates); ++i) {
+        // Sorted, so nothing after this can pass the threshold either
+        if (probabilities[classes[i]] < Delta_probability_threshold) {
+            break;
+        }
+        if (classes[i] != 0 && delta_vocab[classes[i]] != 0) {
+            deltas.push_back({delta_vocab[classes[i]], probabilities[classes[i]]});
+        }
+    }
+    return deltas;
+}
+
+// Reads the delta vocabulary written by NN_train2.py --delta
+bool load_delta_vocab()
+{
+    std::ifstream vocab_file(delta_vocab_path);
+    if (!vocab_file) {
+        std::cerr << "Failed to open delta vocabulary: " << delta_vocab_path << std::endl;
+        return false;
+    }
+
+    delta_vocab.assign(1, 0);                       // Class 0 is the catch-all "other" class
+    int64_t delta;
+    while (vocab_file >> delta) {
+        delta_vocab.push_back(delta);
+    }
+    return true;
+}
+
+#ifndef LSTM_NATIVE_ONLY
 std::vector<float> tensor_to_vector(const Tensor& output_tensor) 
 {
     // Convert the output tensor using flat() (accesses tensor data as flat array, disregarding original shape)
@@ -142,20 +474,333 @@ std::vector<float> tensor_to_vector(const Tensor& output_tensor)
     return std::vector<float>(flat.data(), flat.data() + flat.size());
 }
 
-void CACHE::prefetcher_initialize() {
-    //std::cout << "prefetcher initialize startup" << std::endl;
+// Runs the 2-timestep window model on the previous and current inputs
+bool run_windowed(lstm_state& state, const std::vector<float>& curr_input, std::vector<Tensor>& outputs)
+{
+    // Checks if previous vector was empty, if so, resize to the input length
+    if(state.previous_input_vector.empty()) {
+        state.previous_input_vector.resize(Page_number_size + Page_offset_size + Cycle_delta_size + Type_size);
+    }
+
+    // Create an input tensor from the previous and current input vectors, used to input into machine
+    tensorflow::Tensor input_tensor = build_input_tensor(state.previous_input_vector, curr_input);
+
+    // Update the previous input vector for the next run
+    state.previous_input_vector = curr_input;
+
+    // Prepares the input for the TF session using the name of the correct node
+    std::vector<std::pair<string, tensorflow::Tensor >> inputs = {{"serving_default_lstm_input", input_tensor}};
+
+    // Runs the TF session with the correct names of the input and output nodes, and output tensor
+    tensorflow::Status run_status = model_.session->Run(inputs, {"StatefulPartitionedCall"}, {}, &outputs);
+    // Checks if the model was correctly ran
+    if (!run_status.ok()) {
+        std::cerr << "Failed to run TensorFlow session: " << run_status.ToString() << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Advances the stateful model by one timestep, feeding and storing this cache's (h, c)
+bool run_stateful(lstm_state& state, const std::vector<float>& curr_input, std::vector<Tensor>& outputs)
+{
+    // Periodic reset keeps the state in the range seen during training
+    if (state.h.empty() || (State_reset_interval != 0 && state.steps >= State_reset_interval)) {
+        reset_state(state);
+    }
+
+    std::vector<std::pair<string, tensorflow::Tensor >> inputs = {{"serving_default_lstm_input", build_step_tensor(curr_input)}};
+    std::vector<string> output_names = {"StatefulPartitionedCall:0"};
+    for (int layer = 0; layer < Num_lstm_layers; ++layer) {
+        inputs.push_back({"serving_default_state_h" + std::to_string(layer), state.h[layer]});
+        inputs.push_back({"serving_default_state_c" + std::to_string(layer), state.c[layer]});
+    }
+    for (int i = 1; i < 1 + 2 * Num_lstm_layers; ++i) {
+        output_names.push_back("StatefulPartitionedCall:" + std::to_string(i));
+    }
+
+    tensorflow::Status run_status = model_.session->Run(inputs, output_names, {}, &outputs);
+    if (!run_status.ok()) {
+        std::cerr << "Failed to run TensorFlow session: " << run_status.ToString() << "\n";
+        return false;
+    }
+
+    // Keep the new states for the next access
+    for (int layer = 0; layer < Num_lstm_layers; ++layer) {
+        state.c[layer] = outputs[State_c_output_index + layer];
+        state.h[layer] = outputs[State_h_output_index + layer];
+    }
+    state.steps++;
+    return true;
+}
+#endif
+
+// Runs the native model on the same 2-timestep window the TF windowed model sees
+void run_native_windowed(const native_lstm::model& weights, lstm_state& state, const std::vector<float>& curr_input, std::vector<float>& output_vector)
+{
+    if(state.previous_input_vector.empty()) {
+        state.previous_input_vector.resize(Page_number_size + Page_offset_size + Cycle_delta_size + Type_size);
+    }
+
+    native_lstm::state window_state;
+    window_state.reset(weights);
+    native_lstm::step(weights, window_state, state.previous_input_vector.data(), output_vector);
+    native_lstm::step(weights, window_state, curr_input.data(), output_vector);
+
+    state.previous_input_vector = curr_input;
+}
+
+// Advances the native model by one timestep from this cache's (h, c)
+void run_native_stateful(const native_lstm::model& weights, lstm_state& state, const std::vector<float>& curr_input, std::vector<float>& output_vector)
+{
+    if (state.native.h.empty() || (State_reset_interval != 0 && state.steps >= State_reset_interval)) {
+        state.native.reset(weights);
+        state.steps = 0;
+    }
+    native_lstm::step(weights, state.native, curr_input.data(), output_vector);
+    state.steps++;
+}
+
+// Runs whichever backend is selected and returns the output probabilities
+bool run_model(CACHE* cache, const std::vector<float>& curr_input, std::vector<float>& output_vector)
+{
+    if (Inference_backend == lstm_backend::NATIVE) {
+        if (Stateful_mode) {
+            run_native_stateful(*native_weights, lstm_states[cache], curr_input, output_vector);
+        } else {
+            run_native_windowed(*native_weights, lstm_states[cache], curr_input, output_vector);
+        }
+        return true;
+    }
+
+#ifndef LSTM_NATIVE_ONLY
+    // Creates an output tensor for the output of the session
+    std::vector<Tensor> outputs;
+    bool ran = Stateful_mode ? run_stateful(lstm_states[cache], curr_input, outputs)
+                             : run_windowed(lstm_states[cache], curr_input, outputs);
+    if (!ran) {
+        return false;
+    }
+
+    // Convert the output tensor to a vector<float> for easier manipulation
+    output_vector = tensor_to_vector(outputs[Output_index]);
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Switches inference to the newest weights published by the online trainer.
+// This counts as a model reload, so memoized predictions of the old weights are dropped.
+void pick_up_trained_weights()
+{
+    uint64_t trained = trainer.batches_trained;
+    if (trained != trained_batches_seen) {
+        trained_batches_seen = trained;
+        native_weights = trainer.live();
+        model_generation++;
+    }
+}
+
+// Training target for the sample at prev_addr, given the address of the miss that followed it
+std::vector<float> make_target(uint64_t prev_addr, uint64_t next_addr)
+{
+    std::vector<float> target(native_weights->outputs, 0.0f);
+
+    if (Delta_mode) {
+        // One-hot delta class, class 0 when the delta is not in the vocabulary
+        int64_t delta = static_cast<int64_t>(next_addr >> LOG2_BLOCK_SIZE) - static_cast<int64_t>(prev_addr >> LOG2_BLOCK_SIZE);
+        auto it = std::find(delta_vocab.begin() + 1, delta_vocab.end(), delta);
+        size_t label = it == delta_vocab.end() ? 0 : static_cast<size_t>(it - delta_vocab.begin());
+        if (label < target.size()) {
+            target[label] = 1.0f;
+        }
+        return target;
+    }
+
+    // Offset bits, most significant first like output_process() in NN_train2.py
+    uint64_t offset = next_addr & 0xFFF;
+    for (int i = 0; i < Page_offset_size && i < static_cast<int>(target.size()); ++i) {
+        target[i] = (offset >> (Page_offset_size - 1 - i)) & 1;
+    }
+    return target;
+}
+
+// Labels the pending sample of this cache with the current miss and queues the current input as the next sample.
+// Must run before the windowed model updates the cache's previous_input_vector.
+void record_training_sample(CACHE* cache, uint64_t addr, const std::vector<float>& curr_input)
+{
+    online_samples& samples = online_samples_by_cache[cache];
+    const std::vector<float>& previous_input_vector = lstm_states[cache].previous_input_vector;
+
+    if (samples.has_pending) {
+        std::vector<float> target = make_target(samples.pending_addr, addr);
+        samples.inputs.insert(samples.inputs.end(), samples.pending_input.begin(), samples.pending_input.end());
+        samples.targets.insert(samples.targets.end(), target.begin(), target.end());
+
+        if (++samples.count == Online_batch_size) {
+            trainer.submit(std::move(samples.inputs), std::move(samples.targets), samples.count);
+            samples.inputs.clear();
+            samples.targets.clear();
+            samples.count = 0;
+        }
+    }
+
+    // Windowed predictions see the previous input too, so the sample is the pair
+    samples.pending_input.clear();
+    if (!Stateful_mode) {
+        if (previous_input_vector.empty()) {
+            samples.pending_input.resize(curr_input.size());
+        } else {
+            samples.pending_input = previous_input_vector;
+        }
+    }
+    samples.pending_input.insert(samples.pending_input.end(), curr_input.begin(), curr_input.end());
+    samples.pending_addr = addr;
+    samples.has_pending = true;
+}
+
+// Turns the model output into a prediction, applying the delta threshold or the bit confidence margin
+lstm_prediction decide_prediction(const std::vector<float>& output_vector, lstm_stats& stats)
+{
+    lstm_prediction prediction;
+
+    // Delta mode issues every candidate above the threshold, each relative to the current cache line
+    if (Delta_mode) {
+        for (const std::pair<int64_t, float>& candidate : select_delta_candidates(output_vector)) {
+            prediction.deltas[prediction.num_deltas] = candidate.first;
+            prediction.confidence[prediction.num_deltas++] = pf_confidence(candidate.second);
+        }
+        prediction.issue = prediction.num_deltas > 0;
+        return prediction;
+    }
+
+    // Track the margin of every bit, one uncertain bit is enough to make the address a guess
+    bool confident = true;
+    float min_margin = 0.5f;
+    for (size_t i = 0; i < output_vector.size() && i < Page_offset_size; ++i) {
+        float margin = std::abs(output_vector[i] - 0.5f);
+        min_margin = std::min(min_margin, margin);
+        stats.bit_margin_sum[i] += margin;
+        if (margin < Confidence_margin) {
+            stats.bit_low_margin[i]++;
+            confident = false;
+        }
+    }
+    if (!confident) {
+        stats.low_confidence++;
+        return prediction;
+    }
+
+    // Convert floating-point probabilities to binary (thresholding at 0.5) 
+    std::vector<float> binary_output(output_vector.size());
+    std::transform(output_vector.begin(), output_vector.end(), binary_output.begin(), [](float value) {
+        return value > 0.5 ? 1 : 0;
+    });
+
+    // Only the offset is kept, the page comes from the access the prediction is replayed for
+    prediction.offset = process_output(0, binary_output);
+    prediction.confidence[0] = pf_confidence(2 * min_margin);      // As sure as the least sure bit
+    prediction.issue = true;
+    return prediction;
+}
+
+// Issues the prefetches of a prediction relative to the current access
+void issue_prediction(CACHE* cache, uint64_t addr, uint64_t ip, const lstm_prediction& prediction, uint32_t metadata_in, lstm_stats& stats)
+{
+    if (!prediction.issue) {
+        return;
+    }
+    pf_pipeline& pipeline = pipelines[cache];
+    pf_pipeline::issuer issuer(pipeline, cache, addr, ip);
+
+    if (Delta_mode) {
+        int k = std::min(prediction.num_deltas, pipeline.level().degree);
+        for (int i = 0; i < k; ++i) {
+            uint64_t pf_addr = static_cast<uint64_t>((static_cast<int64_t>(addr >> LOG2_BLOCK_SIZE) + prediction.deltas[i])) << LOG2_BLOCK_SIZE;
+            pf_issue_result result = issuer.issue(pf_addr, true, metadata_in, prediction.confidence[i]);
+            stats.quality.on_prefetch(cache->warmup, pf_addr, ip, result);
+            stats.issued++;
+        }
+        return;
+    }
+
+    // Combine the page number of the current address with the predicted offset
+    uint64_t page_number = addr >> 12;
+    uint64_t pf_addr = (page_number << 12) | prediction.offset;
+    pf_issue_result result = issuer.issue(pf_addr, true, metadata_in, prediction.confidence[0]);
+    stats.quality.on_prefetch(cache->warmup, pf_addr, ip, result);
+    stats.issued++;
+}
+
+// Loads the exported model matching the selected modes, anything cached from the previous model is stale after this
+bool load_model()
+{
+    if (Delta_mode && !load_delta_vocab()) {
+        return false;
+    }
+
+    if (Inference_backend == lstm_backend::NATIVE) {
+        auto weights = std::make_shared<native_lstm::model>();
+        if (!native_lstm::load(native_weights_path, *weights)) {
+            std::cerr << "Failed to load native weights: " << native_weights_path << std::endl;
+            return false;
+        }
+        native_weights = weights;
+
+        // The trainer starts from the loaded weights and is only started once
+        if (Online_training && !trainer_started) {
+            trainer.start(native_weights, Online_bptt_length, Online_learning_rate, !Stateful_mode);
+            trainer_started = true;
+        }
+
+        model_loaded = true;
+        model_generation++;
+        return true;
+    }
+
+#ifndef LSTM_NATIVE_ONLY
+    // Picks the exported model matching the selected modes
+    std::string model_dir = export_dir;
+    if (Delta_mode) {
+        model_dir = Stateful_mode ? delta_stateful_export_dir : delta_export_dir;
+    } else if (Stateful_mode) {
+        model_dir = stateful_export_dir;
+    }
 
     // Attempts to load the model from the directory ({"serve"} sets to run only)
     auto status = tensorflow::LoadSavedModel(session_options_, 
                                                     run_options_, 
-                                                    export_dir, 
+                                                    model_dir, 
                                                     {"serve"}, 
                                                     &model_);
 
     // Checks to see if the status is ok
     if (!status.ok()) {
         std::cerr << "Failed to load saved model: " << status.ToString() << std::endl;
-        return; // Handle error appropriately
+        return false; // Handle error appropriately
+    }
+    model_loaded = true;
+    model_generation++;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void CACHE::prefetcher_initialize() {
+    PF_PROFILE_HOOK(this, "lstm", initialize);
+    //std::cout << "prefetcher initialize startup" << std::endl;
+    pipelines.try_emplace(this, "lstm", true, &lstm_stats_by_cache[this].quality);
+
+    // The model is shared by every cache using this prefetcher, so it is only loaded once
+    if (model_loaded) {
+        return;
+    }
+    load_model();
+
+    if (Online_training && Inference_backend != lstm_backend::NATIVE) {
+        std::cerr << "Online training needs the native backend, the model stays frozen" << std::endl;
     }
 
     //std::cout << "end load" << std::endl;
@@ -219,89 +864,114 @@ void CACHE::prefetcher_initialize() {
     // std::cout << "Fake tensor input check finish" << std::endl;
 }
 
-uint32_t CACHE::prefetcher_cache_operate(uint64_t addr, uint64_t ip, uint8_t cache_hit, bool useful_prefetch, uint8_t type, uint32_t metadata_in) 
+// Reports the memo, training samples and native weights to the host time profile (-DPF_PROFILE), see common/pf_profile.h
+void profile_footprint(pf_profile& profile, CACHE* cache)
 {
-    //std::cout << "cache_operate startup" << std::endl;
-
-    // Prepare inputs for the tensor //
+    auto memo = memos.find(cache);
+    if (memo != memos.end()) {
+        profile.structure("memo", memo->second.footprint_bytes(), 1);
+    }
 
-    // Creates an input vector from the addr and type using process_input1()
-    std::vector<float> current_input_vector = process_input1(addr, type);
+    auto pipeline = pipelines.find(cache);
+    if (pipeline != pipelines.end()) {
+        pipeline->second.footprint(profile);
+    }
 
-    // Checks if previous vector was empty, if so, resize to 3-D vector
-    if(previous_input_vector.empty()) {
-        previous_input_vector.resize(Page_number_size + Page_offset_size + Cycle_delta_size + Type_size);
+    auto samples = online_samples_by_cache.find(cache);
+    if (samples != online_samples_by_cache.end()) {
+        const online_samples& s = samples->second;
+        profile.structure("online_samples", pf_vector_bytes(s.pending_input) + pf_vector_bytes(s.inputs) + pf_vector_bytes(s.targets), 3);
     }
 
-    // Create an input tensor from the previous and current input vectors, used to input into machine
-    tensorflow::Tensor input_tensor = build_input_tensor(previous_input_vector, current_input_vector);
+    if (native_weights) {
+        uint64_t bytes = pf_vector_bytes(native_weights->layers) + pf_vector_bytes(native_weights->dense_kernel) + pf_vector_bytes(native_weights->dense_bias);
+        for (const native_lstm::layer& l : native_weights->layers) {
+            bytes += pf_vector_bytes(l.kernel) + pf_vector_bytes(l.recurrent) + pf_vector_bytes(l.bias);
+        }
+        profile.structure("native_weights", bytes, 3 + 3 * native_weights->layers.size());
+    }
+}
 
-    // Update the previous input vector for the next run
-    previous_input_vector = current_input_vector;
+uint32_t CACHE::prefetcher_cache_operate(uint64_t addr, uint64_t ip, uint8_t cache_hit, bool useful_prefetch, uint8_t type, uint32_t metadata_in) 
+{
+    PF_PROFILE_HOOK(this, "lstm", cache_operate);
+    PF_PROFILE_FOOTPRINT(this, "lstm", profile_footprint);
+    //std::cout << "cache_operate startup" << std::endl;
 
-    // Model startup and load //
-    
-    // Attemps to load the pretrained mode with given parameters
-    auto status = tensorflow::LoadSavedModel(session_options_, 
-                                                    run_options_, 
-                                                    export_dir, 
-                                                    {"serve"}, 
-                                                    &model_);
+    // Capture sees every access, before any of the inference gates
+    if (Capture_trace) {
+        if (l2_trace_writer* writer = capture_writer(this)) {
+            writer->append(addr, ip, current_cycle, type, cache_hit);
+        }
+    }
 
-    // Resize the previous input vector again (idk why its here again but it is)
-    if(previous_input_vector.empty()) {
-        previous_input_vector.resize(Page_number_size + Page_offset_size + Cycle_delta_size + Type_size);
+    lstm_stats& stats = lstm_stats_by_cache[this];
+    stats.accesses++;
+    stats.quality.on_access(warmup, addr, cache_hit, useful_prefetch);
+    pipelines[this].on_access(this, addr, cache_hit, useful_prefetch);
+    if (!cache_hit) {
+        stats.misses++;
+    } else if (useful_prefetch) {
+        stats.useful_hits++;
     }
 
-    // Checks to see the model was loaded correctly
-    if (!status.ok()) {
-        std::cerr << "Failed to load saved model: " << status.ToString() << std::endl;
-        return metadata_in; // Handle error appropriately
+    // Gate inference before building the input, so the cycle delta and previous input span inferred accesses only
+    if (Infer_on_miss_only && cache_hit) {
+        stats.skipped_hits++;
+        return metadata_in;
+    }
+    if (stats.eligible++ % Inference_sample_period != 0) {
+        stats.skipped_samples++;
+        return metadata_in;
     }
 
-    // Run the tensorflow model//
+    // Prepare inputs for the tensor //
 
-    // Prepares the input for the TF session using the name of the correct node
-    std::vector<std::pair<string, tensorflow::Tensor >> inputs = {{"serving_default_lstm_input", input_tensor}};
-    
-    // Creates an output tensor for the output of the session
-    std::vector<Tensor> outputs;
-    // Runs the TF session with the correct names of the input and output nodes, and output tensor
-    tensorflow::Status run_status = model_.session->Run(inputs, {"StatefulPartitionedCall"}, {}, &outputs);
-    // Checks if the model was correctly ran
-    if (!run_status.ok()) {
-        std::cerr << "Failed to run TensorFlow session: " << run_status.ToString() << "\n";
+    // Creates an input vector from the addr and type using process_input1()
+    lstm_state& state = lstm_states[this];
+    std::vector<float> current_input_vector = process_input1(state, addr, type);
+
+    // Checks to see the model was loaded correctly
+    if (!model_loaded) {
         return metadata_in;
-    } 
+    }
 
-    // Unused variable for output tensor for debugging purposes (extracts for tensor from list)
-    auto output_tensor = outputs[0].tensor<float, 2>();
-    
-    // Convert the output tensor to a vector<float> for easier manipulation
-    std::vector<float> output_vector = tensor_to_vector(outputs[0]);
+    // Online training labels the previous miss with this one and checks for newly trained weights
+    if (Online_training && Inference_backend == lstm_backend::NATIVE) {
+        record_training_sample(this, addr, current_input_vector);
+        pick_up_trained_weights();
+    }
 
-    // Convert floating-point probabilities to binary (thresholding at 0.5) 
-    std::vector<float> binary_output(output_vector.size());
-    std::transform(output_vector.begin(), output_vector.end(), binary_output.begin(), [](float value) {
-        return value > 0.5 ? 1 : 0;
-    });
+    // Repeated (previous, current) pairs replay the last prediction instead of running the model
+    bool use_memo = Memo_enabled && !Stateful_mode;
+    uint64_t prev_packed = pack_input(state.previous_input_vector);
+    uint64_t curr_packed = pack_input(current_input_vector);
+    if (use_memo) {
+        const lstm_prediction* memoized = memos[this].find(prev_packed, curr_packed);
+        stats.quality.on_lookup(warmup, stats.memo_lookup, memoized != nullptr);
+        if (memoized) {
+            state.previous_input_vector = current_input_vector; // Same update the windowed run would have made
+            issue_prediction(this, addr, ip, *memoized, metadata_in, stats);
+            return metadata_in;
+        }
+    }
 
+    // Run the model//
 
-    // Used to print what the output of the NN was for debug purposes
-    std::cout << "Predicted output vector: ";
-    for (float value : binary_output) {
-        std::cout << value << " ";
+    std::vector<float> output_vector;
+    if (!run_model(this, current_input_vector, output_vector)) {
+        return metadata_in;
     }
-    std::cout << std::endl;
+    stats.inferences++;
 
-    // Process the output to find the complete prefetch address
-    uint64_t result = process_output(addr, binary_output);
+    // Decide what to prefetch, then remember it for the next time this pair shows up
+    lstm_prediction prediction = decide_prediction(output_vector, stats);
+    if (use_memo) {
+        memos[this].insert(prev_packed, curr_packed, prediction);
+    }
 
     // Send it off to the big wide world of the L2 Cache
-    prefetch_line(result, true, metadata_in);
-
-    // Assigning session from the loaded model
-    session.reset(model_.session.release());
+    issue_prediction(this, addr, ip, prediction, metadata_in, stats);
     
     //TODO: Set up the session close section once the program is done running
     //std::cout << "cache_operate fin" << std::endl;
@@ -311,13 +981,67 @@ uint32_t CACHE::prefetcher_cache_operate(uint64_t addr, uint64_t ip, uint8_t cac
 
 uint32_t CACHE::prefetcher_cache_fill(uint64_t addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_addr, uint32_t metadata_in)
 {
+  PF_PROFILE_HOOK(this, "lstm", cache_fill);
+  lstm_stats_by_cache[this].quality.on_fill(warmup, addr, prefetch, evicted_addr);
+  pipelines[this].on_fill(addr, prefetch, evicted_addr);
   return metadata_in;
 }
 
 void CACHE::prefetcher_cycle_operate() {
-    Cycle++;        // Updates for cycle time and deltas
+    PF_PROFILE_HOOK(this, "lstm", cycle_operate);
+    lstm_states[this].cycle++;      // Updates for cycle time and deltas
+    pipelines[this].cycle(this);
 }
 
-void CACHE::prefetcher_final_stats() {}
+void CACHE::prefetcher_final_stats() {
+    const lstm_stats& stats = lstm_stats_by_cache[this];
+    auto ratio = [](uint64_t num, uint64_t den) { return den == 0 ? 0.0 : static_cast<double>(num) / static_cast<double>(den); };
+
+    std::cout << "----- LSTM Prefetcher Statistics -----\n";
+    std::cout << "Accesses: " << stats.accesses << "\n";
+    std::cout << "Misses: " << stats.misses << "\n";
+    std::cout << "Useful Prefetch Hits: " << stats.useful_hits << "\n";
+    std::cout << "Skipped Hits: " << stats.skipped_hits << "\n";
+    std::cout << "Skipped By Sampling: " << stats.skipped_samples << "\n";
+    std::cout << "Inferences: " << stats.inferences << "\n";
+    std::cout << "Inference Rate: " << ratio(stats.inferences, stats.accesses) << "\n";
+    std::cout << "Low Confidence Drops: " << stats.low_confidence << "\n";
+    std::cout << "Prefetches Issued: " << stats.issued << "\n";
+    std::cout << "Prefetches Per Inference: " << ratio(stats.issued, stats.inferences) << "\n";
+
+    if (Online_training && Inference_backend == lstm_backend::NATIVE) {
+        std::cout << "Online Batches Submitted: " << trainer.batches_submitted << "\n";
+        std::cout << "Online Batches Dropped (Trainer Busy): " << trainer.batches_dropped << "\n";
+        std::cout << "Online Batches Trained: " << trainer.batches_trained << "\n";
+        std::cout << "Online Last Batch Loss: " << trainer.last_loss << "\n";
+    }
+
+    if (Memo_enabled && !Stateful_mode) {
+        const prediction_memo& memo = memos[this];
+        std::cout << "Memo Lookups: " << memo.lookups << "\n";
+        std::cout << "Memo Hits (Saved Inferences): " << memo.hits << "\n";
+        std::cout << "Memo Hit Rate: " << ratio(memo.hits, memo.lookups) << "\n";
+    }
+
+    if (Capture_trace && trace_writers.count(this) && trace_writers[this]->is_open()) {
+        l2_trace_writer& writer = *trace_writers[this];
+        writer.close();
+        std::cout << "Captured Trace Records: " << writer.records() << "\n";
+        std::cout << "Capture Buffer Full Waits: " << writer.full_waits << "\n";
+    }
+
+    // Bit confidence only applies to the offset bit output
+    if (!Delta_mode) {
+        std::cout << "Bit | Mean Margin | Low Margin Rate\n";
+        for (int i = 0; i < Page_offset_size; ++i) {
+            std::cout << i << " | " << (stats.inferences == 0 ? 0.0 : stats.bit_margin_sum[i] / stats.inferences)
+                      << " | " << ratio(stats.bit_low_margin[i], stats.inferences) << "\n";
+        }
+    }
+
+    stats.quality.report(NAME);
+    pipelines[this].report(NAME);
+    PF_PROFILE_REPORT(this, "lstm", profile_footprint);
+}
 
 
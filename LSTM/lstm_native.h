@@ -0,0 +1,475 @@
+#ifndef LSTM_NATIVE_H
+#define LSTM_NATIVE_H
+
+/*
+Native C++ version of the LSTM stack trained by NN_train2.py, used by lstm.cc when Inference_backend is NATIVE.
+
+The weights are read from the binary file written by export_native_weights() in NN_train2.py and follow the Keras
+layout: per LSTM layer a kernel (inputs x 4*units), a recurrent kernel (units x 4*units) and a bias (4*units), with
+the gates in i, f, c, o order, followed by the Dense output layer (sigmoid bits or softmax classes).
+
+Besides inference, the model can be trained in place with truncated backpropagation through time. online_trainer
+runs that training on a background thread against a private copy of the weights and publishes the result by
+swapping a shared pointer, so the simulation thread only ever reads a complete set of weights and never waits.
+
+File format (little endian):
+  char magic[4] = "LSTW", uint32 version = 1, uint32 num_layers
+  per layer:  uint32 inputs, uint32 units, float kernel[], float recurrent[], float bias[]
+  dense:      uint32 inputs, uint32 outputs, uint32 activation (0 sigmoid, 1 softmax), float kernel[], float bias[]
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace native_lstm {
+
+struct layer {
+    int inputs = 0;
+    int units = 0;
+    std::vector<float> kernel;                      // inputs x 4*units
+    std::vector<float> recurrent;                   // units x 4*units
+    std::vector<float> bias;                        // 4*units
+};
+
+struct model {
+    std::vector<layer> layers;
+    int outputs = 0;
+    bool softmax = false;                           // Softmax classes (delta mode) or sigmoid bits
+    std::vector<float> dense_kernel;                // last units x outputs
+    std::vector<float> dense_bias;                  // outputs
+};
+
+// (h, c) of every layer, carried between steps in stateful mode
+struct state {
+    std::vector<std::vector<float>> h;
+    std::vector<std::vector<float>> c;
+
+    void reset(const model& m) {
+        h.assign(m.layers.size(), {});
+        c.assign(m.layers.size(), {});
+        for (size_t l = 0; l < m.layers.size(); ++l) {
+            h[l].assign(m.layers[l].units, 0.0f);
+            c[l].assign(m.layers[l].units, 0.0f);
+        }
+    }
+};
+
+inline float sigmoid(float x) { return 1.0f / (1.0f + std::exp(-x)); }
+
+// Reads the weights written by export_native_weights() in NN_train2.py
+inline bool load(const std::string& path, model& m)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    auto read_u32 = [&file]() {
+        uint32_t value = 0;
+        file.read(reinterpret_cast<char*>(&value), sizeof(value));
+        return value;
+    };
+    auto read_floats = [&file](std::vector<float>& values, size_t count) {
+        values.resize(count);
+        file.read(reinterpret_cast<char*>(values.data()), count * sizeof(float));
+    };
+
+    char magic[4];
+    file.read(magic, sizeof(magic));
+    if (!file || std::memcmp(magic, "LSTW", 4) != 0 || read_u32() != 1) {
+        return false;
+    }
+
+    m = model();
+    m.layers.resize(read_u32());
+    for (layer& l : m.layers) {
+        l.inputs = read_u32();
+        l.units = read_u32();
+        read_floats(l.kernel, static_cast<size_t>(l.inputs) * 4 * l.units);
+        read_floats(l.recurrent, static_cast<size_t>(l.units) * 4 * l.units);
+        read_floats(l.bias, 4 * static_cast<size_t>(l.units));
+    }
+
+    int dense_inputs = read_u32();
+    m.outputs = read_u32();
+    m.softmax = read_u32() == 1;
+    read_floats(m.dense_kernel, static_cast<size_t>(dense_inputs) * m.outputs);
+    read_floats(m.dense_bias, m.outputs);
+
+    return static_cast<bool>(file) && !m.layers.empty() && dense_inputs == m.layers.back().units;
+}
+
+// Activations of one layer at one step, kept for backpropagation
+struct step_record {
+    std::vector<float> x, h_prev, c_prev;
+    std::vector<float> i, f, g, o, c, tanh_c, h;
+};
+
+// z = x * kernel + h_prev * recurrent + bias, accumulated row by row so the kernels are read sequentially.
+// Layer 0 inputs are 0/1 bits, so zero inputs are skipped.
+inline void gate_inputs(const layer& l, const float* x, const float* h_prev, std::vector<float>& z)
+{
+    const int width = 4 * l.units;
+    z.assign(l.bias.begin(), l.bias.end());
+    for (int k = 0; k < l.inputs; ++k) {
+        if (x[k] == 0.0f) {
+            continue;
+        }
+        const float* row = &l.kernel[static_cast<size_t>(k) * width];
+        for (int j = 0; j < width; ++j) {
+            z[j] += x[k] * row[j];
+        }
+    }
+    for (int k = 0; k < l.units; ++k) {
+        if (h_prev[k] == 0.0f) {
+            continue;
+        }
+        const float* row = &l.recurrent[static_cast<size_t>(k) * width];
+        for (int j = 0; j < width; ++j) {
+            z[j] += h_prev[k] * row[j];
+        }
+    }
+}
+
+// Dense layer followed by the sigmoid or softmax activation
+inline void dense_output(const model& m, const std::vector<float>& h, std::vector<float>& out)
+{
+    out.assign(m.dense_bias.begin(), m.dense_bias.end());
+    for (size_t k = 0; k < h.size(); ++k) {
+        const float* row = &m.dense_kernel[k * m.outputs];
+        for (int j = 0; j < m.outputs; ++j) {
+            out[j] += h[k] * row[j];
+        }
+    }
+
+    if (m.softmax) {
+        float max_logit = *std::max_element(out.begin(), out.end());
+        float sum = 0.0f;
+        for (float& value : out) {
+            value = std::exp(value - max_logit);
+            sum += value;
+        }
+        for (float& value : out) {
+            value /= sum;
+        }
+    } else {
+        for (float& value : out) {
+            value = sigmoid(value);
+        }
+    }
+}
+
+// Advances every layer by one timestep and writes the output probabilities.
+// When records is not null the activations of each layer are appended for backpropagation.
+inline void step(const model& m, state& s, const float* x, std::vector<float>& out, std::vector<step_record>* records = nullptr)
+{
+    std::vector<float> z;
+    std::vector<float> layer_input(x, x + m.layers.front().inputs);
+
+    for (size_t l = 0; l < m.layers.size(); ++l) {
+        const layer& lw = m.layers[l];
+        const int u = lw.units;
+        gate_inputs(lw, layer_input.data(), s.h[l].data(), z);
+
+        step_record record;
+        if (records) {
+            record.x = layer_input;
+            record.h_prev = s.h[l];
+            record.c_prev = s.c[l];
+            record.i.resize(u);
+            record.f.resize(u);
+            record.g.resize(u);
+            record.o.resize(u);
+            record.tanh_c.resize(u);
+        }
+
+        for (int j = 0; j < u; ++j) {
+            float gate_i = sigmoid(z[j]);
+            float gate_f = sigmoid(z[u + j]);
+            float gate_g = std::tanh(z[2 * u + j]);
+            float gate_o = sigmoid(z[3 * u + j]);
+            s.c[l][j] = gate_f * s.c[l][j] + gate_i * gate_g;
+            float tanh_c = std::tanh(s.c[l][j]);
+            s.h[l][j] = gate_o * tanh_c;
+
+            if (records) {
+                record.i[j] = gate_i;
+                record.f[j] = gate_f;
+                record.g[j] = gate_g;
+                record.o[j] = gate_o;
+                record.tanh_c[j] = tanh_c;
+            }
+        }
+
+        if (records) {
+            record.c = s.c[l];
+            record.h = s.h[l];
+            records->push_back(std::move(record));
+        }
+        layer_input = s.h[l];
+    }
+
+    dense_output(m, s.h.back(), out);
+}
+
+// Trains on one window of consecutive steps starting from the given state, which is advanced to the end of the
+// window (the gradient is truncated there). targets holds m.outputs values per step: the offset bits, or a one-hot
+// class in softmax mode. Both losses give (p - y) at the output logits. Steps before first_labeled_step only feed
+// the state and carry no loss. Returns the mean loss of the labeled steps.
+inline float train_window(model& m, state& s, const std::vector<float>& inputs, const std::vector<float>& targets,
+                          int steps, float learning_rate, int first_labeled_step = 0, float gradient_clip = 1.0f)
+{
+    const size_t num_layers = m.layers.size();
+    const int in0 = m.layers.front().inputs;
+    const int outputs = m.outputs;
+
+    // Forward pass, records[t * num_layers + l]
+    std::vector<step_record> records;
+    records.reserve(steps * num_layers);
+    std::vector<std::vector<float>> probabilities(steps);
+    const int labeled = steps - first_labeled_step;
+    float loss = 0.0f;
+    for (int t = 0; t < steps; ++t) {
+        step(m, s, &inputs[static_cast<size_t>(t) * in0], probabilities[t], &records);
+        if (t < first_labeled_step) {
+            continue;
+        }
+        const float* y = &targets[static_cast<size_t>(t) * outputs];
+        for (int j = 0; j < outputs; ++j) {
+            float p = std::min(std::max(probabilities[t][j], 1e-7f), 1.0f - 1e-7f);
+            loss -= m.softmax ? y[j] * std::log(p) : y[j] * std::log(p) + (1.0f - y[j]) * std::log(1.0f - p);
+        }
+    }
+
+    // Gradients, same shapes as the weights
+    std::vector<std::vector<float>> d_kernel(num_layers), d_recurrent(num_layers), d_bias(num_layers);
+    for (size_t l = 0; l < num_layers; ++l) {
+        d_kernel[l].assign(m.layers[l].kernel.size(), 0.0f);
+        d_recurrent[l].assign(m.layers[l].recurrent.size(), 0.0f);
+        d_bias[l].assign(m.layers[l].bias.size(), 0.0f);
+    }
+    std::vector<float> d_dense_kernel(m.dense_kernel.size(), 0.0f);
+    std::vector<float> d_dense_bias(m.dense_bias.size(), 0.0f);
+
+    // Output layer, gives the gradient reaching the top LSTM layer at each step
+    const int top_units = m.layers.back().units;
+    std::vector<std::vector<float>> d_from_above(steps, std::vector<float>(top_units, 0.0f));
+    for (int t = first_labeled_step; t < steps; ++t) {
+        const float* y = &targets[static_cast<size_t>(t) * outputs];
+        const std::vector<float>& h = records[t * num_layers + num_layers - 1].h;
+        for (int j = 0; j < outputs; ++j) {
+            float d_logit = (probabilities[t][j] - y[j]) / labeled;
+            d_dense_bias[j] += d_logit;
+            for (int k = 0; k < top_units; ++k) {
+                d_dense_kernel[static_cast<size_t>(k) * outputs + j] += h[k] * d_logit;
+                d_from_above[t][k] += m.dense_kernel[static_cast<size_t>(k) * outputs + j] * d_logit;
+            }
+        }
+    }
+
+    // LSTM layers top down, each one backwards through time
+    for (size_t l = num_layers; l-- > 0;) {
+        const layer& lw = m.layers[l];
+        const int u = lw.units;
+        const int width = 4 * u;
+        std::vector<float> d_h_next(u, 0.0f), d_c_next(u, 0.0f), d_z(width);
+        std::vector<std::vector<float>> d_inputs(steps, std::vector<float>(lw.inputs, 0.0f));
+
+        for (int t = steps; t-- > 0;) {
+            const step_record& r = records[t * num_layers + l];
+            for (int j = 0; j < u; ++j) {
+                float d_h = d_from_above[t][j] + d_h_next[j];
+                float d_o = d_h * r.tanh_c[j];
+                float d_c = d_h * r.o[j] * (1.0f - r.tanh_c[j] * r.tanh_c[j]) + d_c_next[j];
+                d_z[j] = d_c * r.g[j] * r.i[j] * (1.0f - r.i[j]);
+                d_z[u + j] = d_c * r.c_prev[j] * r.f[j] * (1.0f - r.f[j]);
+                d_z[2 * u + j] = d_c * r.i[j] * (1.0f - r.g[j] * r.g[j]);
+                d_z[3 * u + j] = d_o * r.o[j] * (1.0f - r.o[j]);
+                d_c_next[j] = d_c * r.f[j];
+            }
+
+            for (int j = 0; j < width; ++j) {
+                d_bias[l][j] += d_z[j];
+            }
+            for (int k = 0; k < lw.inputs; ++k) {
+                const float* row = &lw.kernel[static_cast<size_t>(k) * width];
+                float* d_row = &d_kernel[l][static_cast<size_t>(k) * width];
+                float d_x = 0.0f;
+                for (int j = 0; j < width; ++j) {
+                    d_row[j] += r.x[k] * d_z[j];
+                    d_x += row[j] * d_z[j];
+                }
+                d_inputs[t][k] = d_x;
+            }
+            for (int k = 0; k < u; ++k) {
+                const float* row = &lw.recurrent[static_cast<size_t>(k) * width];
+                float* d_row = &d_recurrent[l][static_cast<size_t>(k) * width];
+                float d_h_prev = 0.0f;
+                for (int j = 0; j < width; ++j) {
+                    d_row[j] += r.h_prev[k] * d_z[j];
+                    d_h_prev += row[j] * d_z[j];
+                }
+                d_h_next[k] = d_h_prev;
+            }
+        }
+        d_from_above = std::move(d_inputs);
+    }
+
+    // Clipped SGD update
+    auto apply = [learning_rate, gradient_clip](std::vector<float>& weights, const std::vector<float>& gradient) {
+        for (size_t n = 0; n < weights.size(); ++n) {
+            weights[n] -= learning_rate * std::min(std::max(gradient[n], -gradient_clip), gradient_clip);
+        }
+    };
+    for (size_t l = 0; l < num_layers; ++l) {
+        apply(m.layers[l].kernel, d_kernel[l]);
+        apply(m.layers[l].recurrent, d_recurrent[l]);
+        apply(m.layers[l].bias, d_bias[l]);
+    }
+    apply(m.dense_kernel, d_dense_kernel);
+    apply(m.dense_bias, d_dense_bias);
+
+    return loss / labeled;
+}
+
+// Background trainer with double-buffered weights.
+// The front buffer is the published model read by the predictor, the back buffer is a private copy the trainer
+// thread updates. After each batch the back buffer is published with an atomic pointer swap; readers holding the
+// old front keep it alive until they drop it, so neither side ever waits on the other.
+// A batch is a run of consecutive steps trained with truncated BPTT and the state carried across windows. In
+// windowed mode each sample is instead a (previous, current) input pair trained from zero state, as it is predicted.
+class online_trainer {
+public:
+    uint64_t batches_submitted = 0;                 // Batches handed to the trainer thread
+    uint64_t batches_dropped = 0;                   // Batches dropped because the trainer was still busy
+    std::atomic<uint64_t> batches_trained{0};       // Batches finished and published
+    std::atomic<float> last_loss{0.0f};             // Mean loss of the last trained batch
+
+    online_trainer() = default;
+    online_trainer(const online_trainer&) = delete;
+    online_trainer& operator=(const online_trainer&) = delete;
+
+    ~online_trainer() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+    // Sets the initial weights and starts the trainer thread
+    void start(std::shared_ptr<const model> initial, int bptt_length, float learning_rate, bool windowed_samples) {
+        std::atomic_store(&front, initial);
+        window = bptt_length;
+        rate = learning_rate;
+        windowed = windowed_samples;
+        worker = std::thread(&online_trainer::run, this);
+    }
+
+    // Current published weights, safe to use for as long as the pointer is held
+    std::shared_ptr<const model> live() const { return std::atomic_load(&front); }
+
+    // Hands a batch of labeled samples to the trainer, dropping it if the previous one is still pending.
+    // Each sample has one input (two in windowed mode) and m.outputs targets. Never blocks the caller.
+    void submit(std::vector<float>&& inputs, std::vector<float>&& targets, int steps) {
+        std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+        if (!lock.owns_lock() || has_batch) {
+            batches_dropped++;
+            return;
+        }
+        batch_inputs = std::move(inputs);
+        batch_targets = std::move(targets);
+        batch_steps = steps;
+        has_batch = true;
+        batches_submitted++;
+        lock.unlock();
+        wake.notify_one();
+    }
+
+private:
+    std::shared_ptr<const model> front;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    bool has_batch = false;
+    std::vector<float> batch_inputs, batch_targets;
+    int batch_steps = 0;
+    int window = 16;
+    float rate = 0.001f;
+    bool windowed = false;
+
+    void run() {
+        while (true) {
+            std::vector<float> inputs, targets;
+            int steps = 0;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || has_batch; });
+                if (stopping) {
+                    return;
+                }
+                inputs.swap(batch_inputs);
+                targets.swap(batch_targets);
+                steps = batch_steps;
+                has_batch = false;
+            }
+
+            // Back buffer: a private copy of the current front
+            auto back = std::make_shared<model>(*live());
+            const int in0 = back->layers.front().inputs;
+            const int outputs = back->outputs;
+
+            state s;
+            s.reset(*back);
+            float loss_sum = 0.0f;
+            int windows = 0;
+
+            // Windowed samples: the previous input only feeds the state, the label belongs to the current one
+            if (windowed) {
+                for (int sample = 0; sample < steps; ++sample) {
+                    std::vector<float> pair_inputs(inputs.begin() + static_cast<size_t>(sample) * 2 * in0,
+                                                   inputs.begin() + static_cast<size_t>(sample + 1) * 2 * in0);
+                    std::vector<float> pair_targets(2 * static_cast<size_t>(outputs), 0.0f);
+                    std::copy(targets.begin() + static_cast<size_t>(sample) * outputs,
+                              targets.begin() + static_cast<size_t>(sample + 1) * outputs, pair_targets.begin() + outputs);
+                    s.reset(*back);
+                    loss_sum += train_window(*back, s, pair_inputs, pair_targets, 2, rate, 1);
+                    windows++;
+                }
+            }
+
+            // Truncated BPTT over the batch, state carried from one window to the next
+            for (int start = 0; !windowed && start < steps; start += window) {
+                int length = std::min(window, steps - start);
+                std::vector<float> window_inputs(inputs.begin() + static_cast<size_t>(start) * in0,
+                                                 inputs.begin() + static_cast<size_t>(start + length) * in0);
+                std::vector<float> window_targets(targets.begin() + static_cast<size_t>(start) * outputs,
+                                                  targets.begin() + static_cast<size_t>(start + length) * outputs);
+                loss_sum += train_window(*back, s, window_inputs, window_targets, length, rate);
+                windows++;
+            }
+
+            std::atomic_store(&front, std::shared_ptr<const model>(std::move(back)));
+            last_loss = windows == 0 ? 0.0f : loss_sum / windows;
+            batches_trained++;
+        }
+    }
+};
+
+} // namespace native_lstm
+
+#endif
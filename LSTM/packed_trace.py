@@ -0,0 +1,72 @@
+import numpy as np
+
+# Packed L2 trace reader, the Python side of common/l2_trace.h
+# Traces come from the capture hook in lstm.cc (Capture_trace) or from tools/l2clog_to_trace. The file is mapped
+# with np.memmap and every step below works on whole arrays, so there is no per-line Python work and no text file.
+
+HEADER_SIZE = 32                    # Bytes before the first record
+RECORD_DTYPE = np.dtype([           # Must match l2_access_record
+    ('addr', '<u8'),
+    ('ip', '<u8'),
+    ('cycle_delta', '<u4'),
+    ('type', 'u1'),
+    ('hit', 'u1'),
+    ('reserved', '<u2'),
+])
+
+# Field widths of the 49 bit input, same as input_process() in NN_train2.py
+PAGE_NUMBER_SIZE = 14
+PAGE_OFFSET_SIZE = 12
+CYCLE_DELTA_SIZE = 22
+TYPE_SIZE = 1
+LOG2_BLOCK_SIZE = 6
+
+# Maps the records of a trace without reading them
+def load_records(path):
+    header = np.fromfile(path, dtype=np.uint8, count=HEADER_SIZE)
+    if header[:4].tobytes() != b'L2AT':
+        raise ValueError(f"{path} is not a packed L2 trace")
+    return np.memmap(path, dtype=RECORD_DTYPE, mode='r', offset=HEADER_SIZE)
+
+# Spreads each value over width columns of 0/1, most significant bit first like zfill() on bin()
+def to_bits(values, width):
+    shifts = np.arange(width - 1, -1, -1, dtype=np.uint64)
+    return ((values.astype(np.uint64)[:, None] >> shifts) & 1).astype(np.int8)
+
+# 49 bit input of every record: page number, page offset, cycle delta, type
+def to_inputs(records):
+    addr = records['addr']
+    cycle = np.minimum(records['cycle_delta'], (1 << CYCLE_DELTA_SIZE) - 1)       # Saturate instead of overflowing the field
+    return np.concatenate([
+        to_bits((addr >> 12) & ((1 << PAGE_NUMBER_SIZE) - 1), PAGE_NUMBER_SIZE),
+        to_bits(addr & ((1 << PAGE_OFFSET_SIZE) - 1), PAGE_OFFSET_SIZE),
+        to_bits(cycle, CYCLE_DELTA_SIZE),
+        to_bits(records['type'] & 1, TYPE_SIZE),
+    ], axis=1)
+
+# Keeps only the misses, with cycle deltas recomputed between the misses that remain
+def select_misses(records):
+    cycles = np.cumsum(records['cycle_delta'], dtype=np.uint64)
+    keep = records['hit'] == 0
+    selected = np.array(records[keep])
+    kept_cycles = cycles[keep]
+    selected['cycle_delta'] = np.minimum(np.diff(kept_cycles, prepend=kept_cycles[:1]), np.iinfo(np.uint32).max)
+    return selected
+
+# Same result as preprocess_stream() in NN_train2.py: steps, next page offset bits and next cache line delta
+def preprocess_stream(path, misses_only=False):
+    records = load_records(path)
+    if misses_only:
+        records = select_misses(records)
+    inputs = to_inputs(records)
+    lines = (records['addr'] >> LOG2_BLOCK_SIZE).astype(np.int64)
+    steps = inputs[:-1]
+    labels = inputs[1:, PAGE_NUMBER_SIZE:PAGE_NUMBER_SIZE + PAGE_OFFSET_SIZE]
+    deltas = lines[1:] - lines[:-1]
+    return steps, labels, deltas
+
+# Same result as preprocess_file(): (previous, current) input pairs flattened to 98 columns and the next page offset
+def preprocess_file(path, misses_only=False):
+    steps, labels, _ = preprocess_stream(path, misses_only)
+    sequences = np.concatenate([steps[:-1], steps[1:]], axis=1)
+    return sequences, labels[1:]
@@ -0,0 +1,801 @@
+#ifndef MISB_MISB_H
+#define MISB_MISB_H
+
+#include <algorithm>
+#include <bitset>
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../common/pf_bits.h"
+#include "../common/pf_component.h"
+#include "../common/pf_extent.h"
+#include "../common/pf_geometry.h"
+#include "../common/pf_stats.h"
+
+namespace misb {
+
+// Structure sizes of one prefetcher, common/pf_geometry.h by default
+// tools/replay/sweep.cc runs several geometries side by side on one trace
+struct geometry {
+    uint32_t ps_sets = Misb_ps_sets;
+    uint32_t ps_ways = Misb_ps_ways;
+    uint32_t sp_sets = Misb_sp_sets;
+    uint32_t sp_ways = Misb_sp_ways;
+    uint32_t run_length = Misb_run_length;
+    uint32_t lookahead_distance = Misb_lookahead_distance;
+    uint32_t lookahead_keys = Misb_lookahead_keys;
+    int bloom_bits = Misb_bloom_bits;
+};
+
+// Entry Class for a run of consecutive keys (physical lines in the PS cache, structural addresses in the SP cache)
+// Keys in a stream map to lines that are close together, so one entry keeps the line the run would start at if its
+// values were consecutive too (base) and each key only stores how far its value is from base + its slot.
+// The deltas are packed in the cache next to the entries, see CompressedCache.
+class Entry {
+public:
+    uint64_t base;
+    uint32_t lru;
+    uint16_t tag;          // Low Misb_tag_bits of the run number above the set index
+    uint16_t valid_slots;  // Bit per key of the run
+
+    Entry() : base(0), lru(0), tag(0), valid_slots(0) {}
+    Entry(uint64_t _base, uint16_t _tag) : base(_base), lru(0), tag(_tag), valid_slots(0) {}
+
+    bool valid() const { return valid_slots != 0; }
+};
+
+// BloomFilter 
+//needs to use a hash and is checked before going off chip
+template <std::size_t Bits = pf_dynamic>
+class BloomFilter {
+public:
+    pf_extent<Bits> size;
+    std::vector<bool> set;
+
+    explicit BloomFilter(std::size_t size_ = Bits) : size(size_), set(size.get(), false) {}
+
+    void add(int item) {
+        for (int i = 0; i < 2; ++i) {
+            int index = hash(item, i);
+            if (index >= 0 && index < bits()) {
+                set[index] = true;
+            } else {
+               // std::cerr << "[ERROR] BloomFilter invalid index: " << index << "\n";
+            }
+        }
+    }
+
+    bool contains(int item) const {
+        for (int i = 0; i < 2; ++i) {
+            int index = hash(item, i);
+            if (index < 0 || index >= bits() || !set[index]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    int bits() const { return static_cast<int>(size.get()); }
+
+    int hash(int item, int i) const {
+        int a = i;
+        int b = i + 1;
+        int p = 104792; // prime number for hashing
+        int result = ((a * item + b) % p) % bits();
+        if (result < 0 || result >= bits()) {
+            //std::cerr << "[ERROR] BloomFilter hash out-of-bounds: result=" << result << ", size=" << size << "\n";
+        }
+        return result;
+    }
+};
+
+//needed to make a seperate cache structure to implement the ps and the sp cache. 
+//sets, ways and the run length are template arguments so the set index is a shift and a mask and the way loops unroll
+//ValueBits is the width of the mapped value (structural address or physical line) in the modeled hardware
+template <std::size_t ValueBits, std::size_t Sets = pf_dynamic, std::size_t Ways = pf_dynamic, std::size_t Run = pf_dynamic>
+class CompressedCache {
+    static_assert(Misb_tag_bits <= 16, "Entry::tag holds at most 16 bits");
+
+public:
+    std::vector<Entry> array;
+    pf_packed_array<Misb_delta_bits> deltas;  // Entry i's key k at i * run + k
+    pf_extent<Sets> sets;
+    pf_extent<Ways> ways;
+    pf_extent<Run> run;
+    uint32_t lru_count;
+    uint64_t restarts;  // Writes whose value was too far from the run for a delta
+
+    CompressedCache(uint32_t sets_ = Sets, uint32_t ways_ = Ways, uint32_t run_ = Run)
+        : array(sets_ * ways_), deltas(static_cast<std::size_t>(sets_) * ways_ * run_), sets(sets_), ways(ways_), run(run_),
+          lru_count(0), restarts(0) {
+        assert(run.get() >= 1 && run.get() <= 16);
+    }
+
+    // Value mapped to address, -1 on a miss
+    uint64_t read(uint64_t address) {
+        uint64_t slot = run.mod(address);
+        int index = find(run.div(address));
+        if (index < 0 || !(array[index].valid_slots >> slot & 1)) {
+            return -1; // Cache miss
+        }
+        array[index].lru = lru_count++;
+        return decode(index, slot);
+    }
+
+    // Whether address has a value, without touching the LRU state
+    bool contains(uint64_t address) const {
+        int index = find(run.div(address));
+        return index >= 0 && (array[index].valid_slots >> run.mod(address) & 1);
+    }
+
+    void write(uint64_t address, uint64_t value) {
+        uint64_t run_number = run.div(address);
+        uint64_t slot = run.mod(address);
+        int index = find(run_number);
+        if (index >= 0) {
+            int64_t delta = static_cast<int64_t>(value - (array[index].base + slot));
+            if (pf_fits_signed(delta, Misb_delta_bits)) {
+                deltas.set(index * run.get() + slot, pf_pack_signed(delta, Misb_delta_bits));
+                array[index].valid_slots |= 1u << slot;
+                array[index].lru = lru_count++;
+                return;
+            }
+            // The value does not fit the run, start it over from this key and drop the rest of the run
+            ++restarts;
+        } else {
+            index = victim(set_of(run_number));
+        }
+        array[index] = Entry(value - slot, tag_of(run_number));
+        deltas.set(index * run.get() + slot, 0);
+        array[index].valid_slots = 1u << slot;
+        array[index].lru = lru_count++;
+    }
+
+    // Keys that currently have a value
+    uint64_t mappings() const {
+        uint64_t count = 0;
+        for (const auto& entry : array) {
+            count += std::bitset<16>(entry.valid_slots).count();
+        }
+        return count;
+    }
+
+    // Size in the modeled hardware: a partial tag, the base, log2(ways) lru bits and a valid bit per key for each
+    // entry, and a delta per key once a run covers more than one
+    static constexpr uint64_t modeled_bits(std::size_t sets_, std::size_t ways_, std::size_t run_) {
+        return sets_ * ways_ * (Misb_tag_bits + ValueBits + pf_log2(ways_) + run_ + (run_ > 1 ? run_ * Misb_delta_bits : 0));
+    }
+    uint64_t modeled_bits() const { return modeled_bits(sets.get(), ways.get(), run.get()); }
+
+    uint64_t footprint_bytes() const { return pf_vector_bytes(array) + deltas.host_bytes(); }
+
+private:
+    uint32_t set_of(uint64_t run_number) const { return static_cast<uint32_t>(sets.mod(run_number)); }
+    uint16_t tag_of(uint64_t run_number) const { return static_cast<uint16_t>(pf_low_bits(sets.div(run_number), Misb_tag_bits)); }
+
+    uint64_t decode(int index, uint64_t slot) const {
+        return array[index].base + slot + pf_unpack_signed(deltas.get(index * run.get() + slot), Misb_delta_bits);
+    }
+
+    // Entry holding the run, -1 if none
+    int find(uint64_t run_number) const {
+        uint32_t set_index = set_of(run_number);
+        uint16_t tag = tag_of(run_number);
+        const uint32_t num_ways = static_cast<uint32_t>(ways.get());
+        PF_UNROLL
+        for (uint32_t i = 0; i < num_ways; ++i) {
+            uint32_t index = set_index * num_ways + i;
+            if (array[index].valid() && array[index].tag == tag) {
+                return static_cast<int>(index);
+            }
+        }
+        return -1;
+    }
+
+    // An empty way of the set, or its least recently used one
+    int victim(uint32_t set_index) const {
+        uint32_t min_lru = lru_count + 10;
+        int evict_way = 0;
+        const uint32_t num_ways = static_cast<uint32_t>(ways.get());
+        PF_UNROLL
+        for (uint32_t i = 0; i < num_ways; ++i) {
+            uint32_t index = set_index * num_ways + i;
+            if (!array[index].valid()) {
+                return static_cast<int>(index);
+            }
+            if (array[index].lru < min_lru) {
+                min_lru = array[index].lru;
+                evict_way = i;
+            }
+        }
+        return static_cast<int>(set_index * num_ways + evict_way);
+    }
+};
+
+// How the ways of the shared LLC metadata cache are divided between cores, see MetadataStore
+enum class partition_policy { NONE, WAY, UTILITY };
+const partition_policy Metadata_partition_policy = partition_policy::UTILITY;
+const std::size_t Utility_sample_interval = 16;     // Every 16th LLC metadata set has utility monitors
+
+// The full PS and SP mappings, kept in DRAM behind the on-chip caches
+// Mappings move in metadata lines of Misb_metadata_line_keys consecutive keys. Every new mapping updates a line of each
+// and every line read into the on-chip caches is counted, which is the off-chip traffic the metadata costs.
+//
+// Each MISB has a store of its own, unless misb.cc is built with -DMISB_SHARED_METADATA. Then every core's MISB
+// shares one store, and an LLC-resident cache of metadata lines sits in front of DRAM. A mapping written by one core
+// serves every core, so cores touching the same lines do not each keep a copy. LLC lines are tagged with the core
+// that brought them in, and Metadata_partition_policy divides each set's ways between the cores:
+//   NONE     plain LRU
+//   WAY      an equal share of the ways for every core
+//   UTILITY  every Misb_partition_epoch LLC accesses, the ways are redivided greedily by how many more hits each
+//            core's next way would bring, which per core utility monitors measure on a sample of the sets
+// A core under its share evicts from cores over theirs, and a core at its share evicts its own lines, so one
+// streaming core cannot push out everyone else's mappings. Every call takes the store's lock, so cores simulated on
+// separate threads can share it.
+class MetadataStore {
+public:
+    struct core_counts {
+        uint64_t lines_written = 0;
+        uint64_t demand_lines_read = 0;     // PS lines read from DRAM for a PS miss the Bloom filter says is off chip
+        uint64_t lookahead_lines_read = 0;  // SP lines read from DRAM ahead of the stream and the PS lines they map to
+        uint64_t llc_hits = 0;
+        uint64_t llc_misses = 0;
+        uint64_t llc_cross_core_hits = 0;   // Hits on a line another core brought in
+        uint32_t llc_ways = 0;              // Current share of each LLC set
+    };
+
+    // 0 LLC sets, a private store, reads every line from DRAM
+    explicit MetadataStore(std::size_t llc_sets_ = 0, std::size_t llc_ways_ = 0)
+        : llc_sets(llc_sets_ == 0 ? 1 : llc_sets_), llc_ways(static_cast<uint32_t>(llc_ways_)), llc(llc_sets_ * llc_ways_) {}
+
+    void write(uint32_t core, uint64_t physical_line, uint64_t structural_address) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ps[physical_line] = structural_address;
+        sp[structural_address] = physical_line;
+        core_of(core).lines_written += 2;
+    }
+
+    // First structural address of a new stream, Misb_stream_chunk apart so streams of every core stay disjoint
+    uint64_t allocate_chunk() {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint64_t first = next_chunk;
+        next_chunk += Misb_stream_chunk;
+        return first;
+    }
+
+    // Brings the PS (sp false) or SP metadata line into the core's caches: each(key, value) is called for every
+    // mapping the line holds. The line comes from the LLC metadata cache when it is there, otherwise from DRAM.
+    template <typename F>
+    void read_line(uint32_t core, bool sp_line, uint64_t metadata_line, bool lookahead, F&& each) {
+        std::lock_guard<std::mutex> lock(mutex);
+        core_counts& counts = core_of(core);
+        if (!llc_access(core, 2 * metadata_line + sp_line)) {
+            (lookahead ? counts.lookahead_lines_read : counts.demand_lines_read)++;
+        }
+        const std::unordered_map<uint64_t, uint64_t>& mappings = sp_line ? sp : ps;
+        uint64_t first = metadata_line * Misb_metadata_line_keys;
+        for (uint64_t key = first; key < first + Misb_metadata_line_keys; ++key) {
+            auto found = mappings.find(key);
+            if (found != mappings.end()) {
+                each(key, found->second);
+            }
+        }
+    }
+
+    core_counts counts(uint32_t core) {
+        std::lock_guard<std::mutex> lock(mutex);
+        core_counts result = core_of(core);
+        result.llc_ways = core < quota.size() ? quota[core] : 0;
+        return result;
+    }
+
+    bool has_llc() const { return !llc.empty(); }
+
+    static uint64_t line_of(uint64_t key) { return key / Misb_metadata_line_keys; }
+
+    uint64_t footprint_bytes() {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint64_t bytes = pf_hash_bytes(ps) + pf_hash_bytes(sp) + pf_vector_bytes(llc) + pf_vector_bytes(cores) + pf_vector_bytes(monitors);
+        for (const utility_monitor& m : monitors) {
+            bytes += pf_vector_bytes(m.tags) + pf_vector_bytes(m.hits);
+        }
+        return bytes;
+    }
+
+private:
+    struct llc_line {
+        uint64_t tag = 0;  // Metadata line * 2 + 1 for SP lines
+        uint32_t owner = 0;
+        uint32_t lru = 0;
+        bool valid = false;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<uint64_t, uint64_t> ps;  // Physical line -> structural address
+    std::unordered_map<uint64_t, uint64_t> sp;  // Structural address -> physical line
+    uint64_t next_chunk = 0;
+
+    pf_extent<pf_dynamic> llc_sets;
+    uint32_t llc_ways;
+    std::vector<llc_line> llc;
+    uint32_t lru_count = 0;
+
+    std::vector<core_counts> cores;
+    std::vector<uint32_t> quota;  // LLC ways per set each core may fill
+    uint64_t epoch_accesses = 0;
+
+    // Utility monitor of a core: the tags the core would keep in each sampled set if it had every way to itself,
+    // most recent first, and the hits each recency position gets, i.e. the hits the core's n-th way is worth
+    struct utility_monitor {
+        std::vector<uint64_t> tags;  // Tag + 1, 0 is empty
+        std::vector<uint64_t> hits;
+    };
+    std::vector<utility_monitor> monitors;
+
+    core_counts& core_of(uint32_t core) {
+        if (core >= cores.size()) {
+            cores.resize(core + 1);
+            monitors.resize(core + 1, {std::vector<uint64_t>(sampled_sets() * llc_ways, 0), std::vector<uint64_t>(llc_ways, 0)});
+            split_evenly();
+        }
+        return cores[core];
+    }
+
+    std::size_t sampled_sets() const { return llc.empty() ? 0 : (llc_sets.get() + Utility_sample_interval - 1) / Utility_sample_interval; }
+
+    // Hit or fill of the LLC metadata cache, false on a miss
+    bool llc_access(uint32_t core, uint64_t tag) {
+        if (llc.empty()) {
+            return false;
+        }
+        if (++epoch_accesses == Misb_partition_epoch) {
+            if (Metadata_partition_policy == partition_policy::UTILITY) {
+                split_by_utility();
+            }
+            epoch_accesses = 0;
+        }
+
+        // PS and SP lines of the same number share a set
+        uint64_t set_index = llc_sets.mod(tag >> 1);
+        if (set_index % Utility_sample_interval == 0) {
+            monitor(core, set_index / Utility_sample_interval, tag);
+        }
+        llc_line* set = &llc[set_index * llc_ways];
+        for (uint32_t i = 0; i < llc_ways; ++i) {
+            if (set[i].valid && set[i].tag == tag) {
+                set[i].lru = lru_count++;
+                cores[core].llc_hits++;
+                cores[core].llc_cross_core_hits += set[i].owner != core;
+                return true;
+            }
+        }
+        cores[core].llc_misses++;
+        set[victim(core, set)] = {tag, core, lru_count++, true};
+        return false;
+    }
+
+    void monitor(uint32_t core, uint64_t sampled_set, uint64_t tag) {
+        utility_monitor& m = monitors[core];
+        uint64_t* stack = &m.tags[sampled_set * llc_ways];
+        uint32_t position = 0;
+        while (position + 1 < llc_ways && stack[position] != tag + 1) {
+            position++;
+        }
+        if (stack[position] == tag + 1) {
+            m.hits[position]++;
+        }
+        std::copy_backward(stack, stack + position, stack + position + 1);
+        stack[0] = tag + 1;
+    }
+
+    // An empty way, else the LRU line of a core over its share when the core is under its own, else its own LRU line
+    uint32_t victim(uint32_t core, const llc_line* set) const {
+        std::vector<uint32_t> occupancy(cores.size(), 0);
+        for (uint32_t i = 0; i < llc_ways; ++i) {
+            if (!set[i].valid) {
+                return i;
+            }
+            occupancy[set[i].owner]++;
+        }
+
+        auto lru_of = [&](auto eligible) {
+            int way = -1;
+            for (uint32_t i = 0; i < llc_ways; ++i) {
+                if (eligible(set[i]) && (way < 0 || set[i].lru < set[way].lru)) {
+                    way = static_cast<int>(i);
+                }
+            }
+            return way;
+        };
+        int way = -1;
+        if (Metadata_partition_policy != partition_policy::NONE) {
+            if (occupancy[core] < quota[core]) {
+                way = lru_of([&](const llc_line& line) { return occupancy[line.owner] > quota[line.owner]; });
+            } else {
+                way = lru_of([&](const llc_line& line) { return line.owner == core; });
+            }
+        }
+        if (way < 0) {
+            way = lru_of([](const llc_line&) { return true; });
+        }
+        return static_cast<uint32_t>(way);
+    }
+
+    void split_evenly() {
+        std::size_t n = cores.size();
+        quota.assign(n, 0);
+        for (uint32_t way = 0; way < std::max<std::size_t>(llc_ways, n); ++way) {
+            quota[way % n]++;
+        }
+    }
+
+    // Every core keeps a way and the rest are handed out with UCP's lookahead: the core whose next few ways bring the
+    // most monitored hits per way gets those ways. Then the monitors are halved so older epochs fade.
+    void split_by_utility() {
+        std::size_t n = cores.size();
+        quota.assign(n, 1);
+        std::size_t spare = llc_ways > n ? llc_ways - n : 0;
+        while (spare > 0) {
+            std::size_t best = n, best_ways = 0;
+            double best_utility = -1.0;
+            for (std::size_t c = 0; c < n; ++c) {
+                uint64_t hits = 0;
+                for (std::size_t k = 1; k <= spare && quota[c] + k <= llc_ways; ++k) {
+                    hits += monitors[c].hits[quota[c] + k - 1];
+                    if (static_cast<double>(hits) / k > best_utility) {
+                        best = c;
+                        best_ways = k;
+                        best_utility = static_cast<double>(hits) / k;
+                    }
+                }
+            }
+            quota[best] += best_ways;
+            spare -= best_ways;
+        }
+        for (utility_monitor& m : monitors) {
+            for (uint64_t& h : m.hits) {
+                h /= 2;
+            }
+        }
+    }
+};
+
+// Metadata lines read recently, so a line is not read again while the copy already on chip is still there
+// Direct mapped on the line number, like the recent line table in common/pf_issue.h
+class FetchFilter {
+    static_assert((Misb_fetch_filter_size & (Misb_fetch_filter_size - 1)) == 0, "Misb_fetch_filter_size must be a power of two");
+
+public:
+    FetchFilter() : recent(Misb_fetch_filter_size, 0) {}
+
+    // False if key was read recently, otherwise remembers it
+    bool insert(uint64_t key) {
+        uint64_t& slot = recent[key & (Misb_fetch_filter_size - 1)];
+        if (slot == key + 1) {
+            return false;
+        }
+        slot = key + 1;  // Key + 1, 0 is empty
+        return true;
+    }
+
+    uint64_t footprint_bytes() const { return pf_vector_bytes(recent); }
+
+private:
+    std::vector<uint64_t> recent;
+};
+
+// The prefetcher itself, one per cache. misb.cc runs it on its own and ENSEMBLE/ensemble.cc next to the others.
+// MISBPrefetcher below has the structure sizes of common/pf_geometry.h built in, dynamic_prefetcher takes them at run time.
+template <std::size_t PsSets, std::size_t PsWays, std::size_t SpSets, std::size_t SpWays, std::size_t Run, std::size_t BloomBits>
+class basic_prefetcher final : public pf_component {
+public:
+    // The PS cache maps physical lines to structural addresses, the SP cache structural addresses to physical lines
+    using ps_cache_type = CompressedCache<Misb_structural_address_bits, PsSets, PsWays, Run>;
+    using sp_cache_type = CompressedCache<Physical_address_bits - pf_log2(Block_size), SpSets, SpWays, Run>;
+    using bloom_filter_type = BloomFilter<BloomBits>;
+
+    static_assert(PsSets == pf_dynamic
+                      || ps_cache_type::modeled_bits(PsSets, PsWays, Run) + sp_cache_type::modeled_bits(SpSets, SpWays, Run) + BloomBits
+                             <= Misb_storage_budget_bytes * 8,
+                  "MISB structures exceed Misb_storage_budget_bytes");
+
+    // store is the metadata store shared by every core, null for a store of its own
+    explicit basic_prefetcher(std::string stats_name = "misb", const geometry& sizes_ = geometry(), std::shared_ptr<MetadataStore> store_ = nullptr)
+        : sizes(sizes_), store(std::move(store_)), shared_store(store != nullptr), stats(std::move(stats_name)) {
+        reset_structures();
+        stats.add_structure("ps_cache");
+        stats.add_structure("sp_cache");
+        stats.add_structure("bloom_filter");
+    }
+
+    // This function has most of the logic and uses the address and the ip given from the function
+    // It tracks prefetching statistics to make sure that every part of the prefetcher works as intended
+    void operate(CACHE* cache, uint64_t addr, uint64_t ip, bool cache_hit, bool useful_prefetch, uint8_t type, uint32_t metadata_in,
+                 pf_issuer& issuer) override {
+        ++total_accesses;  // Every call is one access, prefetches are counted by pf_stats
+        useful_prefetches += useful_prefetch;
+        stats.on_access(cache->warmup, addr, cache_hit, useful_prefetch);
+
+        // error checking to make sure that the address is valid
+        if (addr == 0 || addr > UINT64_MAX / 2) {
+            std::cerr << "[ERROR] Invalid physical address: " << addr << "\n";
+            return;
+        }
+
+        // try to get the structual address.
+        uint64_t line = addr >> LOG2_BLOCK_SIZE;
+        uint64_t structural_address = specialized_ps_cache->read(line);
+        stats.on_lookup(cache->warmup, PS_cache_lookup, structural_address != (uint64_t)-1);
+
+        if (structural_address == (uint64_t)-1) {
+            ++ps_cache_misses;  // Increment PS cache miss count.
+
+            // Check if the is in the Bloom filter.
+            bool in_filter = bloom_filter->contains(line);
+            stats.on_lookup(cache->warmup, Bloom_filter_lookup, in_filter);
+            if (!in_filter) {
+                ++bloom_filter_misses;  // Increment Bloom filter miss count.
+
+                // Generate a new structural address and add it to the PS and SP caches, and the Bloom filter.
+                uint64_t new_structural_address = next_in_stream(ip);
+                specialized_ps_cache->write(line, new_structural_address);  // Add to PS cache.
+                specialized_sp_cache->write(new_structural_address, line);  // Add to SP cache.
+                store->write(cache->cpu, line, new_structural_address);  // Add to the off-chip metadata.
+                bloom_filter->add(line);  // add to the Bloom filter.
+                structural_address = new_structural_address;  // Update the structural address.
+            } else {
+                ++bloom_filter_hits;  // Increment Bloom filter hit count.
+
+                // The mapping is off chip, read its PS line in for the next access. It comes back too late to prefetch
+                // for this one, but ip's stream goes on from it and the lookahead reads in the mappings its next accesses need.
+                fetch_ps_line(cache->cpu, MetadataStore::line_of(line), false);
+                uint64_t fetched = specialized_ps_cache->read(line);
+                if (fetched != (uint64_t)-1) {
+                    train(ip, fetched);
+                    lookahead(cache->cpu, fetched);
+                }
+            }
+        } else {
+            ++ps_cache_hits;  // Increment PS cache hit count.
+        }
+
+        // If a valid structural address is found or generated, initiate prefetching.
+        if (structural_address != (uint64_t)-1) {
+            train(ip, structural_address);
+            prefetch_structural_addresses(cache, ip, structural_address, metadata_in, issuer);  // Issue prefetch requests.
+        }
+    }
+
+    void fill(CACHE* cache, uint64_t addr, bool prefetch, uint64_t evicted_addr) override {
+        stats.on_fill(cache->warmup, addr, prefetch, evicted_addr);
+    }
+
+    void final_stats(CACHE* cache) override {
+        //probably not needed but did just in case so that there was no issue
+        // Output current stats
+        std::cout << "----- Prefetching Statistics -----\n";
+        std::cout << "Total Accesses: " << total_accesses << "\n";
+        std::cout << "PS Cache Hits: " << ps_cache_hits << "\n";
+        std::cout << "PS Cache Misses: " << ps_cache_misses << "\n";
+        std::cout << "SP Cache Hits: " << sp_cache_hits << "\n";
+        std::cout << "SP Cache Misses: " << sp_cache_misses << "\n";
+        std::cout << "Bloom Filter Hits: " << bloom_filter_hits << "\n";
+        std::cout << "Bloom Filter Misses: " << bloom_filter_misses << "\n";
+
+        // On-chip metadata reach of the compressed PS/SP entries, each cache on its own. A stream whose lines are in
+        // order compresses in both; an irregular one restarts its runs on nearly every write and keeps one mapping per entry.
+        report_compression("PS", *specialized_ps_cache);
+        report_compression("SP", *specialized_sp_cache);
+
+        // Off-chip metadata traffic of this core, in metadata lines
+        MetadataStore::core_counts traffic = store->counts(cache->cpu);
+        uint64_t lines_read = traffic.demand_lines_read + traffic.lookahead_lines_read;
+        std::cout << "Metadata Lines Read (Demand): " << traffic.demand_lines_read << "\n";
+        std::cout << "Metadata Lines Read (Lookahead): " << traffic.lookahead_lines_read << "\n";
+        std::cout << "Metadata Lines Written: " << traffic.lines_written << "\n";
+        std::cout << "Lookahead Reads Filtered: " << lookahead_filtered << "\n";
+        std::cout << "Metadata Lines Per Useful Prefetch: "
+                  << (useful_prefetches == 0 ? 0.0 : static_cast<double>(lines_read + traffic.lines_written) / useful_prefetches) << "\n";
+        if (store->has_llc()) {
+            std::cout << "LLC Metadata Hits: " << traffic.llc_hits << "\n";
+            std::cout << "LLC Metadata Misses: " << traffic.llc_misses << "\n";
+            std::cout << "LLC Metadata Cross-Core Hits: " << traffic.llc_cross_core_hits << "\n";
+            std::cout << "LLC Metadata Ways: " << traffic.llc_ways << "\n";
+        }
+
+        stats.report(cache->NAME);
+    }
+
+    // Clears the counters and structures for the next simulation
+    void reset() {
+        total_accesses = 0;
+        ps_cache_hits = 0;
+        ps_cache_misses = 0;
+        sp_cache_hits = 0;
+        sp_cache_misses = 0;
+        bloom_filter_hits = 0;
+        bloom_filter_misses = 0;
+        useful_prefetches = 0;
+        lookahead_filtered = 0;
+
+        reset_structures();
+    }
+
+    // The structural addresses prefetched on a hit are distance .. distance + degree - 1 past it
+    void throttle(const pf_aggressiveness& level) override {
+        prefetch_distance = level.distance;
+        prefetch_degree = level.degree;
+    }
+
+    pf_stats* quality_stats() override { return &stats; }
+
+    void footprint(pf_profile& profile) const override {
+        profile.structure("bloom_filter", sizeof(bloom_filter_type) + (bloom_filter->set.size() + 7) / 8, 2, bloom_filter->set.size());
+        profile.structure("ps_cache", specialized_ps_cache->footprint_bytes(), 3, specialized_ps_cache->modeled_bits());
+        profile.structure("sp_cache", specialized_sp_cache->footprint_bytes(), 3, specialized_sp_cache->modeled_bits());
+        profile.structure("fetch_filter", fetch_filter.footprint_bytes(), 1);
+        profile.structure("training_unit", pf_vector_bytes(training_unit), 1);
+        profile.structure(shared_store ? "shared_metadata" : "offchip_metadata", store->footprint_bytes(), 1);
+    }
+
+    // Data structures, public for tools/bench
+    std::unique_ptr<bloom_filter_type> bloom_filter;
+    std::unique_ptr<ps_cache_type> specialized_ps_cache;
+    std::unique_ptr<sp_cache_type> specialized_sp_cache;
+
+private:
+    geometry sizes;
+
+    static constexpr int PS_cache_lookup = 0;
+    static constexpr int SP_cache_lookup = 1;
+    static constexpr int Bloom_filter_lookup = 2;
+
+    // Prefetching Statistics coutners to see if every part of the prefetcher is working correctly
+    uint32_t total_accesses = 0;
+    uint32_t ps_cache_hits = 0;
+    uint32_t ps_cache_misses = 0;
+    uint32_t sp_cache_hits = 0;
+    uint32_t sp_cache_misses = 0;
+    uint32_t bloom_filter_hits = 0;
+    uint32_t bloom_filter_misses = 0;
+    uint64_t useful_prefetches = 0;
+    uint64_t lookahead_filtered = 0;  // Lookahead lines the fetch filter saw read recently
+
+    int prefetch_distance = 1;
+    int prefetch_degree = 3;
+
+    std::shared_ptr<MetadataStore> store;
+    bool shared_store;
+    FetchFilter fetch_filter;
+
+    // Training unit: the structural address of each PC's last access, so the lines one PC misses on in a row get
+    // consecutive structural addresses and a later hit prefetches that PC's stream
+    struct training_entry {
+        uint64_t ip = 0;
+        uint64_t structural_address = 0;
+        bool valid = false;
+    };
+    std::vector<training_entry> training_unit;
+
+    pf_stats stats;
+
+    void reset_structures() {
+        specialized_ps_cache = std::make_unique<ps_cache_type>(sizes.ps_sets, sizes.ps_ways, sizes.run_length);
+        specialized_sp_cache = std::make_unique<sp_cache_type>(sizes.sp_sets, sizes.sp_ways, sizes.run_length);
+        bloom_filter = std::make_unique<bloom_filter_type>(sizes.bloom_bits);
+        if (!shared_store) {
+            store = std::make_shared<MetadataStore>();
+        }
+        fetch_filter = FetchFilter();
+        training_unit.assign(Misb_training_entries, training_entry());
+    }
+
+    training_entry& training_of(uint64_t ip) { return training_unit[ip % training_unit.size()]; }
+
+    // Structural address of a line ip has not been seen on before: the one after ip's last access, unless the stream
+    // has no last access, reached the end of its chunk or the next address is taken, then a new chunk
+    uint64_t next_in_stream(uint64_t ip) {
+        const training_entry& entry = training_of(ip);
+        if (entry.valid && entry.ip == ip) {
+            uint64_t next = entry.structural_address + 1;
+            if (next % Misb_stream_chunk != 0 && !specialized_sp_cache->contains(next)) {
+                return next;
+            }
+        }
+        return store->allocate_chunk();
+    }
+
+    void train(uint64_t ip, uint64_t structural_address) {
+        training_entry& entry = training_of(ip);
+        entry.ip = ip;
+        entry.structural_address = structural_address;
+        entry.valid = true;
+    }
+
+    template <typename Cache>
+    void report_compression(const char* name, const Cache& compressed) const {
+        double kilobytes = compressed.modeled_bits() / 8.0 / 1024.0;
+        std::cout << name << " Mappings: " << compressed.mappings() << "\n";
+        std::cout << name << " Run Restarts: " << compressed.restarts << "\n";
+        std::cout << name << " Effective Mappings Per KB: " << compressed.mappings() / kilobytes << "\n";
+        std::cout << name << " Mapping Capacity Per KB: " << compressed.array.size() * sizes.run_length / kilobytes << "\n";
+    }
+
+    // Reads a PS metadata line into the PS cache, unless the fetch filter saw it read recently
+    void fetch_ps_line(uint32_t core, uint64_t metadata_line, bool lookahead) {
+        if (fetch_filter.insert(2 * metadata_line)) {
+            store->read_line(core, false, metadata_line, lookahead,
+                             [&](uint64_t key, uint64_t value) { specialized_ps_cache->write(key, value); });
+        }
+    }
+
+    // Metadata lookahead: the stream hit the SP cache at structural_address, so the SP lines lookahead_distance
+    // structural addresses ahead, and the PS lines of the physical lines they map to, are read into the on-chip
+    // caches before the stream gets there
+    void lookahead(uint32_t core, uint64_t structural_address) {
+        if (sizes.lookahead_keys == 0) {
+            return;
+        }
+        uint64_t first = structural_address + sizes.lookahead_distance;
+        uint64_t last = first + sizes.lookahead_keys - 1;
+        for (uint64_t metadata_line = MetadataStore::line_of(first); metadata_line <= MetadataStore::line_of(last); ++metadata_line) {
+            if (!fetch_filter.insert(2 * metadata_line + 1)) {
+                ++lookahead_filtered;
+                continue;
+            }
+
+            // The PS lines are read once the SP line is in, outside the store's lock
+            std::vector<uint64_t> physical_lines;
+            store->read_line(core, true, metadata_line, true, [&](uint64_t key, uint64_t value) {
+                specialized_sp_cache->write(key, value);
+                physical_lines.push_back(value);
+            });
+            for (uint64_t physical_line : physical_lines) {
+                fetch_ps_line(core, MetadataStore::line_of(physical_line), true);
+            }
+        }
+    }
+
+    // Prefetch Logic for Structural Addresses
+    // The next structural addresses that map back to a physical line in the SP cache are prefetched
+    // The first SP hit starts a metadata lookahead further down the stream
+    void prefetch_structural_addresses(CACHE* cache, uint64_t ip, uint64_t base_structural_address, uint32_t metadata_in, pf_issuer& issuer) {
+        bool looked_ahead = false;
+        for (int i = prefetch_distance; i < prefetch_distance + prefetch_degree; ++i) {
+            uint64_t next_structural_address = base_structural_address + i;
+            if (next_structural_address > UINT64_MAX / 2) {
+                std::cerr << "[ERROR] Prefetching invalid structural address: " << next_structural_address << "\n";
+            }
+
+            uint64_t next_physical_line = specialized_sp_cache->read(next_structural_address);
+            bool sp_hit = next_physical_line != (uint64_t)-1 && next_physical_line != 0;
+            stats.on_lookup(cache->warmup, SP_cache_lookup, sp_hit);
+            if (sp_hit) {
+                ++sp_cache_hits;
+                uint64_t next_physical_address = next_physical_line << LOG2_BLOCK_SIZE;
+                int confidence = Confidence_max - (i - prefetch_distance);  // Less sure the further down the stream
+                stats.on_prefetch(cache->warmup, next_physical_address, ip, issuer.issue(next_physical_address, true, metadata_in, confidence));
+                if (!looked_ahead) {
+                    lookahead(cache->cpu, next_structural_address);
+                    looked_ahead = true;
+                }
+            } else {
+                ++sp_cache_misses;
+            }
+        }
+    }
+};
+
+using MISBPrefetcher = basic_prefetcher<Misb_ps_sets, Misb_ps_ways, Misb_sp_sets, Misb_sp_ways, Misb_run_length, Misb_bloom_bits>;
+using dynamic_prefetcher = basic_prefetcher<pf_dynamic, pf_dynamic, pf_dynamic, pf_dynamic, pf_dynamic, pf_dynamic>;
+
+} // namespace misb
+
+#endif
@@ -6,8 +6,15 @@
 
 #include "msl/lru_table.h"
 
+#include "../common/pf_extent.h"
+#include "../common/pf_geometry.h"
+#include "../common/pf_pipeline.h"
+#include "../common/pf_profile.h"
+#include "../common/pf_stats.h"
+
 // Includes for things not defined in Champsim
 #include <cstdint>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -56,29 +63,32 @@ public:
   }
 };
 
-template <typename t>
+// sets and ways come from common/pf_geometry.h, so the set index is a shift and a mask
+template <typename t, uint32_t Sets, uint32_t Ways>
 class cache_specialized
 {
 public:
+  static constexpr uint32_t sets = Sets;
+  static constexpr uint32_t ways = Ways;
+
   vector<entry<t>>& dram; // Reference to the shared dram vector
   vector<entry<t>> array; // The cache array
-  uint32_t sets;
-  uint32_t ways;
   uint32_t lru_count = 0;
 
-  cache_specialized(uint32_t ways_, uint32_t sets_, vector<entry<t>>& dram_) : dram(dram_), sets(sets_), ways(ways_)
+  explicit cache_specialized(vector<entry<t>>& dram_) : dram(dram_)
   {
     // No need to initialize dram here, as it's passed as a reference
     array.resize(sets * ways);
   }
 
-  uint64_t read(uint64_t address, uint32_t sets, uint32_t ways, cache_specialized<uint64_t>& other_cache, bool is_PS, uint64_t structural_address);
+  uint64_t read(uint64_t address, cache_specialized& other_cache, bool is_PS, uint64_t structural_address);
   void write(entry<t> data, uint64_t address);
 };
 
-template <typename t>
-uint64_t cache_specialized<t>::read(uint64_t address, uint32_t sets, uint32_t ways, cache_specialized<uint64_t>& other_cache, bool is_PS,
-                                    uint64_t structural_address)
+using metadata_cache = cache_specialized<uint64_t, Misb_real_sets, Misb_real_ways>;
+
+template <typename t, uint32_t Sets, uint32_t Ways>
+uint64_t cache_specialized<t, Sets, Ways>::read(uint64_t address, cache_specialized& other_cache, bool is_PS, uint64_t structural_address)
 {
   uint32_t min_lru = lru_count + 10;
   lru_count++;
@@ -132,14 +142,15 @@ uint64_t cache_specialized<t>::read(uint64_t address, uint32_t sets, uint32_t wa
   }
   return addressToPrefetch;
 }
-template <typename t>
-void cache_specialized<t>::write(entry<t> data, uint64_t addr)
+template <typename t, uint32_t Sets, uint32_t Ways>
+void cache_specialized<t, Sets, Ways>::write(entry<t> data, uint64_t addr)
 {
   uint32_t min_lru_way = 0;
   uint32_t min_lru = lru_count++;
   uint32_t set_index = (addr / ways) % sets;
 
-  for (int i = 0; i < ways; i++) {
+  PF_UNROLL
+  for (uint32_t i = 0; i < ways; i++) {
     if (array.at((set_index * ways) + i).physical_address == addr && array.at((set_index * ways) + i).valid) {
       array.at((set_index * ways) + i) = data;
       array.at((set_index * ways) + i).dirty = true;
@@ -169,10 +180,10 @@ uint64_t address = 0;
 bool cacheMiss = false;
 
 struct BloomFilter {
+  static constexpr int size = Misb_real_bloom_bits;
   std::vector<bool> set;
-  int size;
 
-  BloomFilter() : size(17 * 1024 * 8), set(size, false) {}
+  BloomFilter() : set(size, false) {}
 
   void add(int item)
   { // adding the item
@@ -205,10 +216,10 @@ struct BloomFilter {
 BloomFilter bloom_filter;
 
 // Constants
-static constexpr uint32_t dramSize =  147483647; // Adjust as needed
-static constexpr uint32_t NumSets = 128;   // Adjust as needed
-static constexpr uint32_t NumWays = 8;     // Adjust as needed
-
+#ifndef MISB_REAL_DRAM_SIZE
+#define MISB_REAL_DRAM_SIZE 147483647 // Backing store entries, tools/bench builds with a smaller one
+#endif
+static constexpr uint32_t dramSize = MISB_REAL_DRAM_SIZE; // Adjust as needed
 vector<entry<uint64_t>> dram(dramSize);
 
 // Initialize the dram array
@@ -219,8 +230,8 @@ vector<entry<uint64_t>> dram(dramSize);
 std::unordered_map<uint64_t, uint64_t> pc_to_structural_address;
 
 // Global variables
-cache_specialized<uint64_t> PS_cache(NumSets, NumWays, dram);
-cache_specialized<uint64_t> SP_cache(NumSets, NumWays, dram);
+metadata_cache PS_cache(dram);
+metadata_cache SP_cache(dram);
 
 uint64_t get_structural_address(uint64_t ip, uint64_t physical_address); // Function declaration
 
@@ -231,6 +242,7 @@ uint64_t get_structural_address(uint64_t ip, uint64_t physical_address); // Func
 // This function is called when the cache is initialized. You can use it to initialize elements of dynamic structures, such as std::vector or std::map.
 void CACHE::prefetcher_initialize()
 {
+  PF_PROFILE_HOOK(this, "misb_real", initialize);
   for (int i = 0; i < dramSize; i++) {
     dram[i].physical_address = i;
   }
@@ -241,40 +253,92 @@ uint64_t misb_prefetch(uint64_t addr, uint64_t ip)
         return addr + (1 << LOG2_BLOCK_SIZE);
     }
 
-    uint64_t addressToPrefetch = PS_cache.read(addr, NumSets, NumWays, SP_cache, true, get_structural_address(ip, addr));
+    uint64_t addressToPrefetch = PS_cache.read(addr, SP_cache, true, get_structural_address(ip, addr));
     return (addressToPrefetch);
 }
 
 
+// Prefetch quality statistics for each cache using this prefetcher
+std::map<CACHE*, pf_stats> misb_real_stats;
+
+pf_stats& stats_for(CACHE* cache)
+{
+  return misb_real_stats.try_emplace(cache, "misb_real").first->second;
+}
+
+// Throttle, placement, filters and candidate queue in front of each cache, see common/pf_pipeline.h.
+// The throttle only sets the fill level here, the degree is always one.
+std::map<CACHE*, pf_pipeline> pipelines;
+
+pf_pipeline& pipeline_for(CACHE* cache)
+{
+  return pipelines.try_emplace(cache, "misb_real", false, &stats_for(cache)).first->second;
+}
+
+// Reports the MISB structures to the host time profile (-DPF_PROFILE), see common/pf_profile.h
+void profile_footprint(pf_profile& profile, CACHE* cache)
+{
+  profile.structure("dram", pf_vector_bytes(dram), 1);
+  profile.structure("ps_cache", pf_vector_bytes(PS_cache.array), 1);
+  profile.structure("sp_cache", pf_vector_bytes(SP_cache.array), 1);
+  profile.structure("bloom_filter", sizeof(BloomFilter) + (bloom_filter.set.size() + 7) / 8, 1);
+  profile.structure("physical_to_structural_address", pf_hash_bytes(physical_to_structural_address), 1 + physical_to_structural_address.size());
+  profile.structure("pc_to_structural_address", pf_hash_bytes(pc_to_structural_address), 1 + pc_to_structural_address.size());
+  pipeline_for(cache).footprint(profile);
+}
+
 uint32_t CACHE::prefetcher_cache_operate(uint64_t addr, uint64_t ip, uint8_t cache_hit, bool useful_prefetch, uint8_t type, uint32_t metadata_in)
 {
-    uint64_t addressToPrefetch = 0;
+  PF_PROFILE_HOOK(this, "misb_real", cache_operate);
+  PF_PROFILE_FOOTPRINT(this, "misb_real", profile_footprint);
+  pf_stats& stats = stats_for(this);
+  stats.on_access(warmup, addr, cache_hit, useful_prefetch);
+  pf_pipeline& pipeline = pipeline_for(this);
+  pipeline.on_access(this, addr, cache_hit, useful_prefetch);
+
   if (!cache_hit) {          // if there is a miss in the cache
-     addressToPrefetch = misb_prefetch(addr, ip); // I want to prefetch that line
+     uint64_t addressToPrefetch = misb_prefetch(addr, ip); // I want to prefetch that line
+     // Nothing mapped, no prefetch
+     if (addressToPrefetch != 0) {
+       pf_pipeline::issuer issuer(pipeline, this, addr, ip);
+       pf_issue_result result = issuer.issue(addressToPrefetch, true, 0, Confidence_max / 2);
+       stats.on_prefetch(warmup, addressToPrefetch, ip, result);
+     }
   }
-     prefetch_line(addressToPrefetch, true, 0);
   return metadata_in;
 }
 
 
 uint32_t CACHE::prefetcher_cache_fill(uint64_t addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_addr, uint32_t metadata_in)
 {
+  PF_PROFILE_HOOK(this, "misb_real", cache_fill);
+  stats_for(this).on_fill(warmup, addr, prefetch, evicted_addr);
+  pipeline_for(this).on_fill(addr, prefetch, evicted_addr);
   return metadata_in;
 }
 
 // I need to create a ps and Sp stable. there I will check for the values
 
-void CACHE::prefetcher_cycle_operate() {}
+void CACHE::prefetcher_cycle_operate()
+{
+  PF_PROFILE_HOOK(this, "misb_real", cycle_operate);
+  pipeline_for(this).cycle(this);
+}
 
-void CACHE::prefetcher_final_stats() {}
+void CACHE::prefetcher_final_stats()
+{
+  stats_for(this).report(NAME);
+  pipeline_for(this).report(NAME);
+  PF_PROFILE_REPORT(this, "misb_real", profile_footprint);
+}
 
 /***********************************************************************************************************************************************/
 //**************Helper Functions**************************************************/
 /***********************************************************************************************************************************************/
 
-bool isFull_cache(cache_specialized<uint64_t> cache, uint32_t set_index)
+bool isFull_cache(const metadata_cache& cache, uint32_t set_index)
 {
-  for (int i = 0; i < cache.ways; i++) {
+  for (uint32_t i = 0; i < cache.ways; i++) {
     if (!cache.array.at(set_index * cache.ways + i).valid) {
       return false;
     }
@@ -282,12 +346,12 @@ bool isFull_cache(cache_specialized<uint64_t> cache, uint32_t set_index)
   return true;
 }
 
-void evict_cache(cache_specialized<uint64_t>& cache, uint32_t set_index)
+void evict_cache(metadata_cache& cache, uint32_t set_index)
 {
   if (isFull_cache(cache, set_index)) {
     int min_lru = INT_MAX;
     int min_lru_way = -1;
-    for (int i = 0; i < cache.ways; i++) {
+    for (uint32_t i = 0; i < cache.ways; i++) {
       if (cache.array.at(set_index * cache.ways + i).lru < min_lru) {
         min_lru = cache.array.at(set_index * cache.ways + i).lru;
         min_lru_way = i;
@@ -0,0 +1,272 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "cache.h"
+
+#include "../common/l2_trace.h"
+#include "../common/pf_profile.h"
+#include "../common/pf_stats.h"
+
+/*
+Oracle prefetcher, the upper bound the real prefetchers are measured against.
+
+It knows the future: at initialize it maps the packed L2 trace (common/l2_trace.h) the run replays, captured with
+no L2 prefetcher, and pre-scans it for the recorded misses. During the run it follows the access stream through the
+log and prefetches the misses to come, straight to the cache, without the filters, throttle or placement of the
+real prefetchers. The log is <Oracle_log_dir>/<cache name>.l2t, as written by the capture-only module
+CAPTURE/capture.cc run in place of the L2 prefetcher, or the file named by the ORACLE_MISS_LOG environment variable.
+LSTM/lstm.cc's Capture_trace is not a substitute, its hit bits include LSTM's own prefetches.
+
+Following the stream: every access is looked up in the next Oracle_sync_window records of the log, by line and ip.
+A match moves the log cursor past it; an access that is not there (a different run, a wrong path) leaves the
+cursor where it is and is counted. The misses still to come are the recorded misses after the cursor.
+
+Modes, Oracle_mode or the ORACLE_MODE environment variable (coverage, timeliness or bandwidth):
+  coverage    every access keeps the misses Oracle_distance to Oracle_distance + Oracle_degree - 1 ahead issued.
+              One the cache refuses is retried every cycle until it is accepted or demanded, so every recorded
+              miss is prefetched and only a short distance makes a prefetch late.
+  timeliness  every miss is issued Oracle_lead_cycles before it is due, its recorded cycle shifted by how far the
+              run is behind or ahead of the log at the last matched access. Distance and degree are not used.
+  bandwidth   as coverage, but every prefetch takes a token. One token is added every Oracle_bandwidth_cycles
+              cycles, at most Oracle_degree are saved up, and a miss demanded before it got a token is lost.
+
+Final stats add the oracle's own counters to the common/pf_stats.h report, under the module name oracle_<mode>.
+tools/headroom.py reads that report and the real prefetchers' to give their coverage and IPC as a fraction of it.
+*/
+
+namespace {
+
+enum class oracle_mode { COVERAGE, TIMELINESS, BANDWIDTH };
+
+const oracle_mode Oracle_mode = oracle_mode::COVERAGE;    // Unless ORACLE_MODE is set
+const std::string Oracle_log_dir = "traces";
+const uint64_t Oracle_distance = 16;                // Recorded misses between the next one and the first prefetched
+const uint64_t Oracle_degree = 4;                   // Recorded misses kept prefetched ahead of each access
+const uint64_t Oracle_lead_cycles = 200;            // Timeliness: cycles before the miss is due, about the miss latency
+const uint64_t Oracle_bandwidth_cycles = 8;         // Bandwidth: cycles per prefetch token
+const std::size_t Oracle_sync_window = 64;          // Log records searched for each access
+
+const char* mode_name(oracle_mode mode) {
+    switch (mode) {
+    case oracle_mode::TIMELINESS:
+        return "timeliness";
+    case oracle_mode::BANDWIDTH:
+        return "bandwidth";
+    default:
+        return "coverage";
+    }
+}
+
+oracle_mode mode_from_env() {
+    const char* value = std::getenv("ORACLE_MODE");
+    if (value == nullptr) {
+        return Oracle_mode;
+    }
+    for (oracle_mode mode : {oracle_mode::COVERAGE, oracle_mode::TIMELINESS, oracle_mode::BANDWIDTH}) {
+        if (std::string(value) == mode_name(mode)) {
+            return mode;
+        }
+    }
+    std::cerr << "Unknown ORACLE_MODE " << value << ", using " << mode_name(Oracle_mode) << std::endl;
+    return Oracle_mode;
+}
+
+class oracle {
+public:
+    void initialize(CACHE* cache) {
+        mode = mode_from_env();
+        stats = pf_stats("oracle_" + std::string(mode_name(mode)));
+
+        const char* env_path = std::getenv("ORACLE_MISS_LOG");
+        std::string path = env_path != nullptr ? env_path : Oracle_log_dir + "/" + cache->NAME + ".l2t";
+        if (!log.open(path)) {
+            std::cerr << "Oracle could not read miss log " << path << ", it will not prefetch" << std::endl;
+            return;
+        }
+        uint64_t cycle = log.first_cycle();
+        for (std::size_t i = 0; i < log.size(); ++i) {
+            cycle += log[i].cycle_delta;
+            if (log[i].hit == 0) {
+                misses.push_back({i, log[i].addr >> LOG2_BLOCK_SIZE, cycle});
+            }
+        }
+        log_cycle = log.first_cycle();
+        cycle_offset = static_cast<int64_t>(cache->current_cycle) - static_cast<int64_t>(log.first_cycle());
+    }
+
+    void operate(CACHE* cache, uint64_t addr, uint64_t ip, bool cache_hit, bool useful_prefetch) {
+        stats.on_access(cache->warmup, addr, cache_hit, useful_prefetch);
+        follow(cache, addr >> LOG2_BLOCK_SIZE, ip);
+        if (mode != oracle_mode::TIMELINESS) {
+            issue_window(cache);
+        }
+    }
+
+    void fill(CACHE* cache, uint64_t addr, bool prefetch, uint64_t evicted_addr) { stats.on_fill(cache->warmup, addr, prefetch, evicted_addr); }
+
+    void cycle(CACHE* cache) {
+        if (mode == oracle_mode::BANDWIDTH && ++token_cycles >= Oracle_bandwidth_cycles) {
+            token_cycles = 0;
+            tokens = std::min(tokens + 1, Oracle_degree);
+        }
+        if (mode == oracle_mode::TIMELINESS) {
+            issue_due(cache);
+        } else {
+            issue_window(cache);
+        }
+    }
+
+    void final_stats(CACHE* cache) {
+        stats.report(cache->NAME);
+        std::cout << "----- oracle_" << mode_name(mode) << " " << cache->NAME << " Oracle -----\n";
+        std::cout << "Log Records: " << log.size() << "\n";
+        std::cout << "Log Misses: " << misses.size() << "\n";
+        std::cout << "Accesses Followed: " << followed << "\n";
+        std::cout << "Accesses Not In Log: " << not_in_log << "\n";
+        std::cout << "Records Skipped: " << skipped << "\n";
+        std::cout << "Misses Prefetched: " << prefetched << "\n";
+        std::cout << "Misses Demanded Before Prefetch: " << passed << "\n";
+        std::cout << "Prefetches Refused (Retried): " << refused << "\n";
+    }
+
+    std::size_t footprint_bytes() const { return misses.capacity() * sizeof(future_miss); }
+
+private:
+    struct future_miss {
+        std::size_t record;                         // Index in the log
+        uint64_t line;
+        uint64_t cycle;                             // Recorded cycle
+    };
+
+    oracle_mode mode = Oracle_mode;
+    pf_stats stats{"oracle"};
+    l2_trace_reader log;
+    std::vector<future_miss> misses;
+    std::size_t next_record = 0;                    // Log cursor: the next record the stream should reach
+    std::size_t next_miss = 0;                      // First miss at or after the cursor
+    std::size_t next_issue = 0;                     // First miss not prefetched yet
+    uint64_t log_cycle = 0;                         // Recorded cycle of the record before the cursor
+    int64_t cycle_offset = 0;                       // Run cycle minus recorded cycle at the last matched access
+    uint64_t tokens = Oracle_degree;
+    uint64_t token_cycles = 0;
+
+    uint64_t followed = 0;
+    uint64_t not_in_log = 0;
+    uint64_t skipped = 0;
+    uint64_t prefetched = 0;
+    uint64_t passed = 0;
+    uint64_t refused = 0;                           // Every try, a miss may be refused many cycles in a row
+
+    void follow(CACHE* cache, uint64_t line, uint64_t ip) {
+        std::size_t end = std::min(next_record + Oracle_sync_window, log.size());
+        std::size_t match = next_record;
+        while (match < end && ((log[match].addr >> LOG2_BLOCK_SIZE) != line || log[match].ip != ip)) {
+            match++;
+        }
+        if (match == end) {
+            not_in_log++;
+            return;
+        }
+        followed++;
+        skipped += match - next_record;
+        for (std::size_t i = next_record; i <= match; ++i) {
+            log_cycle += log[i].cycle_delta;
+        }
+        next_record = match + 1;
+        cycle_offset = static_cast<int64_t>(cache->current_cycle) - static_cast<int64_t>(log_cycle);
+
+        while (next_miss < misses.size() && misses[next_miss].record < next_record) {
+            next_miss++;
+        }
+        if (next_issue < next_miss) {
+            passed += next_miss - next_issue;
+            next_issue = next_miss;
+        }
+    }
+
+    // Coverage and bandwidth: the misses in the window ahead of the cursor, in order, stopping at the first refusal
+    void issue_window(CACHE* cache) {
+        std::size_t first = next_miss + Oracle_distance;
+        std::size_t last = std::min<std::size_t>(first + Oracle_degree, misses.size());
+        next_issue = std::max(next_issue, first);
+        while (next_issue < last) {
+            if (mode == oracle_mode::BANDWIDTH && tokens == 0) {
+                return;
+            }
+            if (!prefetch(cache, misses[next_issue])) {
+                return;
+            }
+            tokens -= mode == oracle_mode::BANDWIDTH;
+            next_issue++;
+        }
+    }
+
+    // Timeliness: every miss whose due cycle is at most Oracle_lead_cycles away
+    void issue_due(CACHE* cache) {
+        next_issue = std::max(next_issue, next_miss);
+        while (next_issue < misses.size()) {
+            int64_t due = static_cast<int64_t>(misses[next_issue].cycle) + cycle_offset;
+            if (due > static_cast<int64_t>(cache->current_cycle + Oracle_lead_cycles)) {
+                return;
+            }
+            if (!prefetch(cache, misses[next_issue])) {
+                return;
+            }
+            next_issue++;
+        }
+    }
+
+    bool prefetch(CACHE* cache, const future_miss& miss) {
+        uint64_t pf_addr = miss.line << LOG2_BLOCK_SIZE;
+        if (!cache->prefetch_line(pf_addr, true, 0)) {
+            refused++;
+            return false;
+        }
+        // Refusals are retried every cycle, only the accepted prefetch goes to the quality stats
+        stats.on_prefetch(cache->warmup, pf_addr, log[miss.record].ip, pf_issue_result::ISSUED);
+        prefetched++;
+        return true;
+    }
+};
+
+std::map<CACHE*, oracle> oracles;
+
+} // namespace
+
+//outside the namespace so it is not an unused function when profiling is off
+void oracle_profile_footprint(pf_profile& profile, CACHE* cache) {
+    profile.structure("future_misses", ::oracles[cache].footprint_bytes(), 1);
+}
+
+void CACHE::prefetcher_initialize() {
+    PF_PROFILE_HOOK(this, "oracle", initialize);
+    ::oracles[this].initialize(this);
+}
+
+void CACHE::prefetcher_cycle_operate() {
+    PF_PROFILE_HOOK(this, "oracle", cycle_operate);
+    ::oracles[this].cycle(this);
+}
+
+uint32_t CACHE::prefetcher_cache_operate(uint64_t addr, uint64_t ip, uint8_t cache_hit, bool useful_prefetch, uint8_t type, uint32_t metadata_in) {
+    PF_PROFILE_HOOK(this, "oracle", cache_operate);
+    PF_PROFILE_FOOTPRINT(this, "oracle", oracle_profile_footprint);
+    ::oracles[this].operate(this, addr, ip, cache_hit, useful_prefetch);
+    return metadata_in;
+}
+
+uint32_t CACHE::prefetcher_cache_fill(uint64_t addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_addr, uint32_t metadata_in) {
+    PF_PROFILE_HOOK(this, "oracle", cache_fill);
+    ::oracles[this].fill(this, addr, prefetch, evicted_addr);
+    return metadata_in;
+}
+
+void CACHE::prefetcher_final_stats() {
+    ::oracles[this].final_stats(this);
+    PF_PROFILE_REPORT(this, "oracle", oracle_profile_footprint);
+}
@@ -0,0 +1,319 @@
+#ifndef TCP_TCP_H
+#define TCP_TCP_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../common/pf_bits.h"
+#include "../common/pf_component.h"
+#include "../common/pf_extent.h"
+#include "../common/pf_geometry.h"
+#include "../common/pf_stats.h"
+
+namespace tcp {
+
+/*
+This header implements the Tag Correlating Prefetcher described in the following paper:
+https://mrmgroup.cs.princeton.edu/papers/tag_sequence.pdf
+Using ChampSim; a cache simulator that is used to evaluate cache prefetchers.
+
+This TCP operates by using a Tag History Table (THT) and a Pattern History Table (PHT) to predict the next tag to prefetch.
+The TCP operates after the L1D cache and issues prefetches to L2.
+
+Further notes on the general specifics of this particular implementation can be found in the comments below.
+
+             John Iler 
+  Student - Electrical Engineering
+Texas A&M University College Station
+
+Updated: 4/23/2024
+
+
+
+Notes On Overall Functionality:
+
+  Update function: 
+                    split the miss address into missTag, missIndex (the L1D set) and offset with shifts
+                    access the THT row of missIndex
+                    locate tag_K (tag before missTag in that set as defined by TCP documentation) at the end of the row
+                    append miss_Tag to the row
+                    
+
+                    access PHT set missIndex with tag_k
+                    set corresponding tag' = missTag
+                    (tag' is the next Tag to prefetch as defined by TCP documentation)
+                    when populating the PHT:
+                      append tag_k and missTag to the first incomplete way of the set with tag_k representing tag
+                      and missTag representing tag'
+                    
+  Lookup Function:
+                    locate the PHT entry of set missIndex containing missTag
+                    fetch tag'
+                    set predictedAddress = tag' + missIndex
+                    issue predictedAdress to L2 cache using Prefetch_Line
+
+Variables Necessary and/or mentioned in the TCP documentation:
+  THT Variables:
+                int sets_L1DCache
+                int entriesPerRow_THT
+                int size_tag
+                int size_THT = sets_L1DCache * entriesPerRow_THT * size_tag
+                string missIndex
+                string missTag
+                string missAddress? -> determine what is provided from champsim 
+
+  PHT Variable:
+                int sets_L1D
+                int waysPerSet
+                int size_PHT = sets_PHT * 2 * waysPerSet * size_tag
+
+*/
+
+// Constants for THT and PHT sizes, generated into common/pf_geometry.h from champsim_config.json
+
+const int entriesPerRow_THT = Tcp_tht_entries_per_row; // Number of tags stored in each row of the THT. Can be adjusted.
+const int sets_L1D = L1D_sets; // Number of sets in the L1D cache found in champsim_config.json
+const int waysPerSet_PHT = Tcp_pht_ways; // Number of ways in each set of the L1D Cache. Found in champsim_config.json
+
+// Size of the tag in bits: the physical address minus the block offset and the L1D index
+const int tagSize = Physical_address_bits - pf_log2(Block_size) - pf_log2(sets_L1D);
+
+const int THT_SIZE = sets_L1D * entriesPerRow_THT * tagSize; // Reference Size of THT in bits based on TCP documentation
+const int PHT_SIZE = sets_L1D * waysPerSet_PHT * 2 * tagSize; // Reference Size of PHT in bits based on TCP documentation
+
+static_assert(THT_SIZE + PHT_SIZE <= static_cast<int>(Tcp_storage_budget_bits), "THT and PHT exceed Tcp_storage_budget_bits");
+
+// A PHT entry has no counter, so every correlation is trusted the same
+const int correlationConfidence = Confidence_max / 2;
+
+// Table geometry of one prefetcher, the constants above by default
+// tools/replay/sweep.cc runs several geometries side by side on one trace
+struct Geometry {
+    int entriesPerRow_THT = tcp::entriesPerRow_THT;
+    int sets_L1D = tcp::sets_L1D;
+    int waysPerSet_PHT = tcp::waysPerSet_PHT;
+
+    int tagSize() const { return Physical_address_bits - pf_log2(Block_size) - pf_log2(sets_L1D); }
+    int thtRows() const { return sets_L1D; }                                 // THT_SIZE / (entriesPerRow_THT * tagSize)
+    int phtEntries() const { return sets_L1D * waysPerSet_PHT; }             // PHT_SIZE / (2 * tagSize)
+};
+
+// Tags are stored in tagSize bits, the low bits of the tag (a partial tag above the modeled physical address space)
+// Known at compile time when the L1D sets are
+template <std::size_t Sets>
+constexpr std::size_t tagBits = Sets == pf_dynamic ? pf_dynamic : Physical_address_bits - pf_log2(Block_size) - pf_log2(Sets);
+
+// Tag History Table (THT) Implementation
+// Rows, RowLength and TagBits are compile time for the prefetcher ChampSim builds, pf_dynamic for tools/replay/sweep.cc
+template <std::size_t Rows = pf_dynamic, std::size_t RowLength = pf_dynamic, std::size_t TagBits = pf_dynamic>
+class TagHistoryTable {
+private:
+    // One row of tags per L1D set, packed back to back in tagSize bits each and indexed directly by the miss set index
+    // Row i holds the last rowLength miss tags of set i in [i * rowLength, (i + 1) * rowLength)
+    // Each row is a ring: heads[i] is the slot the next tag of set i goes to, which holds its oldest tag
+    pf_extent<Rows> rows;
+    pf_extent<RowLength> rowLength;
+    pf_packed_array<TagBits> THT_tags;
+    std::vector<uint32_t> heads;
+
+
+public:
+    // Constructor to initialize the THT
+    explicit TagHistoryTable(const Geometry& geometry = Geometry())
+        : rows(geometry.thtRows()), rowLength(geometry.entriesPerRow_THT),
+          THT_tags(rows.get() * rowLength.get(), static_cast<std::size_t>(geometry.tagSize())), heads(rows.get(), 0) {}
+
+
+    // Tag of the previous miss in a set (tag_k in the TCP documentation), 0 before the set's first miss
+    uint64_t lastTag(std::size_t set) const { return getTag(set, rowLength.get() - 1); }
+
+
+    // Function to update THT during cache miss
+    // set is the L1D set index of the miss, missTag_fromCache its tag
+    // Appending the tag to the row overwrites the row's oldest tag
+    void update(std::size_t set, uint64_t missTag_fromCache) {
+        THT_tags.set(set * rowLength.get() + heads[set], missTag_fromCache);
+        heads[set] = heads[set] + 1 == rowLength.get() ? 0 : heads[set] + 1;
+    }
+
+
+    // Function to get the k-th oldest tag of a set's tag sequence
+    // Not used for the TCP, here as placeholder as it may be useful for debugging
+    uint64_t getTag(std::size_t set, std::size_t k) const {
+        std::size_t slot = heads[set] + k;
+        return THT_tags.get(set * rowLength.get() + (slot >= rowLength.get() ? slot - rowLength.get() : slot));
+    }
+
+    // Resident and modeled size of the table, the ring heads model log2(rowLength) bits per row
+    uint64_t footprintBytes() const { return THT_tags.host_bytes() + pf_vector_bytes(heads); }
+    uint64_t modeledBits() const { return THT_tags.modeled_bits() + rows.get() * pf_log2(rowLength.get()); }
+};
+
+
+// Pattern History Table (PHT) Implementation
+// Sets, Ways and TagBits are compile time for the prefetcher ChampSim builds, pf_dynamic for tools/replay/sweep.cc
+template <std::size_t Sets = pf_dynamic, std::size_t Ways = pf_dynamic, std::size_t TagBits = pf_dynamic>
+class PatternHistoryTable {
+private:
+
+    // Each row contains two tags tag and tag' as described in the TCP documentation
+    // Rows are packed back to back in tagSize bits per tag, row i holds tag at 2 * i and tag' at 2 * i + 1
+    // Set i holds rows [i * ways, (i + 1) * ways), the set is the L1D set index of the miss
+    pf_packed_array<TagBits> PHT_tags;
+    pf_extent<Sets> sets;
+    pf_extent<Ways> ways;
+
+    uint64_t tag(std::size_t row) const { return PHT_tags.get(2 * row); }
+    uint64_t nextTag(std::size_t row) const { return PHT_tags.get(2 * row + 1); }
+
+
+public:
+    // Constructor to initialize the PHT
+    // each row contains two tags
+    explicit PatternHistoryTable(const Geometry& geometry = Geometry())
+        : PHT_tags(2 * static_cast<std::size_t>(geometry.phtEntries()), static_cast<std::size_t>(geometry.tagSize())),
+          sets(geometry.sets_L1D), ways(geometry.waysPerSet_PHT) {}
+
+
+    // Function to update PHT during cache miss
+    // tag_k is the tag of the previous miss in the same set
+    void update(std::size_t setIndex, uint64_t tag_k, uint64_t missTag_fromCache) {
+        const std::size_t numWays = ways.get();
+        const std::size_t first = setIndex * numWays;
+
+        // Iterate through the ways of the set
+        PF_UNROLL
+        for(std::size_t i = 0; i < numWays; i++){
+          
+          // If the tag sequence at the first index of the PHT entry is equal to tag_k
+          if(tag(first + i) == tag_k){
+            
+            // Set the second index of the PHT entry to the current missTag
+            PHT_tags.set(2 * (first + i) + 1, missTag_fromCache);
+            return;
+          }
+        }
+
+        // If the previous process failed, then tag_k is not in the PHT
+        // we need to find an empty row in the set to populate with the current missTag and tag_k
+        PF_UNROLL
+        for(std::size_t i = 0; i < numWays; i++){
+          
+          // if an entry is 0 then the row is not full (i.e. incomplete)
+          if(tag(first + i) == 0){
+            
+            // populate the row with the current missTag and tag_k 
+            // tag_k as tag and missTag as tag' (to use the language in the TCP documentation)
+            PHT_tags.set(2 * (first + i), tag_k);
+            PHT_tags.set(2 * (first + i) + 1, missTag_fromCache);
+            return;
+          }
+        }
+
+    }
+
+    // LookUP function from TCP documentation
+    // search the miss set for the tag that followed missTag last time
+    uint64_t lookUp(std::size_t setIndex, uint64_t missTag_fromCache) const {
+      const std::size_t numWays = ways.get();
+      const std::size_t first = setIndex * numWays;
+
+      PF_UNROLL
+      for(std::size_t i = 0; i < numWays; i++){
+
+        // if the tag_k is in the PHT, return the next tag
+        if(tag(first + i) == missTag_fromCache){
+          return nextTag(first + i);
+        }
+      }
+
+      // if the tag_k is not in the PHT, return 0
+      return 0;
+    }
+
+    // Resident and modeled size of the table, for the host time profile
+    uint64_t footprintBytes() const { return PHT_tags.host_bytes(); }
+    uint64_t modeledBits() const { return PHT_tags.modeled_bits(); }
+
+
+};
+
+
+// The prefetcher itself, one per cache. TCP.cc runs it on its own and ENSEMBLE/ensemble.cc next to the others.
+// TagCorrelatingPrefetcher below has the geometry of common/pf_geometry.h built in, DynamicTagCorrelatingPrefetcher takes it at run time.
+template <std::size_t Sets, std::size_t RowLength, std::size_t Ways>
+class BasicTagCorrelatingPrefetcher final : public pf_component {
+public:
+    explicit BasicTagCorrelatingPrefetcher(std::string statsName = "tcp", const Geometry& geometry = Geometry())
+        : PHT(geometry), THT(geometry), sets(geometry.sets_L1D), tagSize_(static_cast<unsigned>(geometry.tagSize())), stats(std::move(statsName)) {
+      stats.add_structure("pht");
+    }
+
+    void operate(CACHE* cache, uint64_t addr, uint64_t ip, bool cache_hit, bool useful_prefetch, uint8_t type, uint32_t metadata_in,
+                 pf_issuer& issuer) override {
+      stats.on_access(cache->warmup, addr, cache_hit, useful_prefetch);
+
+      // Split the address into missTag, missIndex, and missOffset
+      // the lowest LOG2_BLOCK_SIZE bits are the offset, the next log2(sets_L1D) bits the index, and the rest the tag
+      uint64_t line = addr >> LOG2_BLOCK_SIZE;
+      uint64_t fullTag = sets.div(line);
+      uint64_t missTag = pf_low_bits(fullTag, tagSize_);
+      uint64_t missIndex = sets.mod(line);
+
+      // tag_k is the previous miss tag of the same set, it now links to missTag
+      uint64_t tag_k = THT.lastTag(missIndex);
+      if (tag_k != 0) {
+        PHT.update(missIndex, tag_k, missTag);
+      }
+      THT.update(missIndex, missTag);
+
+      // Look up the PHT and get the next tag
+      uint64_t pfTag = PHT.lookUp(missIndex, missTag);
+      stats.on_lookup(cache->warmup, PHT_lookup, pfTag != 0);
+
+      // Combine the next tag with the missIndex to get the prefetch line, in the same set as the miss
+      // bits above the partial tag, only set outside the modeled physical address space, are taken from the miss
+      uint64_t pfLineTag = (fullTag - missTag) | pfTag;
+      uint64_t pfAddr = (pfLineTag * sets.get() + missIndex) << LOG2_BLOCK_SIZE;
+
+      // No PHT hit, no prefetch: the missed line itself is already being fetched by the demand
+      if (pfTag != 0) {
+        stats.on_prefetch(cache->warmup, pfAddr, ip, issuer.issue(pfAddr, true, metadata_in, correlationConfidence));
+      }
+    }
+
+    void fill(CACHE* cache, uint64_t addr, bool prefetch, uint64_t evicted_addr) override {
+      stats.on_fill(cache->warmup, addr, prefetch, evicted_addr);
+    }
+
+    void final_stats(CACHE* cache) override { stats.report(cache->NAME); }
+
+    pf_stats* quality_stats() override { return &stats; }
+
+    void footprint(pf_profile& profile) const override {
+      profile.structure("tht", THT.footprintBytes(), 1, THT.modeledBits());
+      profile.structure("pht", PHT.footprintBytes(), 1, PHT.modeledBits());
+    }
+
+    using PatternTable = PatternHistoryTable<Sets, Ways, tagBits<Sets>>;
+    using HistoryTable = TagHistoryTable<Sets, RowLength, tagBits<Sets>>;
+
+    // Tables are public for tools/bench
+    PatternTable PHT;
+    HistoryTable THT;
+
+private:
+    static constexpr int PHT_lookup = 0; // Structure id of the PHT lookups in stats
+
+    pf_extent<Sets> sets; // L1D sets, the index bits of an address
+    unsigned tagSize_;    // Bits kept of each tag, the tables hold partial tags above the modeled physical address space
+    pf_stats stats;
+};
+
+using TagCorrelatingPrefetcher = BasicTagCorrelatingPrefetcher<sets_L1D, entriesPerRow_THT, waysPerSet_PHT>;
+using DynamicTagCorrelatingPrefetcher = BasicTagCorrelatingPrefetcher<pf_dynamic, pf_dynamic, pf_dynamic>;
+
+} // namespace tcp
+
+#endif
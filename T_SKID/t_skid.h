@@ -0,0 +1,402 @@
+#ifndef T_SKID_T_SKID_H
+#define T_SKID_T_SKID_H
+
+#include <algorithm>
+#include <array>
+#include <map>
+#include <optional>
+#include <queue>
+#include <string>
+#include <vector>
+#include "cache.h"
+#include "msl/lru_table.h"
+
+#include "../common/pf_bits.h"
+#include "../common/pf_component.h"
+#include "../common/pf_geometry.h"
+#include "../common/pf_stats.h"
+
+#include <fstream>
+#include <iostream>
+
+/*main points:
+when miss happens, dont immediately prefetchm using pred addr. delay prefetch until predicted time when the prefetch should be issued.
+learn trigger PCs for timing prefetches for the target PCs
+issue prefetch, store in IPT. When prefetch line inserted in cache, the trigger pc is used from IPT and recorded in a RRPCQ
+when access causes a miss, PCs in RRPCSQ are linked to the target PCs in the target table. 
+^^^ helps learn relationship between trigger and target.*/
+
+namespace t_skid {
+
+const bool Dump_tables = false; //print the raw tables in final stats, for debugging
+
+//trace of the tracker's steps, every interval-th one, to t_skid_debug.txt. Build with -DT_SKID_DEBUG to turn it on.
+//off by default: the log is shared by every tracker in the process and not safe to write from several threads,
+//and the messages would be built on every access
+#ifdef T_SKID_DEBUG
+    inline std::ofstream debug_file("t_skid_debug.txt");
+    inline uint64_t debug_counter = 0; //counter for debugging
+    const uint64_t interval = 100; //print ever x iterations.
+
+    inline void debug_print(const std::string& msg){
+        if(debug_counter % interval == 0){
+            debug_file << msg << std::endl;
+        }
+        debug_counter++; //up the increment always.
+    }
+#define T_SKID_DEBUG_PRINT(msg) ::t_skid::debug_print(msg)
+#else
+#define T_SKID_DEBUG_PRINT(msg) ((void)0)
+#endif
+
+//one tracker per cache. t_skid.cc runs it on its own and ENSEMBLE/ensemble.cc next to the other prefetchers.
+struct tracker final : public pf_component {
+    //field widths of the table entries, see common/pf_bits.h
+    //pcs keep their low PC_BITS in every table, the rrpcq and the ipt, pcs that share them alias
+    //cl addresses keep their low LINE_BITS, enough for the modeled physical address space
+    //a stride that does not fit STRIDE_BITS is stored as 0, no stride, so it never prefetches
+    constexpr static unsigned PC_BITS = T_skid_pc_tag_bits;
+    constexpr static unsigned LINE_BITS = Physical_address_bits - pf_log2(Block_size);
+    constexpr static unsigned STRIDE_BITS = T_skid_stride_bits;
+    constexpr static unsigned DEGREE_BITS = 4;
+
+    struct tracker_entry {
+        //stores IP, last cl address, and stride between last two cl addresses
+        uint64_t ip : PC_BITS;
+        uint64_t last_cl_addr : LINE_BITS;
+        int64_t last_stride : STRIDE_BITS;
+
+        auto index() const { return ip; }
+        auto tag() const { return ip; }
+    };
+
+    struct lookahead_entry {
+        //stores currently ttargeted pf address, stride used for prefetching
+        //and the remaining degree of prefetching
+        uint64_t address = 0;
+        int64_t stride = 0;
+        int degree = 0;
+    };
+
+    struct target_table_entry {
+        //for prefetching decisions.
+        //stores target and trigger pc, looked up by trigger pc
+        uint64_t target_pc : PC_BITS;
+        uint64_t trigger_pc : PC_BITS;
+
+        auto index() const { return trigger_pc; }
+        auto tag() const { return trigger_pc; }
+    };
+
+    struct addr_pred_table_entry {
+        //similar to lookahead.
+        //TODO: remove redundant
+        uint64_t pc : PC_BITS;
+        uint64_t last_addr : LINE_BITS;
+        int64_t stride : STRIDE_BITS;
+        unsigned degree : DEGREE_BITS;
+
+        //lookup key for a pc tag, bit fields only take default member initializers from C++20 on
+        static addr_pred_table_entry key(uint64_t pc_tag) { return {pc_tag, 0, 0, 0}; }
+
+        auto index() const { return pc; }
+        auto tag() const { return pc; }
+    };
+
+    struct inflight_prefetch_entry {
+        //prefetcches currently used. 
+        //stores IP that triggered the prefetch and the prefetched cl address
+        uint64_t trigger_pc : PC_BITS;
+        uint64_t prefetch_line : LINE_BITS;
+    };
+
+    //table sizes, generated into common/pf_geometry.h from champsim_config.json
+    constexpr static std::size_t TRACKER_SETS = T_skid_tracker_sets;
+    constexpr static std::size_t TRACKER_WAYS = T_skid_tracker_ways;
+    constexpr static int PREFETCH_DEGREE = T_skid_prefetch_degree;
+    constexpr static std::size_t TARGET_TABLE_SETS = T_skid_target_table_sets;
+    constexpr static std::size_t TARGET_TABLE_WAYS = T_skid_target_table_ways;
+    constexpr static std::size_t ADDR_PRED_TABLE_SETS = T_skid_addr_pred_table_sets;
+    constexpr static std::size_t ADDR_PRED_TABLE_WAYS = T_skid_addr_pred_table_ways;
+    constexpr static std::size_t IPT_SIZE = T_skid_ipt_size;
+    constexpr static std::size_t RRPCQ_SIZE = T_skid_rrpcq_size;
+
+    //modeled bits of one entry of each table
+    constexpr static std::size_t TRACKER_ENTRY_BITS = PC_BITS + LINE_BITS + STRIDE_BITS;
+    constexpr static std::size_t TARGET_ENTRY_BITS = 2 * PC_BITS;
+    constexpr static std::size_t ADDR_PRED_ENTRY_BITS = PC_BITS + LINE_BITS + STRIDE_BITS + DEGREE_BITS;
+    constexpr static std::size_t IPT_ENTRY_BITS = PC_BITS + LINE_BITS;
+
+    static_assert(TRACKER_SETS * TRACKER_WAYS * TRACKER_ENTRY_BITS + TARGET_TABLE_SETS * TARGET_TABLE_WAYS * TARGET_ENTRY_BITS
+                      + ADDR_PRED_TABLE_SETS * ADDR_PRED_TABLE_WAYS * ADDR_PRED_ENTRY_BITS + IPT_SIZE * IPT_ENTRY_BITS
+                      + RRPCQ_SIZE * PC_BITS <= 8 * T_skid_storage_budget_bytes,
+                  "T-SKID tables exceed T_skid_storage_budget_bytes");
+    static_assert(PREFETCH_DEGREE < (1 << DEGREE_BITS), "PREFETCH_DEGREE does not fit DEGREE_BITS");
+
+    //table sizes of one tracker, the constants above by default
+    //tools/replay/sweep.cc runs several geometries side by side on one trace
+    struct geometry {
+        std::size_t tracker_sets = TRACKER_SETS;
+        std::size_t tracker_ways = TRACKER_WAYS;
+        int prefetch_degree = PREFETCH_DEGREE;
+        std::size_t target_table_sets = TARGET_TABLE_SETS;
+        std::size_t target_table_ways = TARGET_TABLE_WAYS;
+        std::size_t addr_pred_table_sets = ADDR_PRED_TABLE_SETS;
+        std::size_t addr_pred_table_ways = ADDR_PRED_TABLE_WAYS;
+        std::size_t ipt_size = IPT_SIZE;
+        std::size_t rrpcq_size = RRPCQ_SIZE;
+    };
+
+    geometry sizes;
+    int prefetch_distance = 1; //strides ahead of the target's last address, set by the throttle
+    std::optional<lookahead_entry> active_lookahead;
+    champsim::msl::lru_table<tracker_entry> table{sizes.tracker_sets, sizes.tracker_ways}; //"last recently used"
+
+    champsim::msl::lru_table<target_table_entry> target_table{sizes.target_table_sets, sizes.target_table_ways}; //maps trigger to target PCs
+    champsim::msl::lru_table<addr_pred_table_entry> addr_pred_table{sizes.addr_pred_table_sets, sizes.addr_pred_table_ways}; //store last address, stride, and degree for each target pc for address prediction
+    std::vector<inflight_prefetch_entry> inflight_prefetch_table; //records issues prefetches that have not yet been filled, oldest first
+    std::queue<uint64_t> recent_request_pc_queue; //store recenetly seen trigger pcs
+
+    pf_stats stats; //prefetch quality and table hit rates, reported in final stats
+    const int ip_tracker_lookup = stats.add_structure("ip_tracker");
+    const int target_table_lookup = stats.add_structure("target_table");
+
+    explicit tracker(std::string stats_name = "t_skid") : stats(std::move(stats_name)) {}
+    tracker(std::string stats_name, const geometry& sizes_) : sizes(sizes_), stats(std::move(stats_name)) {}
+
+    void operate(CACHE* cache, uint64_t addr, uint64_t ip, bool cache_hit, bool useful_prefetch, uint8_t type, uint32_t metadata_in,
+                 pf_issuer& issuer) override {
+        stats.on_access(cache->warmup, addr, cache_hit, useful_prefetch);
+        initiate_lookahead(ip, addr >> LOG2_BLOCK_SIZE, cache, issuer);
+    }
+
+    void fill(CACHE* cache, uint64_t addr, bool prefetch, uint64_t evicted_addr) override {
+        stats.on_fill(cache->warmup, addr, prefetch, evicted_addr);
+    }
+
+    void cycle(CACHE* cache) override { advance_lookahead(cache); }
+
+    //the throttle's degree is the degree new address prediction entries start with
+    void throttle(const pf_aggressiveness& level) override {
+        sizes.prefetch_degree = std::min(level.degree, (1 << DEGREE_BITS) - 1);
+        prefetch_distance = level.distance;
+    }
+
+    //prefetch based on ip and cl address
+    /*Based on a given IP and cl address
+    Decide whetehr to initiate a prefetche
+    Check for a hit in the LRU table
+    calculate stride
+    checks for repeated patters
+    IF CONDITIONS MET: trigger prefetch and update prediction table*/
+    void initiate_lookahead(uint64_t ip, uint64_t cl_addr, CACHE* cache, pf_issuer& issuer) {
+        int64_t stride = 0;
+        uint64_t pc_tag = pf_low_bits(ip, PC_BITS);
+        auto found = table.check_hit({pc_tag, cl_addr, stride}); 
+        stats.on_lookup(cache->warmup, ip_tracker_lookup, found.has_value());
+        T_SKID_DEBUG_PRINT("(1)initiate_lookahead: you are in the function");
+        if (found.has_value()) {
+            T_SKID_DEBUG_PRINT("(2)initiate_lookahead: you are in first if");
+            T_SKID_DEBUG_PRINT("calculating stride... with 1: " + std::to_string(cl_addr) + " and 2: " + std::to_string(found->last_cl_addr));
+            stride = line_stride(cl_addr, found->last_cl_addr);
+
+            // Update address prediction table first, so a pc that is its own target predicts past this access
+            //mapping IP to its memory access data
+            auto own = addr_pred_table.check_hit(addr_pred_table_entry::key(pc_tag));
+            if (own.has_value()) {
+                //entry exists, update
+                T_SKID_DEBUG_PRINT("(6)initiate_lookahead: updating addr_pred_table entry");
+                own->last_addr = cl_addr;
+                own->stride = stride;
+                addr_pred_table.fill(*own);
+            } else {
+                T_SKID_DEBUG_PRINT("(7)initiate_lookahead: creating new addr_pred_table entry");
+                addr_pred_table.fill({pc_tag, cl_addr, stride, static_cast<unsigned>(sizes.prefetch_degree)});
+            }
+
+            if (stride != 0 && stride == found->last_stride) {
+                T_SKID_DEBUG_PRINT("(3)initiate_lookahead: you are in second if");
+                auto target = target_table.check_hit({0, pc_tag});
+                stats.on_lookup(cache->warmup, target_table_lookup, target.has_value());
+                if (target.has_value()) {
+                    T_SKID_DEBUG_PRINT("(4)initiate_lookahead: you are in third if");
+                    uint64_t target_pc = target->target_pc;
+                    auto pred = addr_pred_table.check_hit(addr_pred_table_entry::key(target_pc));
+                    if (pred.has_value()) {
+                        T_SKID_DEBUG_PRINT("(5)initiate_lookahead: you are in fourth if PREFETCH ISSUING *************");
+                        int degree = pred->degree; //degree gets adjusted in advance_lookahead
+                        issue_prefetch(cache, issuer, ip, cl_addr, pred->last_addr + pred->stride * prefetch_distance, pred->stride, degree);
+                    }
+                }
+            }
+        }
+
+        table.fill({pc_tag, cl_addr, stride}); //update the lru table
+    }
+
+    /*called by initiate_lookahead to send a prefetch request in MSHR (miss status holding register)
+    whether it fills this level is up to the placement policy (common/pf_placement.h)*/
+    //logic similar to stride.
+    //degree candidates, one stride apart from the predicted cl address first_line
+    void issue_prefetch(CACHE* cache, pf_issuer& issuer, uint64_t trigger_pc, uint64_t cl_addr, uint64_t first_line, int64_t stride, int degree) {
+        T_SKID_DEBUG_PRINT("(8)issue_prefetch: you are in the function");
+        for (int d = 0; d < degree; ++d) {
+            //the tables hold cl addresses, the issuer, the IPT and the MSHR byte addresses
+            uint64_t pf_addr = with_high_bits(cl_addr, first_line + stride * d) << LOG2_BLOCK_SIZE;
+            //the stride repeated and the target pc was linked, as sure as T-SKID gets for the first, less for each stride further
+            pf_issue_result result = issuer.issue(pf_addr, true, 0, Confidence_max - d);
+            stats.on_prefetch(cache->warmup, pf_addr, trigger_pc, result);
+            if (result != pf_issue_result::REFUSED) {
+                //a held prefetch goes in too, its fill comes once the pipeline retries it
+                T_SKID_DEBUG_PRINT("(9)issue_prefetch: prefetch issued ADD TO IPT");
+                if (inflight_prefetch_table.size() >= sizes.ipt_size) {
+                    inflight_prefetch_table.erase(inflight_prefetch_table.begin()); //IPT full, forget the oldest prefetch
+                }
+                inflight_prefetch_table.push_back({pf_low_bits(trigger_pc, PC_BITS), pf_low_bits(pf_addr >> LOG2_BLOCK_SIZE, LINE_BITS)});
+            }
+        }
+    }
+
+    /*Called by every cycle to update and manage prefetching
+    based on the status of prefetches and memory access events*/
+    void advance_lookahead(CACHE* cache) {
+        //Perform timing learning
+        //iterate through MSHR, MSHR tracks prefetches not yet completed in IPT
+        T_SKID_DEBUG_PRINT("(10)advance_lookahead: you are in the function");
+        for (auto it = cache->MSHR.begin(); it != cache->MSHR.end(); ++it) {
+            //LEARNING TIMING AT PREFETCH FILL
+            if (it->event_cycle <= cache->current_cycle) {
+                T_SKID_DEBUG_PRINT("(11)advance_lookahead: prefetch completed");
+                //if current cycle is equal or passed event cycle... this means prefetch is completed
+                //if prefetch is completed, remove from inflight prefetch table
+                //event cycle is the cycle pf supposed to complete
+                //current cycle is the current cycle of the simulation.
+                uint64_t fill_line = pf_low_bits(it->address >> LOG2_BLOCK_SIZE, LINE_BITS); //a demand's MSHR address keeps its offset in the line
+                auto fill_it = std::find_if(inflight_prefetch_table.begin(), inflight_prefetch_table.end(), [fill_line](const auto& entry) { return entry.prefetch_line == fill_line; }); //find the prefetch address in the inflight prefetch table
+                std::optional<uint64_t> trigger_pc; //pc tag
+                if (fill_it != inflight_prefetch_table.end()) {
+                    T_SKID_DEBUG_PRINT("(12)advance_lookahead: prefetch found in IPT");
+                    //if found in IPT, push trigger pc to RRPCQ
+                    trigger_pc = uint64_t{fill_it->trigger_pc};
+                    inflight_prefetch_table.erase(fill_it); 
+                } else if (it->type != access_type::PREFETCH) {
+                    //a demand miss completing: its pc requested the line one miss latency ago, so it is a trigger candidate too
+                    //without this nothing would reach the RRPCQ before the first prefetch, and no prefetch is issued before a link
+                    trigger_pc = pf_low_bits(it->ip, PC_BITS);
+                }
+                if (trigger_pc.has_value()) {
+                    recent_request_pc_queue.push(*trigger_pc); //PUSH HERE
+                    if (recent_request_pc_queue.size() > sizes.rrpcq_size) {
+                        T_SKID_DEBUG_PRINT("(13)advance_lookahead: RRPCQ size overflow");
+                        recent_request_pc_queue.pop(); //if size overflow, POP oldest entry.
+                    }
+                }
+            }
+        }
+
+        //Perform target PC linking
+        //LEARNING TIMING AT CACHE ACCESS
+        auto container = cache->get_inflight_tag_check(); //cahce tag check q holds info ongoing mem access that are not yet completed
+        
+        for (auto it = container.begin(); it != container.end(); ++it) {
+            //iterate through unresolved mem accesses
+            const auto& tag_entry = *it;
+            if (tag_entry.event_cycle <= cache->current_cycle && !tag_entry.is_translated && tag_entry.type == access_type::LOAD) {
+                //pf occured or occuring
+                //has not translated to physical mem address
+                //it's a load
+                T_SKID_DEBUG_PRINT("(14)advance_lookahead: target pc linking FIRST IF");
+                uint64_t target_pc = pf_low_bits(tag_entry.ip, PC_BITS);
+                while (!recent_request_pc_queue.empty()) {
+                    //iterate through RRPCQ till empty
+                    uint64_t trigger_pc = recent_request_pc_queue.front(); //get the trigger pc
+                    recent_request_pc_queue.pop(); //remove it
+                    target_table.fill({target_pc, trigger_pc}); //link trigger with target
+                    T_SKID_DEBUG_PRINT("(15)advance_lookahead: target pc linked");
+                }
+            }
+        }
+
+        //Update degree in address prediction table. dynamically adjust prefetch degree
+        for (auto it = inflight_prefetch_table.begin(); it != inflight_prefetch_table.end(); ++it) {
+            //iterate over IPT
+            auto& entry = *it; //in-progress prefetch in IPT
+
+            auto pred = addr_pred_table.check_hit(addr_pred_table_entry::key(entry.trigger_pc)); //look for entry's trigger pc in addr_pred_table
+            if (pred.has_value()) {
+                //if entry in addr_pred_table... which means prefetch was issued.
+                T_SKID_DEBUG_PRINT("(16)advance_lookahead: updating degree in addr_pred_table FIRST IF");
+                //decrement degree, make sure stay above 1.
+                if (pred->degree > 1) {
+                    pred->degree -= 1;
+                    T_SKID_DEBUG_PRINT("(17)advance_lookahead: degree updated (-1)");
+                } 
+                else {
+                    // Otherwise, set the degree to 1 to ensure it does not fall below this value
+                    pred->degree = 1;
+                    T_SKID_DEBUG_PRINT("(18)advance_lookahead: degree updated (=1)");
+                }
+                addr_pred_table.fill(*pred);
+            }
+        }
+    }
+
+    //stride from the last cl address to this one, worked out on the LINE_BITS the table keeps
+    static int64_t line_stride(uint64_t cl_addr, uint64_t last_cl_addr) {
+        int64_t stride = pf_unpack_signed(pf_low_bits(cl_addr - last_cl_addr, LINE_BITS), LINE_BITS);
+        return pf_fits_signed(stride, STRIDE_BITS) ? stride : 0;
+    }
+
+    //a predicted cl address from its low LINE_BITS, the bits above (only set outside the modeled physical address space) come from the access
+    static uint64_t with_high_bits(uint64_t cl_addr, uint64_t low) {
+        return (cl_addr - pf_low_bits(cl_addr, LINE_BITS)) + pf_low_bits(low, LINE_BITS);
+    }
+
+    pf_stats* quality_stats() override { return &stats; }
+
+    //report table sizes to the host time profile (-DPF_PROFILE), see common/pf_profile.h
+    //lru tables also model a valid bit and log2(ways) lru bits per entry
+    void footprint(pf_profile& profile) const override {
+        auto modeled = [](std::size_t sets, std::size_t ways, std::size_t entry_bits) { return sets * ways * (entry_bits + 1 + pf_log2(ways)); };
+        profile.structure("ip_tracker", sizes.tracker_sets * sizes.tracker_ways * (sizeof(tracker_entry) + sizeof(uint64_t)), 1,
+                          modeled(sizes.tracker_sets, sizes.tracker_ways, TRACKER_ENTRY_BITS));
+        profile.structure("target_table", sizes.target_table_sets * sizes.target_table_ways * (sizeof(target_table_entry) + sizeof(uint64_t)), 1,
+                          modeled(sizes.target_table_sets, sizes.target_table_ways, TARGET_ENTRY_BITS));
+        profile.structure("addr_pred_table", sizes.addr_pred_table_sets * sizes.addr_pred_table_ways * (sizeof(addr_pred_table_entry) + sizeof(uint64_t)), 1,
+                          modeled(sizes.addr_pred_table_sets, sizes.addr_pred_table_ways, ADDR_PRED_ENTRY_BITS));
+        profile.structure("inflight_prefetch_table", pf_vector_bytes(inflight_prefetch_table), inflight_prefetch_table.capacity() != 0,
+                          sizes.ipt_size * IPT_ENTRY_BITS);
+        profile.structure("recent_request_pc_queue", sizeof(recent_request_pc_queue) + 512 * (1 + recent_request_pc_queue.size() / 64), 2,
+                          sizes.rrpcq_size * PC_BITS);
+    }
+
+    void final_stats(CACHE* cache) override {
+        stats.report(cache->NAME);
+        if (!Dump_tables) {
+            return;
+        }
+
+        //contents of inflight_prefetch_table
+        std::cout << "Inflight Prefetch Table Contents:" << std::endl;
+        for (size_t i = 0; i < inflight_prefetch_table.size(); ++i) {
+            const auto& entry = inflight_prefetch_table[i];
+            std::cout << "Trigger PC: " << entry.trigger_pc << ", Prefetch Line: " << entry.prefetch_line << std::endl;
+        }
+
+        //addr_pred_table and target_table are lru_tables, which cannot be walked, so show the entries of the inflight trigger pcs
+        std::cout << "Address Prediction And Target Table Entries Of Inflight Trigger PCs:" << std::endl;
+        for (const auto& inflight : inflight_prefetch_table) {
+            if (auto pred = addr_pred_table.check_hit(addr_pred_table_entry::key(inflight.trigger_pc)); pred.has_value()) {
+                std::cout << "IP: " << pred->pc << ", Last Address: " << pred->last_addr 
+                          << ", Stride: " << pred->stride << ", Degree: " << pred->degree << std::endl;
+            }
+            if (auto target = target_table.check_hit({0, inflight.trigger_pc}); target.has_value()) {
+                std::cout << "Trigger PC: " << target->trigger_pc << ", Target PC: " << target->target_pc << std::endl;
+            }
+        }
+    }
+};
+
+} // namespace t_skid
+
+#endif
@@ -0,0 +1,216 @@
+#ifndef COMMON_L2_TRACE_H
+#define COMMON_L2_TRACE_H
+
+/*
+Packed L2 access trace shared by the prefetchers and the tools.
+
+A trace file is a 32 byte header followed by fixed-width 24 byte records, so it can be mapped directly, from C++
+with l2_trace_reader or from Python with np.memmap (see LSTM/packed_trace.py):
+
+  header:  char magic[4] = "L2AT", uint32 version = 1, uint32 record_size = 24, uint32 reserved,
+           uint64 record_count, uint64 first_cycle
+  record:  uint64 addr, uint64 ip, uint32 cycle_delta, uint8 type, uint8 hit, uint16 reserved
+
+cycle_delta is the number of cycles since the previous record (since first_cycle for the first one), saturated at
+UINT32_MAX. All fields are little endian.
+
+l2_trace_writer is used both by the capture hook inside the simulator and by tools/l2clog_to_trace. The caller only
+copies a record into a single-producer ring buffer; a writer thread drains the ring to the file in large blocks.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct l2_trace_header {
+    char magic[4] = {'L', '2', 'A', 'T'};
+    uint32_t version = 1;
+    uint32_t record_size = 24;
+    uint32_t reserved = 0;
+    uint64_t record_count = 0;
+    uint64_t first_cycle = 0;
+};
+
+struct l2_access_record {
+    uint64_t addr = 0;
+    uint64_t ip = 0;
+    uint32_t cycle_delta = 0;
+    uint8_t type = 0;
+    uint8_t hit = 0;
+    uint16_t reserved = 0;
+};
+
+static_assert(sizeof(l2_trace_header) == 32, "trace header layout is part of the file format");
+static_assert(sizeof(l2_access_record) == 24, "trace record layout is part of the file format");
+
+class l2_trace_writer {
+public:
+    static constexpr std::size_t RING_RECORDS = 1 << 16;      // Power of two
+    static constexpr std::size_t FLUSH_RECORDS = 1 << 12;     // Largest block written per fwrite
+
+    l2_trace_writer() : ring(RING_RECORDS) {}
+    l2_trace_writer(const l2_trace_writer&) = delete;
+    l2_trace_writer& operator=(const l2_trace_writer&) = delete;
+    ~l2_trace_writer() { close(); }
+
+    // Creates the file and starts the writer thread
+    bool open(const std::string& path) {
+        file = std::fopen(path.c_str(), "wb");
+        if (file == nullptr) {
+            return false;
+        }
+        std::fwrite(&header, sizeof(header), 1, file);
+        running = true;
+        worker = std::thread(&l2_trace_writer::drain, this);
+        return true;
+    }
+
+    bool is_open() const { return file != nullptr; }
+
+    // Appends one access; cycle is absolute, the delta to the previous record is computed here
+    void append(uint64_t addr, uint64_t ip, uint64_t cycle, uint8_t type, bool hit) {
+        if (file == nullptr) {
+            return;
+        }
+        if (header.record_count == 0) {
+            header.first_cycle = cycle;
+            last_cycle = cycle;
+        }
+        uint64_t delta = cycle >= last_cycle ? cycle - last_cycle : 0;
+        last_cycle = cycle;
+
+        l2_access_record record;
+        record.addr = addr;
+        record.ip = ip;
+        record.cycle_delta = delta > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(delta);
+        record.type = type;
+        record.hit = hit ? 1 : 0;
+
+        // Only waits when the writer thread has fallen a whole ring behind
+        std::size_t head = write_index.load(std::memory_order_relaxed);
+        while (head - read_index.load(std::memory_order_acquire) >= RING_RECORDS) {
+            full_waits++;
+            std::this_thread::yield();
+        }
+        ring[head & (RING_RECORDS - 1)] = record;
+        write_index.store(head + 1, std::memory_order_release);
+        header.record_count++;
+    }
+
+    // Drains the ring, fills in the record count and closes the file
+    void close() {
+        if (file == nullptr) {
+            return;
+        }
+        running = false;
+        worker.join();
+        std::fseek(file, 0, SEEK_SET);
+        std::fwrite(&header, sizeof(header), 1, file);
+        std::fclose(file);
+        file = nullptr;
+    }
+
+    uint64_t records() const { return header.record_count; }
+    uint64_t full_waits = 0;                    // Appends that had to wait for the writer thread
+
+private:
+    std::vector<l2_access_record> ring;
+    std::atomic<std::size_t> write_index{0};
+    std::atomic<std::size_t> read_index{0};
+    std::atomic<bool> running{false};
+    std::thread worker;
+    std::FILE* file = nullptr;
+    l2_trace_header header;
+    uint64_t last_cycle = 0;
+
+    // Writer thread: writes every contiguous span of the ring that the producer has published
+    void drain() {
+        while (true) {
+            bool stop = !running.load(std::memory_order_acquire);
+            std::size_t tail = read_index.load(std::memory_order_relaxed);
+            std::size_t head = write_index.load(std::memory_order_acquire);
+            if (head == tail) {
+                if (stop) {
+                    return;
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                continue;
+            }
+            std::size_t start = tail & (RING_RECORDS - 1);
+            std::size_t count = std::min({head - tail, RING_RECORDS - start, FLUSH_RECORDS});
+            std::fwrite(&ring[start], sizeof(l2_access_record), count, file);
+            read_index.store(tail + count, std::memory_order_release);
+        }
+    }
+};
+
+// Read-only mapping of a trace file
+class l2_trace_reader {
+public:
+    l2_trace_reader() = default;
+    l2_trace_reader(const l2_trace_reader&) = delete;
+    l2_trace_reader& operator=(const l2_trace_reader&) = delete;
+    ~l2_trace_reader() {
+        if (base != nullptr) {
+            munmap(base, length);
+        }
+    }
+
+    bool open(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) < sizeof(l2_trace_header)) {
+            ::close(fd);
+            return false;
+        }
+        length = info.st_size;
+        void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            return false;
+        }
+        base = mapped;
+        madvise(base, length, MADV_SEQUENTIAL);
+
+        std::memcpy(&header, base, sizeof(header));
+        if (std::memcmp(header.magic, "L2AT", 4) != 0 || header.record_size != sizeof(l2_access_record)) {
+            return false;
+        }
+        // A capture that was never closed has a zero count, the file size is authoritative
+        count = (length - sizeof(l2_trace_header)) / sizeof(l2_access_record);
+        return true;
+    }
+
+    std::size_t size() const { return count; }
+    uint64_t first_cycle() const { return header.first_cycle; }
+    const l2_access_record* begin() const { return records(); }
+    const l2_access_record* end() const { return records() + count; }
+    const l2_access_record& operator[](std::size_t i) const { return records()[i]; }
+
+private:
+    void* base = nullptr;
+    std::size_t length = 0;
+    std::size_t count = 0;
+    l2_trace_header header;
+
+    const l2_access_record* records() const {
+        return reinterpret_cast<const l2_access_record*>(static_cast<const char*>(base) + sizeof(l2_trace_header));
+    }
+};
+
+#endif
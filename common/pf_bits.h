@@ -0,0 +1,88 @@
+#ifndef COMMON_PF_BITS_H
+#define COMMON_PF_BITS_H
+
+/*
+Bit packed storage for prefetcher metadata, so tables hold the field widths the hardware would rather than whole
+host words.
+
+pf_packed_array<Width> holds fixed width fields back to back in 64-bit words, as many as fit in a word, so no field
+straddles two words and a lookup is one load, shift and mask (20-bit tags waste 4 bits of every word). Width works
+like pf_extent: a width from common/pf_geometry.h makes the shifts and masks constants, pf_dynamic takes it at
+construction for tools/replay/sweep.cc. Records of several fields of one width are stored as consecutive fields.
+
+Partial tags keep the low bits of a value (pf_low_bits). Signed fields such as strides use pf_pack_signed and
+pf_unpack_signed; a value the field cannot hold is stored as 0, which every user treats as "no value".
+
+Tables report both sizes to the host time profile: modeled_bits() is the budget the hardware would spend and
+host_bytes() what the simulation holds, see pf_profile::structure().
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "pf_extent.h"
+#include "pf_profile.h"
+
+constexpr uint64_t pf_bit_mask(std::size_t bits) { return bits >= 64 ? ~uint64_t{0} : (uint64_t{1} << bits) - 1; }
+
+constexpr uint64_t pf_low_bits(uint64_t value, unsigned bits) { return value & pf_bit_mask(bits); }
+
+inline bool pf_fits_signed(int64_t value, unsigned bits)
+{
+    if (bits >= 64) {
+        return true;
+    }
+    int64_t limit = int64_t{1} << (bits - 1);
+    return value >= -limit && value < limit;
+}
+
+// Two's complement in bits, 0 when value does not fit
+inline uint64_t pf_pack_signed(int64_t value, unsigned bits)
+{
+    return pf_fits_signed(value, bits) ? pf_low_bits(static_cast<uint64_t>(value), bits) : 0;
+}
+
+inline int64_t pf_unpack_signed(uint64_t field, unsigned bits)
+{
+    if (bits >= 64) {
+        return static_cast<int64_t>(field);
+    }
+    uint64_t sign = uint64_t{1} << (bits - 1);
+    return static_cast<int64_t>((field ^ sign) - sign);
+}
+
+template <std::size_t Width = pf_dynamic>
+class pf_packed_array {
+public:
+    explicit pf_packed_array(std::size_t size_, std::size_t width_ = Width)
+        : width(width_), per_word(64 / width_), count(size_),
+          words((size_ + per_word.get() - 1) / per_word.get(), 0) {}
+
+    uint64_t get(std::size_t i) const { return (words[per_word.div(i)] >> shift_of(i)) & mask(); }
+
+    // Keeps the low width bits of value
+    void set(std::size_t i, uint64_t value) {
+        uint64_t& word = words[per_word.div(i)];
+        unsigned shift = shift_of(i);
+        word = (word & ~(mask() << shift)) | ((value & mask()) << shift);
+    }
+
+    void clear() { std::fill(words.begin(), words.end(), 0); }
+
+    std::size_t size() const { return count; }
+    std::size_t field_bits() const { return width.get(); }
+    uint64_t modeled_bits() const { return count * width.get(); }
+    uint64_t host_bytes() const { return pf_vector_bytes(words); }
+
+private:
+    pf_extent<Width> width;
+    pf_extent<Width == pf_dynamic ? pf_dynamic : 64 / Width> per_word; // Fields per word, none straddles two words
+    std::size_t count;
+    std::vector<uint64_t> words;
+
+    uint64_t mask() const { return pf_bit_mask(width.get()); }
+    unsigned shift_of(std::size_t i) const { return static_cast<unsigned>(per_word.mod(i) * width.get()); }
+};
+
+#endif
@@ -0,0 +1,239 @@
+#ifndef COMMON_PF_CANDIDATE_QUEUE_H
+#define COMMON_PF_CANDIDATE_QUEUE_H
+
+/*
+Candidate queue between a prefetcher and its cache, so a burst that fills the prefetch queue or the MSHRs does not
+throw the prefetcher's best predictions away.
+
+A candidate the cache refuses (prefetch_line returning false) is held here instead of being dropped, if its
+confidence is at least Queue_min_confidence. The queue holds Candidate_queue_size candidates; when it is full a new
+candidate takes the place of the least confident one held, if it is more confident, and is dropped otherwise. A
+candidate for a line already held is dropped too, the held one goes out first.
+
+Every cycle the held candidates are retried, most confident first and oldest first among equals, at most
+Queue_retries_per_cycle of them. The first one the cache refuses again ends the cycle's retries, since the cache is
+still full. A held candidate is dropped when:
+  expired    Candidate_lifetime_cycles passed since it was first refused
+  overtaken  the demand stream got there first: a demand for the candidate's line, or for a line in the same page
+             at or past it as seen from the access that triggered it
+Candidates from the row filter's delay queue have no trigger, only a demand for their own line overtakes them.
+
+A held candidate is answered HELD (common/pf_component.h), like a delayed one in the row filter. Once it is issued
+on a retry, or expired, overtaken or displaced, the queue tells its pf_held_listener, so the issue filter, the
+throttle and the quality stats count it as issued or dropped only then. Per source (one prefetcher, or each ensemble
+component) the queue reports candidates held, issued on retry, expired, overtaken, displaced and dropped, the retry
+success rate and the mean and peak occupancy.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "pf_component.h"
+
+const std::size_t Candidate_queue_size = 16;
+const uint64_t Candidate_lifetime_cycles = 400;
+const int Queue_min_confidence = 4;                 // Less confident refused candidates are dropped at once
+const int Queue_retries_per_cycle = 2;
+
+class pf_candidate_queue {
+public:
+    struct source_counts {
+        std::string name;
+        uint64_t refused = 0;                       // Refused by the cache on first try
+        uint64_t held = 0;
+        uint64_t low_confidence = 0;                // Refused and not confident enough to hold
+        uint64_t retries = 0;
+        uint64_t retry_issued = 0;
+        uint64_t expired = 0;
+        uint64_t overtaken = 0;
+        uint64_t displaced = 0;                     // Pushed out of a full queue by a more confident candidate
+        uint64_t dropped_full = 0;                  // Queue full of candidates at least as confident
+        uint64_t already_held = 0;                  // Its line was held already
+    };
+
+    // listener hears what became of every held candidate, if not null
+    explicit pf_candidate_queue(std::vector<std::string> source_names = {"prefetcher"}, pf_held_listener* listener_ = nullptr)
+        : listener(listener_) {
+        for (std::string& name : source_names) {
+            sources.push_back({std::move(name)});
+        }
+        held.reserve(Candidate_queue_size);
+    }
+
+    // trigger_addr and trigger_ip are the access that produced the candidate, trigger_addr 0 if not known
+    pf_issue_result issue(pf_issuer& next, uint64_t cycle, uint64_t trigger_addr, uint64_t trigger_ip, int source, uint64_t pf_addr,
+                          bool fill_this_level, uint32_t metadata, int confidence) {
+        source_counts& s = sources[source];
+        uint64_t line = pf_addr >> LOG2_BLOCK_SIZE;
+        if (std::any_of(held.begin(), held.end(), [&](const held_candidate& c) { return c.line == line; })) {
+            s.already_held++;
+            return pf_issue_result::REFUSED;
+        }
+        pf_issue_result result = next.issue(pf_addr, fill_this_level, metadata, confidence);
+        if (result != pf_issue_result::REFUSED) {
+            return result;
+        }
+        s.refused++;
+        if (confidence < Queue_min_confidence) {
+            s.low_confidence++;
+            return pf_issue_result::REFUSED;
+        }
+
+        held_candidate candidate{pf_addr, line, trigger_addr == 0 ? line : trigger_addr >> LOG2_BLOCK_SIZE, trigger_ip, fill_this_level, metadata,
+                                 confidence, source, cycle + Candidate_lifetime_cycles, sequence++};
+        if (held.size() < Candidate_queue_size) {
+            held.push_back(candidate);
+            s.held++;
+            return pf_issue_result::HELD;
+        }
+        auto weakest = std::max_element(held.begin(), held.end(), [](const held_candidate& a, const held_candidate& b) { return a.before(b); });
+        if (weakest->confidence >= confidence) {
+            s.dropped_full++;
+            return pf_issue_result::REFUSED;
+        }
+        sources[weakest->source].displaced++;
+        notify(*weakest, false);
+        *weakest = candidate;
+        s.held++;
+        return pf_issue_result::HELD;
+    }
+
+    // Every access the prefetcher sees, drops the candidates the demand stream overtook
+    void on_demand(uint64_t addr) {
+        if (held.empty()) {
+            return;
+        }
+        uint64_t line = addr >> LOG2_BLOCK_SIZE;
+        drop_if([&](const held_candidate& c) { return overtaken(c, line); }, &source_counts::overtaken);
+    }
+
+    // Retries the held candidates, call every cycle
+    void cycle(pf_issuer& next, uint64_t cycle) {
+        occupancy_sum += held.size();
+        peak_occupancy = std::max(peak_occupancy, held.size());
+        cycles++;
+        if (held.empty()) {
+            return;
+        }
+        drop_if([&](const held_candidate& c) { return cycle >= c.deadline; }, &source_counts::expired);
+
+        std::sort(held.begin(), held.end(), [](const held_candidate& a, const held_candidate& b) { return a.before(b); });
+        int tried = 0;
+        auto it = held.begin();
+        while (it != held.end() && tried < Queue_retries_per_cycle) {
+            tried++;
+            source_counts& s = sources[it->source];
+            s.retries++;
+            if (next.issue(it->pf_addr, it->fill_this_level, it->metadata, it->confidence) != pf_issue_result::ISSUED) {
+                break;
+            }
+            s.retry_issued++;
+            notify(*it, true);
+            it = held.erase(it);
+        }
+    }
+
+    void report(const std::string& cache_name) const {
+        auto ratio = [](uint64_t num, uint64_t den) { return den == 0 ? 0.0 : static_cast<double>(num) / static_cast<double>(den); };
+
+        std::cout << "----- " << cache_name << " Prefetch Candidate Queue (" << Candidate_queue_size << " entries) -----\n";
+        std::cout << "Mean Occupancy: " << ratio(occupancy_sum, cycles) << "\n";
+        std::cout << "Peak Occupancy: " << peak_occupancy << "\n";
+        std::cout << "Source | Refused | Held | Low Confidence | Retries | Retry Issued | Retry Success | Expired | Overtaken | Displaced | Dropped Full"
+                     " | Already Held\n";
+        for (const source_counts& s : sources) {
+            std::cout << s.name << " | " << s.refused << " | " << s.held << " | " << s.low_confidence << " | " << s.retries << " | " << s.retry_issued
+                      << " | " << ratio(s.retry_issued, s.held) << " | " << s.expired << " | " << s.overtaken << " | " << s.displaced << " | "
+                      << s.dropped_full << " | " << s.already_held << "\n";
+        }
+    }
+
+    const std::vector<source_counts>& counts() const { return sources; }
+
+    std::size_t footprint_bytes() const { return held.capacity() * sizeof(held_candidate); }
+
+private:
+    struct held_candidate {
+        uint64_t pf_addr;
+        uint64_t line;
+        uint64_t trigger_line;                      // The candidate's own line when the trigger is not known
+        uint64_t trigger_ip;
+        bool fill_this_level;
+        uint32_t metadata;
+        int confidence;
+        int source;
+        uint64_t deadline;
+        uint64_t order;                             // When it was held, older first among equal confidence
+
+        bool before(const held_candidate& other) const {
+            return confidence != other.confidence ? confidence > other.confidence : order < other.order;
+        }
+    };
+
+    pf_held_listener* listener;
+    std::vector<source_counts> sources;
+    std::vector<held_candidate> held;
+    uint64_t sequence = 0;
+    uint64_t cycles = 0;
+    uint64_t occupancy_sum = 0;
+    std::size_t peak_occupancy = 0;
+
+    // A demand for the line, or for a line of the same page at or past it going the trigger's way
+    static bool overtaken(const held_candidate& c, uint64_t demand_line) {
+        if (demand_line == c.line) {
+            return true;
+        }
+        constexpr unsigned page_line_bits = LOG2_PAGE_SIZE - LOG2_BLOCK_SIZE;
+        if (c.trigger_line == c.line || (demand_line >> page_line_bits) != (c.line >> page_line_bits)) {
+            return false;
+        }
+        if (c.line > c.trigger_line) {
+            return demand_line > c.line;
+        }
+        return demand_line < c.line;
+    }
+
+    void notify(const held_candidate& c, bool issued) {
+        if (listener != nullptr) {
+            listener->held_outcome(c.source, c.pf_addr, c.trigger_ip, issued);
+        }
+    }
+
+    template <typename Predicate>
+    void drop_if(Predicate predicate, uint64_t source_counts::*counter) {
+        auto end = std::remove_if(held.begin(), held.end(), [&](const held_candidate& c) {
+            if (!predicate(c)) {
+                return false;
+            }
+            sources[c.source].*counter += 1;
+            notify(c, false);
+            return true;
+        });
+        held.erase(end, held.end());
+    }
+};
+
+// Issuer that holds the candidates of one source the cache refuses
+class pf_candidate_queue_issuer : public pf_issuer {
+public:
+    pf_candidate_queue_issuer(pf_candidate_queue& queue_, pf_issuer& next_, uint64_t cycle_, uint64_t trigger_addr_, uint64_t trigger_ip_,
+                              int source_ = 0)
+        : queue(queue_), next(next_), cycle(cycle_), trigger_addr(trigger_addr_), trigger_ip(trigger_ip_), source(source_) {}
+
+    pf_issue_result issue(uint64_t pf_addr, bool fill_this_level, uint32_t metadata, int confidence) override {
+        return queue.issue(next, cycle, trigger_addr, trigger_ip, source, pf_addr, fill_this_level, metadata, confidence);
+    }
+
+private:
+    pf_candidate_queue& queue;
+    pf_issuer& next;
+    uint64_t cycle;
+    uint64_t trigger_addr;
+    uint64_t trigger_ip;
+    int source;
+};
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef COMMON_PF_COMPONENT_H
+#define COMMON_PF_COMPONENT_H
+
+/*
+Common interface of the prefetcher components, so one cache can run several of them side by side
+(ENSEMBLE/ensemble.cc) or a single one (the module's own .cc, which only forwards the ChampSim hooks).
+
+A component keeps all of its state per instance and is driven through the same hooks ChampSim gives a module.
+It never calls prefetch_line itself: every candidate goes through the pf_issuer it is handed. On its own that is
+pf_cache_issuer, which forwards to the cache; in the ensemble it is the arbiter, which may refuse the candidate.
+The issuer answers with a pf_issue_result:
+  ISSUED   prefetch_line accepted it
+  REFUSED  looks to the component like a full prefetch queue (prefetch_line returning false)
+  HELD     a later stage (the row filter's delay queue, the candidate queue) keeps it to retry. It is neither issued
+           nor dropped yet: the stage tells its pf_held_listener which it became once that is decided, and the
+           listener passes it on to the component's quality_stats().
+
+Every candidate carries the component's confidence in it, 0 to Confidence_max. The cache ignores it, the candidate
+queue in common/pf_candidate_queue.h uses it to pick which held candidates to keep and retry first.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "cache.h"
+#include "pf_profile.h"
+
+class pf_stats;
+
+const int Confidence_max = 15;                      // 4-bit confidence per candidate
+
+// Confidence of a candidate the component predicts with probability p
+inline int pf_confidence(double p) { return std::min(std::max(static_cast<int>(std::lround(p * Confidence_max)), 0), Confidence_max); }
+
+enum class pf_issue_result { REFUSED, ISSUED, HELD };
+
+class pf_issuer {
+public:
+    virtual ~pf_issuer() = default;
+
+    // Same contract as CACHE::prefetch_line, plus HELD for a candidate kept to retry
+    virtual pf_issue_result issue(uint64_t pf_addr, bool fill_this_level, uint32_t metadata, int confidence) = 0;
+};
+
+// Told what became of a HELD candidate of source: issued on a later retry, or dropped without ever going out
+class pf_held_listener {
+public:
+    virtual ~pf_held_listener() = default;
+
+    virtual void held_outcome(int source, uint64_t pf_addr, uint64_t trigger_ip, bool issued) = 0;
+};
+
+// Sends every candidate straight to the cache
+class pf_cache_issuer : public pf_issuer {
+public:
+    explicit pf_cache_issuer(CACHE* cache_) : cache(cache_) {}
+
+    pf_issue_result issue(uint64_t pf_addr, bool fill_this_level, uint32_t metadata, int /*confidence*/) override {
+        return cache->prefetch_line(pf_addr, fill_this_level, metadata) ? pf_issue_result::ISSUED : pf_issue_result::REFUSED;
+    }
+
+private:
+    CACHE* cache;
+};
+
+// How hard a prefetcher may push, set by the feedback directed throttle in common/pf_throttle.h
+struct pf_aggressiveness {
+    int degree;              // Candidates per access
+    int distance;            // How far ahead of the access the first candidate is, for prefetchers that have a distance
+    bool fill_this_level;    // False fills the next level only
+};
+
+class pf_component {
+public:
+    virtual ~pf_component() = default;
+
+    virtual void initialize(CACHE*) {}
+    virtual void operate(CACHE* cache, uint64_t addr, uint64_t ip, bool cache_hit, bool useful_prefetch, uint8_t type, uint32_t metadata_in,
+                         pf_issuer& issuer) = 0;
+    virtual void fill(CACHE*, uint64_t /*addr*/, bool /*prefetch*/, uint64_t /*evicted_addr*/) {}
+    virtual void cycle(CACHE*) {}
+
+    // New aggressiveness from the throttle, components without a degree or distance of their own can ignore it
+    virtual void throttle(const pf_aggressiveness&) {}
+
+    // Prints and exports the component's statistics for this cache
+    virtual void final_stats(CACHE*) {}
+
+    // Reports the component's major structures to the host time profile
+    virtual void footprint(pf_profile&) const {}
+
+    // Prefetch quality stats the outcome of a HELD candidate goes to, nullptr if the component keeps none
+    virtual pf_stats* quality_stats() { return nullptr; }
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef COMMON_PF_EXTENT_H
+#define COMMON_PF_EXTENT_H
+
+/*
+Table dimensions fixed at compile time, or at construction for tools that size tables at run time.
+
+pf_extent<N> is a number of sets or ways. With N from common/pf_geometry.h it takes no storage and div/mod fold to
+shifts and masks when N is a power of two, and loops up to get() have a constant trip count. pf_extent<pf_dynamic>
+holds the value instead, for tools/replay/sweep.cc, and still uses a shift and mask when the value is a power of two.
+*/
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+constexpr std::size_t pf_dynamic = 0;
+
+// Bits needed to index n entries, log2 of n for a power of two
+constexpr unsigned pf_log2(std::size_t n)
+{
+    unsigned bits = 0;
+    while ((std::size_t{1} << bits) < n) {
+        bits++;
+    }
+    return bits;
+}
+
+// Unrolls the loop that follows, for way loops with a compile time trip count. GCC drops the hint when the loop
+// condition calls a function, so compare against a local holding get() rather than get() itself.
+#define PF_UNROLL _Pragma("GCC unroll 16")
+
+template <std::size_t N>
+class pf_extent {
+public:
+    static_assert(N != pf_dynamic, "use pf_extent<pf_dynamic> for a run time extent");
+
+    constexpr pf_extent(std::size_t n = N) { assert(n == N); (void)n; }
+
+    static constexpr std::size_t get() { return N; }
+    static constexpr uint64_t div(uint64_t x) { return x / N; }
+    static constexpr uint64_t mod(uint64_t x) { return x % N; }
+};
+
+template <>
+class pf_extent<pf_dynamic> {
+public:
+    pf_extent(std::size_t n_) : n(n_), pow2(n_ != 0 && (n_ & (n_ - 1)) == 0), shift(pf_log2(n_)) {}
+
+    std::size_t get() const { return n; }
+    uint64_t div(uint64_t x) const { return pow2 ? x >> shift : x / n; }
+    uint64_t mod(uint64_t x) const { return pow2 ? x & (n - 1) : x % n; }
+
+private:
+    std::size_t n;
+    bool pow2;
+    unsigned shift;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef COMMON_PF_GEOMETRY_H
+#define COMMON_PF_GEOMETRY_H
+
+// Generated by tools/gen_pf_geometry.py from ChampSim's default configuration, regenerate rather than edit.
+// Table geometry every prefetcher is compiled with. The tables take these as template arguments, so
+// power of two sets and ways become shifts and masks and way loops have a constant trip count.
+
+#include <cstddef>
+
+// Simulated system
+constexpr std::size_t Block_size = 64;
+constexpr std::size_t Page_size = 4096;
+constexpr std::size_t Physical_address_bits = 32;   // log2 of the DRAM size
+constexpr std::size_t L1D_sets = 64;
+constexpr std::size_t L1D_ways = 12;
+constexpr std::size_t L2C_sets = 1024;
+constexpr std::size_t L2C_ways = 8;
+constexpr std::size_t LLC_sets = 2048;
+constexpr std::size_t LLC_ways = 16;
+constexpr std::size_t Dram_channels = 1;
+constexpr std::size_t Dram_ranks = 1;
+constexpr std::size_t Dram_banks = 8;
+constexpr std::size_t Dram_rows = 65536;
+constexpr std::size_t Dram_columns = 128;           // Lines per row in one bank
+
+// tcp
+constexpr std::size_t Tcp_tht_entries_per_row = 12;       // Tags kept in each THT row
+constexpr std::size_t Tcp_pht_ways = 12;                  // PHT ways per L1D set
+constexpr std::size_t Tcp_storage_budget_bits = 131072;   // THT + PHT
+
+// misb
+constexpr std::size_t Misb_ps_sets = 128;
+constexpr std::size_t Misb_ps_ways = 8;
+constexpr std::size_t Misb_sp_sets = 128;
+constexpr std::size_t Misb_sp_ways = 8;
+constexpr std::size_t Misb_bloom_bits = 139264;
+constexpr std::size_t Misb_run_length = 4;                 // Consecutive PS/SP keys one entry maps
+constexpr std::size_t Misb_tag_bits = 16;                  // Partial run tag of a PS/SP entry
+constexpr std::size_t Misb_delta_bits = 8;                 // Signed delta of each mapping in a run, in lines
+constexpr std::size_t Misb_structural_address_bits = 32;   // Structural address field of a PS/SP entry
+constexpr std::size_t Misb_stream_chunk = 256;             // Structural addresses a new PC stream is given
+constexpr std::size_t Misb_training_entries = 64;          // PCs whose last structural address the training unit keeps
+constexpr std::size_t Misb_lookahead_distance = 4;         // Structural addresses between an SP hit and its metadata lookahead
+constexpr std::size_t Misb_lookahead_keys = 8;             // Structural addresses a lookahead covers, 0 turns it off
+constexpr std::size_t Misb_metadata_line_keys = 8;         // Mappings per off-chip metadata line
+constexpr std::size_t Misb_fetch_filter_size = 64;         // Recent metadata line reads remembered (power of two)
+constexpr std::size_t Misb_llc_metadata_sets = 256;        // Metadata lines cached in the LLC when cores share MISB metadata
+constexpr std::size_t Misb_llc_metadata_ways = 16;
+constexpr std::size_t Misb_partition_epoch = 8192;         // LLC metadata accesses between utility repartitions
+constexpr std::size_t Misb_storage_budget_bytes = 98304;   // PS + SP caches + bloom filter
+
+// misb_real
+constexpr std::size_t Misb_real_sets = 128;            // PS and SP cache sets
+constexpr std::size_t Misb_real_ways = 8;              // PS and SP cache ways
+constexpr std::size_t Misb_real_bloom_bits = 139264;
+
+// t_skid
+constexpr std::size_t T_skid_tracker_sets = 256;             // IP tracker
+constexpr std::size_t T_skid_tracker_ways = 4;
+constexpr std::size_t T_skid_target_table_sets = 64;         // Trigger PC to target PC
+constexpr std::size_t T_skid_target_table_ways = 4;
+constexpr std::size_t T_skid_addr_pred_table_sets = 64;      // Last address and stride of each target PC
+constexpr std::size_t T_skid_addr_pred_table_ways = 4;
+constexpr std::size_t T_skid_ipt_size = 16;                  // In flight prefetches
+constexpr std::size_t T_skid_rrpcq_size = 16;                // Recent request PC queue
+constexpr std::size_t T_skid_prefetch_degree = 3;
+constexpr std::size_t T_skid_stride_bits = 16;               // Signed stride field, in lines
+constexpr std::size_t T_skid_pc_tag_bits = 16;               // Partial PC tag kept in every table
+constexpr std::size_t T_skid_storage_budget_bytes = 49152;   // All tables
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef COMMON_PF_ISSUE_H
+#define COMMON_PF_ISSUE_H
+
+/*
+Issue stage filter, the first thing every prefetch candidate goes through before prefetch_line.
+
+It drops candidates that cannot help:
+  null          address 0, issued by a prefetcher with nothing to prefetch
+  page_cross    a different page than the access that triggered it, only if the filter drops page crossers
+  issued        a line this filter let through recently
+  demanded      a line demanded recently, so it is in the cache or on its way
+Recent lines are kept in a direct mapped table of Issue_filter_size line numbers, shared by issued and demanded
+lines, so a line only stays in it until another line maps to the same slot. Every drop is counted by reason and by
+source, and candidates that pass but are refused further down (full queue, arbiter, row filter) are counted too.
+A candidate held further down (common/pf_component.h) is only remembered as issued once on_held_outcome hears it
+went out; one dropped there counts as refused below.
+
+Temporal and correlating prefetchers (TCP, MISB, T-SKID) replay lines they saw on other pages, so they keep page
+crossers; spatial ones (LSTM) drop them.
+*/
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "pf_component.h"
+
+const std::size_t Issue_filter_size = 1024;         // Recent lines remembered (power of two)
+
+class pf_issue_filter {
+public:
+    struct source_counts {
+        std::string name;
+        uint64_t candidates = 0;
+        uint64_t issued = 0;
+        uint64_t null = 0;
+        uint64_t page_cross = 0;
+        uint64_t recently_issued = 0;
+        uint64_t recently_demanded = 0;
+        uint64_t refused = 0;                       // Passed this filter, refused further down or held and dropped
+        uint64_t held = 0;                          // Passed this filter, held further down to retry
+    };
+
+    explicit pf_issue_filter(std::vector<std::string> source_names = {"prefetcher"}, bool drop_page_cross_ = false)
+        : recent(Issue_filter_size), drop_page_cross(drop_page_cross_) {
+        for (std::string& name : source_names) {
+            sources.push_back({std::move(name)});
+        }
+    }
+
+    // Every access the prefetcher sees, before it runs
+    void on_demand(uint64_t addr) {
+        uint64_t line = addr >> LOG2_BLOCK_SIZE;
+        recent[slot(line)] = {line + 1, false};
+    }
+
+    pf_issue_result issue(pf_issuer& next, uint64_t trigger_addr, int source, uint64_t pf_addr, bool fill_this_level, uint32_t metadata,
+                          int confidence) {
+        source_counts& s = sources[source];
+        s.candidates++;
+        if (pf_addr == 0) {
+            s.null++;
+            return pf_issue_result::REFUSED;
+        }
+        if (drop_page_cross && (pf_addr >> LOG2_PAGE_SIZE) != (trigger_addr >> LOG2_PAGE_SIZE)) {
+            s.page_cross++;
+            return pf_issue_result::REFUSED;
+        }
+        uint64_t line = pf_addr >> LOG2_BLOCK_SIZE;
+        recent_line& entry = recent[slot(line)];
+        if (entry.line == line + 1) {
+            (entry.issued ? s.recently_issued : s.recently_demanded)++;
+            return pf_issue_result::REFUSED;
+        }
+        pf_issue_result result = next.issue(pf_addr, fill_this_level, metadata, confidence);
+        if (result == pf_issue_result::REFUSED) {
+            s.refused++;
+        } else if (result == pf_issue_result::HELD) {
+            s.held++;
+        } else {
+            on_issued(s, pf_addr);
+        }
+        return result;
+    }
+
+    // What became of a candidate of source held further down
+    void on_held_outcome(int source, uint64_t pf_addr, bool issued) {
+        source_counts& s = sources[source];
+        if (issued) {
+            on_issued(s, pf_addr);
+        } else {
+            s.refused++;
+        }
+    }
+
+    void report(const std::string& cache_name) const {
+        std::cout << "----- " << cache_name << " Prefetch Issue Filter -----\n";
+        std::cout << "Source | Candidates | Issued | Null | Page Cross | Recently Issued | Recently Demanded | Refused Below | Held Below\n";
+        for (const source_counts& s : sources) {
+            std::cout << s.name << " | " << s.candidates << " | " << s.issued << " | " << s.null << " | " << s.page_cross << " | "
+                      << s.recently_issued << " | " << s.recently_demanded << " | " << s.refused << " | " << s.held << "\n";
+        }
+    }
+
+    const std::vector<source_counts>& counts() const { return sources; }
+
+    std::size_t footprint_bytes() const { return recent.size() * sizeof(recent_line); }
+
+private:
+    struct recent_line {
+        uint64_t line = 0;                          // Line number + 1, 0 is empty
+        bool issued = false;                        // Issued by this filter rather than demanded
+    };
+
+    std::vector<recent_line> recent;
+    std::vector<source_counts> sources;
+    bool drop_page_cross;
+
+    static std::size_t slot(uint64_t line) { return static_cast<std::size_t>((line ^ (line >> 10)) & (Issue_filter_size - 1)); }
+
+    void on_issued(source_counts& s, uint64_t pf_addr) {
+        uint64_t line = pf_addr >> LOG2_BLOCK_SIZE;
+        s.issued++;
+        recent[slot(line)] = {line + 1, true};
+    }
+};
+
+// Issuer that runs the candidates of one source, triggered by one access, through the issue filter first
+class pf_issue_filter_issuer : public pf_issuer {
+public:
+    pf_issue_filter_issuer(pf_issue_filter& filter_, pf_issuer& next_, uint64_t trigger_addr_, int source_ = 0)
+        : filter(filter_), next(next_), trigger_addr(trigger_addr_), source(source_) {}
+
+    pf_issue_result issue(uint64_t pf_addr, bool fill_this_level, uint32_t metadata, int confidence) override {
+        return filter.issue(next, trigger_addr, source, pf_addr, fill_this_level, metadata, confidence);
+    }
+
+private:
+    pf_issue_filter& filter;
+    pf_issuer& next;
+    uint64_t trigger_addr;
+    int source;
+};
+
+#endif
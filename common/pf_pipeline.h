@@ -0,0 +1,141 @@
+#ifndef COMMON_PF_PIPELINE_H
+#define COMMON_PF_PIPELINE_H
+
+/*
+The stages a standalone prefetcher's candidates go through on the way to its cache, kept together for one cache.
+
+A candidate goes
+  throttle         common/pf_throttle.h, degree and fill level of the current aggressiveness
+  placement        common/pf_placement.h, this level or only the level below
+  issue filter     common/pf_issue.h, null, repeated and just demanded lines
+  row filter       common/pf_row_filter.h, DRAM row activations
+  candidate queue  common/pf_candidate_queue.h, holds what the cache refuses and retries it
+to prefetch_line. Each module (TCP/TCP.cc, MISB/misb.cc, MISB/misb_real.cc, T_SKID/t_skid.cc, LSTM/lstm.cc) keeps
+one pf_pipeline per cache next to its prefetcher and forwards the ChampSim hooks to it:
+  on_access    every access, before the prefetcher runs. True when the throttle level changed, so the module hands
+               level() on to a prefetcher with a degree or distance of its own.
+  issuer       built on the stack for one access, the pf_issuer the prefetcher's candidates of that access go to
+  on_fill      every fill
+  cycle        every cycle, the candidate queue's retries and then the row filter's delayed candidates
+  report       final stats of every stage
+  footprint    every stage's structures for the host time profile (-DPF_PROFILE)
+The pipeline is the pf_held_listener of its row filter and candidate queue: a candidate they held and later issue or
+drop is counted then by the throttle, the issue filter and the module's pf_stats, if it handed one in.
+ENSEMBLE/ensemble.cc shares the same stages between several components, each its own source, with an arbiter in
+front of them, so it builds its own chain.
+*/
+
+#include <cstdint>
+#include <string>
+
+#include "pf_candidate_queue.h"
+#include "pf_component.h"
+#include "pf_issue.h"
+#include "pf_placement.h"
+#include "pf_profile.h"
+#include "pf_row_filter.h"
+#include "pf_stats.h"
+#include "pf_throttle.h"
+
+class pf_pipeline : public pf_held_listener {
+public:
+    // module names every stage's report, drop_page_cross as in pf_issue_filter, stats hears the held candidates' outcomes
+    explicit pf_pipeline(const std::string& module = "prefetcher", bool drop_page_cross = false, pf_stats* stats_ = nullptr)
+        : throttle(module), placement(module), issue_filter({module}, drop_page_cross), row_filter({module}, this), candidate_queue({module}, this),
+          stats(stats_) {}
+
+    // The row filter and candidate queue report to this pipeline
+    pf_pipeline(const pf_pipeline&) = delete;
+    pf_pipeline& operator=(const pf_pipeline&) = delete;
+
+    // The chain of one access, from the throttle down to the cache
+    class issuer : public pf_issuer {
+    public:
+        issuer(pf_pipeline& pipeline, CACHE* cache, uint64_t trigger_addr, uint64_t trigger_ip)
+            : to_cache(cache), to_queue(pipeline.candidate_queue, to_cache, cache->current_cycle, trigger_addr, trigger_ip),
+              to_rows(pipeline.row_filter, to_queue, cache->current_cycle, trigger_ip), to_filter(pipeline.issue_filter, to_rows, trigger_addr),
+              to_placement(pipeline.placement, to_filter, trigger_ip), to_throttle(pipeline.throttle, to_placement) {}
+
+        // Every stage holds a reference to the next one
+        issuer(const issuer&) = delete;
+        issuer& operator=(const issuer&) = delete;
+
+        pf_issue_result issue(uint64_t pf_addr, bool fill_this_level, uint32_t metadata, int confidence) override {
+            return to_throttle.issue(pf_addr, fill_this_level, metadata, confidence);
+        }
+
+    private:
+        pf_cache_issuer to_cache;
+        pf_candidate_queue_issuer to_queue;
+        pf_row_filter_issuer to_rows;
+        pf_issue_filter_issuer to_filter;
+        pf_placement_issuer to_placement;
+        pf_throttle_issuer to_throttle;
+    };
+
+    bool on_access(CACHE* cache, uint64_t addr, bool cache_hit, bool useful_prefetch) {
+        warmup = cache->warmup;
+        if (!cache_hit) {
+            row_filter.on_demand_miss(cache->current_cycle, addr);
+        }
+        issue_filter.on_demand(addr);
+        candidate_queue.on_demand(addr);
+        placement.on_access(addr, cache_hit, useful_prefetch);
+        return throttle.on_access(cache, addr, cache_hit, useful_prefetch);
+    }
+
+    void on_fill(uint64_t addr, bool prefetch, uint64_t evicted_addr) {
+        throttle.on_fill(addr, prefetch);
+        placement.on_fill(addr, prefetch, evicted_addr);
+    }
+
+    void cycle(CACHE* cache) {
+        warmup = cache->warmup;
+        pf_cache_issuer to_cache(cache);
+        candidate_queue.cycle(to_cache, cache->current_cycle);
+        row_filter.cycle([&](int, uint64_t trigger_ip, uint64_t pf_addr, bool fill_this_level, uint32_t metadata, int confidence) {
+            return candidate_queue.issue(to_cache, cache->current_cycle, 0, trigger_ip, 0, pf_addr, fill_this_level, metadata, confidence);
+        }, cache->current_cycle);
+    }
+
+    void held_outcome(int /*source*/, uint64_t pf_addr, uint64_t trigger_ip, bool issued) override {
+        if (issued) {
+            throttle.on_issued(pf_addr);
+        }
+        issue_filter.on_held_outcome(0, pf_addr, issued);
+        if (stats != nullptr) {
+            stats->on_held_outcome(warmup, pf_addr, trigger_ip, issued);
+        }
+    }
+
+    const pf_aggressiveness& level() const { return throttle.level(); }
+
+    void report(const std::string& cache_name) const {
+        issue_filter.report(cache_name);
+        row_filter.report(cache_name);
+        throttle.report(cache_name);
+        candidate_queue.report(cache_name);
+        placement.report(cache_name);
+    }
+
+    void footprint(pf_profile& profile) const {
+        profile.structure("row_filter", row_filter.footprint_bytes(), 2);
+        profile.structure("issue_filter", issue_filter.footprint_bytes(), 1);
+        profile.structure("throttle", throttle.footprint_bytes(), 2);
+        profile.structure("candidate_queue", candidate_queue.footprint_bytes(), 1);
+        profile.structure("placement", placement.footprint_bytes(), 3);
+    }
+
+    // The stages, in the order a candidate goes through them
+    pf_throttle throttle;
+    pf_placement placement;
+    pf_issue_filter issue_filter;
+    pf_row_filter row_filter;
+    pf_candidate_queue candidate_queue;
+
+private:
+    pf_stats* stats;
+    bool warmup = false;                            // The cache's, as of the last access or cycle
+};
+
+#endif
@@ -0,0 +1,219 @@
+#ifndef COMMON_PF_PLACEMENT_H
+#define COMMON_PF_PLACEMENT_H
+
+/*
+Fill level placement of prefetch candidates: whether a candidate fills this cache or only the level below it.
+
+A prefetch into this level that is never used evicts a line that may be. A guess is cheaper to place in the next
+level, where it still saves the DRAM access but only pollutes a bigger cache. For every candidate the prefetcher
+asked to fill this level with, the policy looks at:
+  confidence   the prefetcher's own, 0 to Confidence_max (common/pf_component.h)
+  pc           how the prefetches of the triggering PC did: useful (a demand hit on the prefetched line) or useless
+               (evicted before any use), in saturating counters per PC that are halved every Placement_interval
+  pollution    the share of the last interval's demand misses that went to lines a prefetch fill had evicted
+and places it in this level when
+  the PC is known useful (Pc_accuracy_high or better over at least Pc_min_samples), or
+  the PC is not known useless (below Pc_accuracy_low) and confidence >= Placement_confidence, raised to
+  Placement_confidence_polluting while pollution is at Pollution_high or above
+Only prefetches into this level give feedback here, so a PC sent to the next level is judged by its confidence again
+once its counters have decayed.
+
+Every decision is counted by reason, and by confidence, in the final stats.
+*/
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "pf_component.h"
+
+const int Placement_confidence = Confidence_max / 2;
+const int Placement_confidence_polluting = Confidence_max * 3 / 4;
+const double Pollution_high = 0.10;                 // Polluted share of demand misses
+const double Pc_accuracy_high = 0.75;
+const double Pc_accuracy_low = 0.25;
+const uint32_t Pc_min_samples = 8;
+const uint64_t Placement_interval = 4096;           // Accesses between pollution samples and PC counter decay
+const std::size_t Placement_pc_entries = 256;       // Untagged PC usefulness counters (power of two)
+const std::size_t Placement_tracked_lines = 4096;   // Lines prefetched into this level, for feedback (power of two)
+const std::size_t Pollution_filter_bits = 4096;     // Lines evicted by prefetch fills (power of two)
+
+class pf_placement {
+public:
+    enum reason { REQUESTED_NEXT, CONFIDENT, USEFUL_PC, LOW_CONFIDENCE, POLLUTING, USELESS_PC, NUM_REASONS };
+
+    explicit pf_placement(std::string module_ = "prefetcher")
+        : module(std::move(module_)), pcs(Placement_pc_entries), tracked(Placement_tracked_lines), evicted_by_prefetch(Pollution_filter_bits, false) {}
+
+    // Every access, before the prefetcher runs
+    void on_access(uint64_t addr, bool cache_hit, bool useful_prefetch) {
+        tracked_line& entry = track(addr);
+        if (entry.line == (addr >> LOG2_BLOCK_SIZE) + 1) {
+            if (useful_prefetch) {
+                saturating_add(pcs[pc_slot(entry.pc)].useful);
+            }
+            entry.line = 0;
+        }
+        if (!cache_hit) {
+            interval_misses++;
+            std::vector<bool>::reference evicted = evicted_by_prefetch[filter_slot(addr)];
+            if (evicted) {
+                interval_polluting++;
+                evicted = false;
+            }
+        }
+        if (++accesses % Placement_interval == 0) {
+            end_interval();
+        }
+    }
+
+    void on_fill(uint64_t /*addr*/, bool prefetch, uint64_t evicted_addr) {
+        if (evicted_addr == 0) {
+            return;
+        }
+        if (prefetch) {
+            evicted_by_prefetch[filter_slot(evicted_addr)] = true;
+        }
+        tracked_line& entry = track(evicted_addr);
+        if (entry.line == (evicted_addr >> LOG2_BLOCK_SIZE) + 1) {
+            saturating_add(pcs[pc_slot(entry.pc)].useless);
+            entry.line = 0;
+        }
+    }
+
+    // A candidate held further down is counted with its decision when held, it goes out with that placement
+    pf_issue_result issue(pf_issuer& next, uint64_t ip, uint64_t pf_addr, bool fill_this_level, uint32_t metadata, int confidence) {
+        reason r = place(ip, fill_this_level, confidence);
+        bool here = r == CONFIDENT || r == USEFUL_PC;
+        pf_issue_result result = next.issue(pf_addr, here, metadata, confidence);
+        if (result == pf_issue_result::REFUSED) {
+            return result;
+        }
+        decisions[r]++;
+        (here ? this_level_by_confidence : next_level_by_confidence)[std::min(std::max(confidence, 0), Confidence_max)]++;
+        if (here) {
+            track(pf_addr) = {(pf_addr >> LOG2_BLOCK_SIZE) + 1, ip};
+        }
+        return result;
+    }
+
+    void report(const std::string& cache_name) const {
+        static const char* const names[NUM_REASONS] = {"Next Level (Requested)", "This Level (Confident)", "This Level (Useful PC)",
+                                                       "Next Level (Low Confidence)", "Next Level (Polluting)", "Next Level (Useless PC)"};
+        std::cout << "----- " << module << " " << cache_name << " Prefetch Fill Placement -----\n";
+        for (int r = 0; r < NUM_REASONS; ++r) {
+            std::cout << names[r] << ": " << decisions[r] << "\n";
+        }
+        std::cout << "Polluting Intervals: " << polluting_intervals << " of " << accesses / Placement_interval << "\n";
+        std::cout << "Last Pollution Rate: " << pollution_rate << "\n";
+        std::cout << "Confidence | This Level | Next Level\n";
+        for (int c = 0; c <= Confidence_max; ++c) {
+            if (this_level_by_confidence[c] + next_level_by_confidence[c] != 0) {
+                std::cout << c << " | " << this_level_by_confidence[c] << " | " << next_level_by_confidence[c] << "\n";
+            }
+        }
+    }
+
+    const std::array<uint64_t, NUM_REASONS>& counts() const { return decisions; }
+
+    std::size_t footprint_bytes() const {
+        return pcs.size() * sizeof(pc_counters) + tracked.size() * sizeof(tracked_line) + evicted_by_prefetch.size() / 8;
+    }
+
+private:
+    struct pc_counters {
+        uint8_t useful = 0;
+        uint8_t useless = 0;
+    };
+
+    struct tracked_line {
+        uint64_t line = 0;                          // Line number + 1, 0 is empty
+        uint64_t pc = 0;                            // PC that triggered the prefetch
+    };
+
+    std::string module;
+    std::vector<pc_counters> pcs;
+    std::vector<tracked_line> tracked;
+    std::vector<bool> evicted_by_prefetch;
+    std::array<uint64_t, NUM_REASONS> decisions{};
+    std::array<uint64_t, Confidence_max + 1> this_level_by_confidence{};
+    std::array<uint64_t, Confidence_max + 1> next_level_by_confidence{};
+    uint64_t accesses = 0;
+    uint64_t interval_misses = 0;
+    uint64_t interval_polluting = 0;
+    uint64_t polluting_intervals = 0;
+    double pollution_rate = 0.0;
+
+    reason place(uint64_t ip, bool fill_this_level, int confidence) const {
+        if (!fill_this_level) {
+            return REQUESTED_NEXT;
+        }
+        const pc_counters& pc = pcs[pc_slot(ip)];
+        uint32_t samples = pc.useful + pc.useless;
+        if (samples >= Pc_min_samples) {
+            double accuracy = static_cast<double>(pc.useful) / samples;
+            if (accuracy >= Pc_accuracy_high) {
+                return USEFUL_PC;
+            }
+            if (accuracy < Pc_accuracy_low) {
+                return USELESS_PC;
+            }
+        }
+        if (confidence >= Placement_confidence_polluting) {
+            return CONFIDENT;
+        }
+        if (confidence >= Placement_confidence) {
+            return pollution_rate >= Pollution_high ? POLLUTING : CONFIDENT;
+        }
+        return LOW_CONFIDENCE;
+    }
+
+    void end_interval() {
+        pollution_rate = interval_misses == 0 ? 0.0 : static_cast<double>(interval_polluting) / interval_misses;
+        polluting_intervals += pollution_rate >= Pollution_high;
+        interval_misses = 0;
+        interval_polluting = 0;
+        for (pc_counters& pc : pcs) {
+            pc.useful /= 2;
+            pc.useless /= 2;
+        }
+    }
+
+    static void saturating_add(uint8_t& counter) {
+        if (counter < UINT8_MAX) {
+            counter++;
+        }
+    }
+
+    static std::size_t pc_slot(uint64_t ip) { return static_cast<std::size_t>((ip ^ (ip >> 8) ^ (ip >> 16)) & (Placement_pc_entries - 1)); }
+
+    static std::size_t filter_slot(uint64_t addr) {
+        uint64_t line = addr >> LOG2_BLOCK_SIZE;
+        return static_cast<std::size_t>((line ^ (line >> 12)) & (Pollution_filter_bits - 1));
+    }
+
+    tracked_line& track(uint64_t addr) {
+        uint64_t line = addr >> LOG2_BLOCK_SIZE;
+        return tracked[(line ^ (line >> 12)) & (Placement_tracked_lines - 1)];
+    }
+};
+
+// Issuer that places the candidates of one access, triggered by ip, before they go on
+class pf_placement_issuer : public pf_issuer {
+public:
+    pf_placement_issuer(pf_placement& placement_, pf_issuer& next_, uint64_t ip_) : placement(placement_), next(next_), ip(ip_) {}
+
+    pf_issue_result issue(uint64_t pf_addr, bool fill_this_level, uint32_t metadata, int confidence) override {
+        return placement.issue(next, ip, pf_addr, fill_this_level, metadata, confidence);
+    }
+
+private:
+    pf_placement& placement;
+    pf_issuer& next;
+    uint64_t ip;
+};
+
+#endif
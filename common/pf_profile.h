@@ -0,0 +1,278 @@
+#ifndef COMMON_PF_PROFILE_H
+#define COMMON_PF_PROFILE_H
+
+/*
+Host time profiling for the prefetcher hooks, compiled in only with -DPF_PROFILE.
+
+Each module wraps its hooks with the macros below. Without PF_PROFILE they expand to nothing and their arguments are
+not evaluated, so the simulation path is unchanged.
+  PF_PROFILE_HOOK(cache, module, hook)          first line of a hook, times the rest of it with the TSC into a
+                                                per cache, per hook log scale histogram (hook is one of pf_hook)
+  PF_PROFILE_FOOTPRINT(cache, module, sample)   from cache_operate, calls sample(profile, cache) every Footprint_period
+                                                calls so the module can report its structures with profile.structure()
+  PF_PROFILE_REPORT(cache, module, sample)      from prefetcher_final_stats, takes a last sample and prints calls,
+                                                total time, p50/p99/max per hook and the structure footprints
+
+Footprints are what the module reports for its major structures, as last seen and at their peak. Both columns are
+estimates, not measurements: resident bytes come from the sizes and the *_bytes helpers' typical container overhead,
+and the heap blocks are the number the module expects the structure to hold (a vector is one, a table of vectors one
+per row). Nothing hooks the allocator here, tools/bench counts real allocations per op. Tables that model a hardware
+budget also pass its size in bits, and the report shows how many host bits each modeled bit costs.
+
+Percentiles come from the histogram buckets (4 per power of two), so they are upper bounds within 25%. TSC ticks
+are converted to ns against steady_clock over the whole run. Every sample includes the ~20 ns of the timer itself,
+which is what an empty hook shows.
+*/
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+enum class pf_hook { initialize = 0, cache_operate, cache_fill, cycle_operate, num_hooks };
+
+inline uint64_t pf_profile_ticks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Log scale latency histogram: exact below 4 ticks, then 4 buckets per power of two
+class pf_latency_histogram {
+public:
+    static constexpr int Num_buckets = 252;
+
+    void add(uint64_t ticks) {
+        buckets[bucket(ticks)]++;
+        count++;
+        total += ticks;
+        max = ticks > max ? ticks : max;
+    }
+
+    // Upper bound of the bucket holding the q quantile, never above the largest sample
+    uint64_t quantile(double q) const {
+        if (count == 0) {
+            return 0;
+        }
+        uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(count - 1)) + 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < Num_buckets; ++i) {
+            seen += buckets[i];
+            if (seen >= rank) {
+                uint64_t upper = upper_bound(i);
+                return upper < max ? upper : max;
+            }
+        }
+        return max;
+    }
+
+    uint64_t count = 0;
+    uint64_t total = 0;
+    uint64_t max = 0;
+
+private:
+    std::array<uint64_t, Num_buckets> buckets{};
+
+    static int bucket(uint64_t ticks) {
+        if (ticks < 4) {
+            return static_cast<int>(ticks);
+        }
+        int msb = 63 - __builtin_clzll(ticks);
+        return 4 * (msb - 1) + static_cast<int>((ticks >> (msb - 2)) & 3);
+    }
+
+    static uint64_t upper_bound(int index) {
+        if (index < 4) {
+            return static_cast<uint64_t>(index);
+        }
+        int msb = index / 4 + 1;
+        uint64_t sub = static_cast<uint64_t>(index % 4);
+        return msb == 63 && sub == 3 ? UINT64_MAX : ((4 + sub + 1) << (msb - 2)) - 1;
+    }
+};
+
+class pf_profile {
+public:
+    static constexpr uint64_t Footprint_period = 1 << 16;    // cache_operate calls between footprint samples
+
+    struct footprint {
+        std::string name;
+        uint64_t bytes = 0;
+        uint64_t allocations = 0;
+        uint64_t peak_bytes = 0;
+        uint64_t peak_allocations = 0;
+        uint64_t modeled_bits = 0;
+    };
+
+    struct clock_start {
+        uint64_t ticks = pf_profile_ticks();
+        std::chrono::steady_clock::time_point time = std::chrono::steady_clock::now();
+    };
+
+    explicit pf_profile(std::string module_) : module(std::move(module_)) {}
+
+    pf_latency_histogram& hook(pf_hook h) { return hooks[static_cast<int>(h)]; }
+
+    // Records the current size of one structure, called from the module's sample expression
+    // allocations is the module's estimate of the heap blocks it holds, modeled_bits is the structure's size in the
+    // modeled hardware, 0 for host only structures
+    void structure(const std::string& name, uint64_t bytes, uint64_t allocations, uint64_t modeled_bits = 0) {
+        footprint* entry = nullptr;
+        for (footprint& f : footprints) {
+            if (f.name == name) {
+                entry = &f;
+            }
+        }
+        if (entry == nullptr) {
+            footprints.push_back({name});
+            entry = &footprints.back();
+        }
+        entry->bytes = bytes;
+        entry->allocations = allocations;
+        entry->modeled_bits = modeled_bits;
+        entry->peak_bytes = bytes > entry->peak_bytes ? bytes : entry->peak_bytes;
+        entry->peak_allocations = allocations > entry->peak_allocations ? allocations : entry->peak_allocations;
+    }
+
+    bool footprint_due() { return operate_calls_since_sample++ % Footprint_period == 0; }
+
+    // Start of the run for the TSC to ns conversion, taken when the first profile is created
+    static const clock_start& start() {
+        static const clock_start s;
+        return s;
+    }
+
+    void report(const std::string& cache_name) const {
+        static const char* hook_names[] = {"initialize", "cache_operate", "cache_fill", "cycle_operate"};
+        std::ios format(nullptr);
+        format.copyfmt(std::cout);
+        double ns_per_tick = clock_ratio();
+        uint64_t all_ticks = 0;
+        for (const pf_latency_histogram& h : hooks) {
+            all_ticks += h.total;
+        }
+
+        std::cout << "----- " << module << " " << cache_name << " Host Time Profile -----\n";
+        std::cout << "Hook | Calls | Total ms | Share | Mean ns | p50 ns | p99 ns | Max ns\n";
+        for (int i = 0; i < static_cast<int>(pf_hook::num_hooks); ++i) {
+            const pf_latency_histogram& h = hooks[i];
+            if (h.count == 0) {
+                continue;
+            }
+            std::cout << hook_names[i] << " | " << h.count << " | " << std::fixed << std::setprecision(3)
+                      << h.total * ns_per_tick / 1e6 << " | " << std::setprecision(3)
+                      << (all_ticks == 0 ? 0.0 : static_cast<double>(h.total) / static_cast<double>(all_ticks)) << " | "
+                      << std::setprecision(1) << h.total * ns_per_tick / static_cast<double>(h.count) << " | "
+                      << h.quantile(0.5) * ns_per_tick << " | " << h.quantile(0.99) * ns_per_tick << " | "
+                      << h.max * ns_per_tick << "\n";
+        }
+        std::cout.copyfmt(format);
+        if (!footprints.empty()) {
+            std::cout << "Structure | Est. Bytes | Est. Heap Blocks | Peak Est. Bytes | Peak Est. Heap Blocks | Modeled Bits | Host Bits Per Modeled Bit\n";
+            for (const footprint& f : footprints) {
+                std::cout << f.name << " | " << f.bytes << " | " << f.allocations << " | " << f.peak_bytes << " | "
+                          << f.peak_allocations << " | ";
+                if (f.modeled_bits == 0) {
+                    std::cout << "- | -\n";
+                } else {
+                    std::cout << f.modeled_bits << " | " << std::fixed << std::setprecision(2)
+                              << 8.0 * static_cast<double>(f.bytes) / static_cast<double>(f.modeled_bits) << "\n";
+                    std::cout.copyfmt(format);
+                }
+            }
+        }
+    }
+
+private:
+    std::string module;
+    std::array<pf_latency_histogram, static_cast<int>(pf_hook::num_hooks)> hooks;
+    std::vector<footprint> footprints;
+    uint64_t operate_calls_since_sample = 0;
+
+    // ns per TSC tick over the run so far
+    static double clock_ratio() {
+#if defined(__x86_64__) || defined(__i386__)
+        uint64_t ticks = pf_profile_ticks() - start().ticks;
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start().time).count();
+        return ticks == 0 ? 1.0 : ns / static_cast<double>(ticks);
+#else
+        return 1.0;
+#endif
+    }
+
+};
+
+// One profile per cache. The last lookup is remembered, since the hooks of one cache tend to run back to back.
+inline pf_profile& pf_profile_for(const void* cache, const char* module)
+{
+    static std::unordered_map<const void*, pf_profile> profiles;
+    static const void* last_cache = nullptr;
+    static pf_profile* last_profile = nullptr;
+    if (cache != last_cache) {
+        pf_profile::start();
+        last_profile = &profiles.try_emplace(cache, module).first->second;
+        last_cache = cache;
+    }
+    return *last_profile;
+}
+
+// Times the enclosing scope into one hook histogram
+class pf_profile_scope {
+public:
+    pf_profile_scope(pf_profile& profile, pf_hook h) : histogram(profile.hook(h)), start(pf_profile_ticks()) {}
+    ~pf_profile_scope() { histogram.add(pf_profile_ticks() - start); }
+
+    pf_profile_scope(const pf_profile_scope&) = delete;
+    pf_profile_scope& operator=(const pf_profile_scope&) = delete;
+
+private:
+    pf_latency_histogram& histogram;
+    uint64_t start;
+};
+
+// Footprint estimates for the standard containers, with typical libstdc++ node overheads //
+
+template <typename V>
+uint64_t pf_vector_bytes(const V& v) { return sizeof(V) + v.capacity() * sizeof(typename V::value_type); }
+
+template <typename M>
+uint64_t pf_tree_bytes(const M& m) { return sizeof(M) + m.size() * (32 + sizeof(typename M::value_type)); }
+
+template <typename M>
+uint64_t pf_hash_bytes(const M& m)
+{
+    return sizeof(M) + m.bucket_count() * sizeof(void*) + m.size() * (2 * sizeof(void*) + sizeof(typename M::value_type));
+}
+
+#ifdef PF_PROFILE
+#define PF_PROFILE_HOOK(cache, module, hook) pf_profile_scope pf_profile_hook_scope(pf_profile_for(cache, module), pf_hook::hook)
+#define PF_PROFILE_FOOTPRINT(cache, module, sample) \
+    do { \
+        if (pf_profile_for(cache, module).footprint_due()) { \
+            sample(pf_profile_for(cache, module), cache); \
+        } \
+    } while (0)
+#define PF_PROFILE_REPORT(cache, module, sample) \
+    do { \
+        pf_profile& pf_profile_report = pf_profile_for(cache, module); \
+        sample(pf_profile_report, cache); \
+        pf_profile_report.report((cache)->NAME); \
+    } while (0)
+#else
+#define PF_PROFILE_HOOK(cache, module, hook) ((void)0)
+#define PF_PROFILE_FOOTPRINT(cache, module, sample) ((void)0)
+#define PF_PROFILE_REPORT(cache, module, sample) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,333 @@
+#ifndef COMMON_PF_ROW_FILTER_H
+#define COMMON_PF_ROW_FILTER_H
+
+/*
+DRAM row activation filter for prefetch candidates, and the hammer pressure each prefetcher creates.
+
+Every candidate a prefetcher decides on is mapped to its DRAM (channel, rank, bank, row) with ChampSim's default
+address mapping, from the low bits up: block offset, channel, bank, column, rank, row. Row_bank_xor additionally XORs
+the low row bits into the bank, as permutation based controllers do.
+
+A candidate that hits the row open in its bank costs no activation. Otherwise it would activate its row, and the
+row's activation count for the current refresh window is estimated with a count-min sketch (Sketch_depth rows of
+Sketch_width counters, cleared every Refresh_window_cycles). Demand misses seen by the prefetcher are counted too, so
+the estimate covers the whole stream the prefetcher observes. A candidate that would take its row to
+Activation_threshold or above is handled by Row_filter_policy:
+  OBSERVE  issued anyway, only counted
+  DROP     refused, the prefetcher sees it as a full prefetch queue
+  DELAY    held for up to Max_delay_cycles and retried every cycle. It goes out once its row is open or a new
+           window has started, and is dropped on timeout, when Delay_queue_size candidates are already waiting or
+           when its line is already waiting. A delayed candidate is answered HELD (common/pf_component.h), and the
+           filter tells its pf_held_listener once it is issued or dropped; one the next stage holds in turn is
+           reported by that stage.
+Whether a prefetch really reaches DRAM depends on the levels below, so the counts are an upper bound on the
+activations the prefetcher causes.
+
+Per source (one prefetcher, or each ensemble component) the filter reports the candidates, row hits, activations,
+delays and drops, and a log2 histogram of the row's estimated activation count each time the source activated it.
+*/
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "pf_component.h"
+#include "pf_extent.h"
+#include "pf_geometry.h"
+
+enum class row_policy { OBSERVE, DROP, DELAY };
+
+// DRAM geometry (Dram_channels, Dram_ranks, Dram_banks, Dram_columns) is in common/pf_geometry.h
+const bool Row_bank_xor = false;                    // XOR the low row bits into the bank index
+
+// Filter
+const row_policy Row_filter_policy = row_policy::DELAY;
+const uint64_t Refresh_window_cycles = 256000000;   // 64 ms at 4 GHz
+const uint32_t Activation_threshold = 4096;         // Estimated activations of one row per window before candidates are held back
+const uint64_t Max_delay_cycles = 2000;
+const std::size_t Delay_queue_size = 16;
+const std::size_t Sketch_depth = 4;
+const std::size_t Sketch_width = 4096;              // Counters per sketch row (power of two)
+
+struct dram_location {
+    unsigned channel;
+    unsigned rank;
+    unsigned bank;
+    uint64_t row;
+
+    unsigned bank_id() const { return (channel * Dram_ranks + rank) * Dram_banks + bank; }
+    uint64_t key() const { return (static_cast<uint64_t>(bank_id()) << 40) ^ row; }
+};
+
+inline dram_location map_to_dram(uint64_t addr)
+{
+    constexpr unsigned channel_bits = pf_log2(Dram_channels);
+    constexpr unsigned bank_bits = pf_log2(Dram_banks);
+    constexpr unsigned column_bits = pf_log2(Dram_columns);
+    constexpr unsigned rank_bits = pf_log2(Dram_ranks);
+
+    uint64_t bits = addr >> LOG2_BLOCK_SIZE;
+    dram_location loc;
+    loc.channel = static_cast<unsigned>(bits & ((1u << channel_bits) - 1));
+    bits >>= channel_bits;
+    loc.bank = static_cast<unsigned>(bits & ((1u << bank_bits) - 1));
+    bits >>= bank_bits + column_bits;
+    loc.rank = static_cast<unsigned>(bits & ((1u << rank_bits) - 1));
+    bits >>= rank_bits;
+    loc.row = bits;
+    if (Row_bank_xor) {
+        loc.bank ^= static_cast<unsigned>(loc.row & ((1u << bank_bits) - 1));
+    }
+    return loc;
+}
+
+// Count-min sketch of per row activations, never underestimates
+class activation_sketch {
+public:
+    activation_sketch() : counters(Sketch_depth * Sketch_width, 0) {}
+
+    uint32_t estimate(uint64_t key) const {
+        uint32_t count = UINT32_MAX;
+        for (std::size_t d = 0; d < Sketch_depth; ++d) {
+            count = std::min(count, counters[d * Sketch_width + index(key, d)]);
+        }
+        return count;
+    }
+
+    // Adds one activation, returns the new estimate (conservative update: only the smallest counters grow)
+    uint32_t add(uint64_t key) {
+        uint32_t next = estimate(key) + 1;
+        for (std::size_t d = 0; d < Sketch_depth; ++d) {
+            uint32_t& c = counters[d * Sketch_width + index(key, d)];
+            c = std::max(c, next);
+        }
+        return next;
+    }
+
+    void clear() { std::fill(counters.begin(), counters.end(), 0); }
+
+    std::size_t bytes() const { return counters.size() * sizeof(uint32_t); }
+
+private:
+    std::vector<uint32_t> counters;
+
+    static std::size_t index(uint64_t key, std::size_t d) {
+        static const uint64_t seeds[] = {0x9E3779B97F4A7C15ULL, 0xBF58476D1CE4E5B9ULL, 0x94D049BB133111EBULL, 0xD6E8FEB86659FD93ULL};
+        uint64_t h = (key + d) * seeds[d % 4];
+        return static_cast<std::size_t>((h ^ (h >> 31)) & (Sketch_width - 1));
+    }
+};
+
+class pf_row_filter {
+public:
+    static constexpr int Histogram_buckets = 24;    // log2 buckets of the estimated row count
+
+    struct source_counts {
+        std::string name;
+        uint64_t candidates = 0;
+        uint64_t row_hits = 0;                      // Issued to an open row, no activation
+        uint64_t activations = 0;                   // Issued and activating its row
+        uint64_t over_threshold = 0;                // Candidates that hit the threshold
+        uint64_t delayed = 0;
+        uint64_t delayed_issued = 0;
+        uint64_t dropped = 0;                       // Refused by DROP, a full delay queue, its line already delayed or a delay timeout
+        uint32_t peak_row_count = 0;                // Highest estimate a row reached when this source activated it
+        std::array<uint64_t, Histogram_buckets> histogram{};
+    };
+
+    // listener hears what became of every delayed candidate, if not null
+    explicit pf_row_filter(std::vector<std::string> source_names = {"prefetcher"}, pf_held_listener* listener_ = nullptr)
+        : open_rows(Dram_channels * Dram_ranks * Dram_banks, UINT64_MAX), listener(listener_) {
+        for (std::string& name : source_names) {
+            sources.push_back({std::move(name)});
+        }
+    }
+
+    // A demand miss the prefetcher saw, it activates the row unless the row is open
+    void on_demand_miss(uint64_t cycle, uint64_t addr) {
+        roll_window(cycle);
+        dram_location loc = map_to_dram(addr);
+        if (open_rows[loc.bank_id()] != loc.row) {
+            open_rows[loc.bank_id()] = loc.row;
+            sketch.add(loc.key());
+        }
+    }
+
+    // Filters one candidate from source, triggered by trigger_ip, before it goes to next. Returns what the prefetcher
+    // should see as the issue result; a delayed candidate is HELD.
+    pf_issue_result issue(pf_issuer& next, uint64_t cycle, uint64_t trigger_ip, int source, uint64_t pf_addr, bool fill_this_level, uint32_t metadata,
+                          int confidence) {
+        roll_window(cycle);
+        source_counts& s = sources[source];
+        s.candidates++;
+
+        dram_location loc = map_to_dram(pf_addr);
+        bool row_hit = open_rows[loc.bank_id()] == loc.row;
+        if (!row_hit && sketch.estimate(loc.key()) + 1 >= Activation_threshold) {
+            s.over_threshold++;
+            if (Row_filter_policy == row_policy::DROP) {
+                s.dropped++;
+                return pf_issue_result::REFUSED;
+            }
+            if (Row_filter_policy == row_policy::DELAY) {
+                uint64_t line = pf_addr >> LOG2_BLOCK_SIZE;
+                if (delayed.size() >= Delay_queue_size
+                    || std::any_of(delayed.begin(), delayed.end(), [&](const delayed_candidate& c) { return c.pf_addr >> LOG2_BLOCK_SIZE == line; })) {
+                    s.dropped++;
+                    return pf_issue_result::REFUSED;
+                }
+                s.delayed++;
+                delayed.push_back({pf_addr, trigger_ip, fill_this_level, metadata, confidence, source, cycle + Max_delay_cycles, window});
+                return pf_issue_result::HELD;
+            }
+        }
+        return send(next, source, loc, pf_addr, fill_this_level, metadata, confidence);
+    }
+
+    // Retries the delayed candidates, call every cycle. Each retry goes to
+    // retry(source, trigger_ip, pf_addr, fill_this_level, metadata, confidence), which returns what the next stage's
+    // issuer would, so a next stage shared by several sources (the ensemble's candidate queue) knows whose it is.
+    template <typename Retry>
+    void cycle(Retry retry, uint64_t cycle) {
+        if (delayed.empty()) {
+            return;
+        }
+        roll_window(cycle);
+        for (auto it = delayed.begin(); it != delayed.end();) {
+            dram_location loc = map_to_dram(it->pf_addr);
+            bool row_hit = open_rows[loc.bank_id()] == loc.row;
+            if (row_hit || it->window != window) {
+                sources[it->source].delayed_issued++;
+                pf_issue_result result = retry(it->source, it->trigger_ip, it->pf_addr, it->fill_this_level, it->metadata, it->confidence);
+                if (result != pf_issue_result::REFUSED) {
+                    record_sent(it->source, loc);
+                }
+                if (result != pf_issue_result::HELD) {
+                    notify(*it, result == pf_issue_result::ISSUED);
+                }
+                it = delayed.erase(it);
+            } else if (cycle >= it->deadline) {
+                sources[it->source].dropped++;
+                notify(*it, false);
+                it = delayed.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    void report(const std::string& cache_name) const {
+        std::cout << "----- " << cache_name << " Prefetch Row Activations (threshold " << Activation_threshold << " per window, "
+                  << (Row_filter_policy == row_policy::OBSERVE ? "observe" : Row_filter_policy == row_policy::DROP ? "drop" : "delay")
+                  << ") -----\n";
+        std::cout << "Refresh Windows: " << window + 1 << "\n";
+        std::cout << "Source | Candidates | Row Hits | Activations | Over Threshold | Delayed | Delayed Issued | Dropped | Peak Row Count\n";
+        for (const source_counts& s : sources) {
+            std::cout << s.name << " | " << s.candidates << " | " << s.row_hits << " | " << s.activations << " | " << s.over_threshold
+                      << " | " << s.delayed << " | " << s.delayed_issued << " | " << s.dropped << " | " << s.peak_row_count << "\n";
+        }
+        for (const source_counts& s : sources) {
+            if (s.activations == 0) {
+                continue;
+            }
+            std::cout << s.name << " activations by row count:";
+            for (int b = 0; b < Histogram_buckets; ++b) {
+                if (s.histogram[b] != 0) {
+                    std::cout << " [" << (b == 0 ? 1 : (1u << b)) << "," << (1u << (b + 1)) << "):" << s.histogram[b];
+                }
+            }
+            std::cout << "\n";
+        }
+    }
+
+    const std::vector<source_counts>& counts() const { return sources; }
+
+    std::size_t footprint_bytes() const { return sketch.bytes() + open_rows.size() * sizeof(uint64_t); }
+
+private:
+    struct delayed_candidate {
+        uint64_t pf_addr;
+        uint64_t trigger_ip;
+        bool fill_this_level;
+        uint32_t metadata;
+        int confidence;
+        int source;
+        uint64_t deadline;
+        uint64_t window;                            // Refresh window it was delayed in
+    };
+
+    activation_sketch sketch;
+    std::vector<uint64_t> open_rows;                // Row open in each bank, UINT64_MAX if none
+    std::vector<source_counts> sources;
+    std::deque<delayed_candidate> delayed;
+    uint64_t window = 0;                            // Refresh windows started so far
+    uint64_t window_start = 0;
+    pf_held_listener* listener;
+
+    void roll_window(uint64_t cycle) {
+        if (cycle < window_start + Refresh_window_cycles) {
+            return;
+        }
+        uint64_t elapsed = (cycle - window_start) / Refresh_window_cycles;
+        window += elapsed;
+        window_start += elapsed * Refresh_window_cycles;
+        sketch.clear();
+    }
+
+    pf_issue_result send(pf_issuer& next, int source, const dram_location& loc, uint64_t pf_addr, bool fill_this_level, uint32_t metadata,
+                         int confidence) {
+        pf_issue_result result = next.issue(pf_addr, fill_this_level, metadata, confidence);
+        if (result != pf_issue_result::REFUSED) {
+            record_sent(source, loc);
+        }
+        return result;
+    }
+
+    void notify(const delayed_candidate& c, bool issued) {
+        if (listener != nullptr) {
+            listener->held_outcome(c.source, c.pf_addr, c.trigger_ip, issued);
+        }
+    }
+
+    // A candidate of source went out to loc: a row hit, or an activation of its row
+    void record_sent(int source, const dram_location& loc) {
+        source_counts& s = sources[source];
+        if (open_rows[loc.bank_id()] == loc.row) {
+            s.row_hits++;
+            return;
+        }
+        open_rows[loc.bank_id()] = loc.row;
+        uint32_t count = sketch.add(loc.key());
+        s.activations++;
+        s.peak_row_count = std::max(s.peak_row_count, count);
+        int bucket = 0;
+        while (bucket + 1 < Histogram_buckets && (1u << (bucket + 1)) <= count) {
+            bucket++;
+        }
+        s.histogram[bucket]++;
+    }
+};
+
+// Issuer that runs every candidate of one source through the row filter first
+class pf_row_filter_issuer : public pf_issuer {
+public:
+    pf_row_filter_issuer(pf_row_filter& filter_, pf_issuer& next_, uint64_t cycle_, uint64_t trigger_ip_, int source_ = 0)
+        : filter(filter_), next(next_), cycle(cycle_), trigger_ip(trigger_ip_), source(source_) {}
+
+    pf_issue_result issue(uint64_t pf_addr, bool fill_this_level, uint32_t metadata, int confidence) override {
+        return filter.issue(next, cycle, trigger_ip, source, pf_addr, fill_this_level, metadata, confidence);
+    }
+
+private:
+    pf_row_filter& filter;
+    pf_issuer& next;
+    uint64_t cycle;
+    uint64_t trigger_ip;
+    int source;
+};
+
+#endif
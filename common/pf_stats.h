@@ -0,0 +1,328 @@
+#ifndef COMMON_PF_STATS_H
+#define COMMON_PF_STATS_H
+
+/*
+Prefetch quality statistics shared by every prefetcher module.
+
+Each module keeps one pf_stats per cache instance and calls it from its hooks:
+  on_access   from prefetcher_cache_operate, with the hit and useful_prefetch flags ChampSim passes in
+  on_prefetch after every candidate, with what prefetch_line or the module's pf_issuer returned
+  on_held_outcome once a candidate answered HELD is issued or dropped (common/pf_component.h)
+  on_fill     from prefetcher_cache_fill
+  on_lookup   for each lookup in the module's own metadata structures, registered with add_structure
+and report() from prefetcher_final_stats. Every call takes the cache's warmup flag, so warmup and the region of
+interest are counted separately.
+
+The quality metrics are tracked here, since ChampSim does not pass all of them to the prefetcher:
+  useful   demand hit on a prefetched line (useful_prefetch)
+  late     demand miss on a line whose prefetch has been issued but not filled yet
+  useless  prefetched line evicted before any demand touched it
+  accuracy = useful / issued, coverage = useful / (useful + demand misses)
+A HELD candidate counts as held, and then as issued or dropped once the stage holding it knows which.
+Issued prefetches are remembered in a direct mapped table of Tracked_prefetches lines, so late and useless are
+approximate once more prefetches than that are outstanding.
+
+Counters are written by the simulation thread only, with relaxed atomics so another thread (the sweep harness)
+may read them while a run is going. Per PC, the top Top_pcs PCs by prefetches issued and by useful prefetches are
+kept with the space saving algorithm.
+
+report() prints a summary and writes <prefix>_<module>_<cache>.json and .csv, where prefix is the PF_STATS_PREFIX
+environment variable or "pf_stats".
+*/
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "pf_component.h"
+
+// Single writer counter that other threads can read without a data race
+class relaxed_counter {
+public:
+    void add(uint64_t n = 1) { value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+    uint64_t get() const { return value.load(std::memory_order_relaxed); }
+    relaxed_counter& operator++() { add(); return *this; }
+
+    relaxed_counter() = default;
+    relaxed_counter(const relaxed_counter& other) : value(other.get()) {}
+    relaxed_counter& operator=(const relaxed_counter& other) { value.store(other.get(), std::memory_order_relaxed); return *this; }
+
+private:
+    std::atomic<uint64_t> value{0};
+};
+
+// Space saving top-N: approximate counts of the N most frequent keys in constant space
+template <std::size_t N>
+class top_n {
+public:
+    struct slot {
+        uint64_t key = 0;
+        uint64_t count = 0;
+    };
+
+    void add(uint64_t key) {
+        slot* smallest = &slots[0];
+        for (slot& s : slots) {
+            if (s.count != 0 && s.key == key) {
+                s.count++;
+                return;
+            }
+            if (s.count < smallest->count) {
+                smallest = &s;
+            }
+        }
+        // Replacing the smallest slot inherits its count, which bounds the overestimate
+        smallest->key = key;
+        smallest->count++;
+    }
+
+    // Slots in use, largest count first
+    std::vector<slot> sorted() const {
+        std::vector<slot> result;
+        for (const slot& s : slots) {
+            if (s.count != 0) {
+                result.push_back(s);
+            }
+        }
+        std::sort(result.begin(), result.end(), [](const slot& a, const slot& b) { return a.count > b.count; });
+        return result;
+    }
+
+private:
+    std::array<slot, N> slots{};
+};
+
+class pf_stats {
+public:
+    static constexpr std::size_t Tracked_prefetches = 4096;  // Outstanding/resident prefetched lines remembered (power of two)
+    static constexpr std::size_t Top_pcs = 8;                // PCs kept per ranking
+    static constexpr unsigned Line_shift = 6;                // 64 byte lines, as LOG2_BLOCK_SIZE
+
+    struct structure_counts {
+        relaxed_counter hits;
+        relaxed_counter misses;
+    };
+
+    struct phase_counts {
+        relaxed_counter accesses;
+        relaxed_counter demand_misses;
+        relaxed_counter prefetch_requests;                   // Candidates handed to prefetch_line or the issuer
+        relaxed_counter issued;                              // Accepted by prefetch_line, at once or on a retry
+        relaxed_counter dropped;                             // Refused, or held and never issued
+        relaxed_counter held;                                // Held to retry, also counted once issued or dropped
+        relaxed_counter useful;
+        relaxed_counter late;
+        relaxed_counter useless;
+        std::vector<structure_counts> structures;
+        top_n<Top_pcs> top_issued;
+        top_n<Top_pcs> top_useful;
+    };
+
+    explicit pf_stats(std::string module_) : module(std::move(module_)), tracked(Tracked_prefetches) {}
+
+    // Registers a metadata structure for on_lookup, returns its id
+    int add_structure(const std::string& name) {
+        structure_names.push_back(name);
+        warmup_counts.structures.resize(structure_names.size());
+        roi_counts.structures.resize(structure_names.size());
+        return static_cast<int>(structure_names.size() - 1);
+    }
+
+    void on_access(bool warmup, uint64_t addr, bool cache_hit, bool useful_prefetch) {
+        phase_counts& p = phase(warmup);
+        ++p.accesses;
+        tracked_line& entry = slot(addr);
+        bool is_tracked = entry.line == line_key(addr);
+
+        if (useful_prefetch) {
+            ++p.useful;
+            if (is_tracked) {
+                p.top_useful.add(entry.pc);
+                entry.line = 0;                              // Used, it can no longer be useless
+            }
+        } else if (!cache_hit) {
+            ++p.demand_misses;
+            if (is_tracked && !entry.filled) {
+                ++p.late;
+                entry.line = 0;
+            }
+        }
+    }
+
+    void on_prefetch(bool warmup, uint64_t pf_addr, uint64_t trigger_ip, pf_issue_result result) {
+        phase_counts& p = phase(warmup);
+        ++p.prefetch_requests;
+        if (result == pf_issue_result::HELD) {
+            ++p.held;
+            return;
+        }
+        on_outcome(p, pf_addr, trigger_ip, result == pf_issue_result::ISSUED);
+    }
+
+    void on_held_outcome(bool warmup, uint64_t pf_addr, uint64_t trigger_ip, bool issued) { on_outcome(phase(warmup), pf_addr, trigger_ip, issued); }
+
+    void on_fill(bool warmup, uint64_t addr, bool prefetch, uint64_t evicted_addr) {
+        if (evicted_addr != 0) {
+            tracked_line& victim = slot(evicted_addr);
+            if (victim.line == line_key(evicted_addr) && victim.filled) {
+                ++phase(warmup).useless;
+                victim.line = 0;
+            }
+        }
+        if (prefetch) {
+            tracked_line& entry = slot(addr);
+            if (entry.line == line_key(addr)) {
+                entry.filled = true;
+            }
+        }
+    }
+
+    void on_lookup(bool warmup, int structure, bool hit) {
+        structure_counts& s = phase(warmup).structures[structure];
+        hit ? ++s.hits : ++s.misses;
+    }
+
+    const phase_counts& counts(bool warmup) const { return warmup ? warmup_counts : roi_counts; }
+
+    // Prints the region of interest summary and writes both phases as JSON and CSV
+    void report(const std::string& cache_name) const {
+        const phase_counts& p = roi_counts;
+        std::cout << "----- " << module << " " << cache_name << " Prefetch Quality (ROI) -----\n";
+        std::cout << "Accesses: " << p.accesses.get() << "\n";
+        std::cout << "Demand Misses: " << p.demand_misses.get() << "\n";
+        std::cout << "Prefetches Issued: " << p.issued.get() << "\n";
+        std::cout << "Prefetches Dropped: " << p.dropped.get() << "\n";
+        std::cout << "Prefetches Held: " << p.held.get() << "\n";
+        std::cout << "Useful Prefetches: " << p.useful.get() << "\n";
+        std::cout << "Late Prefetches: " << p.late.get() << "\n";
+        std::cout << "Useless Prefetches (Evicted Unused): " << p.useless.get() << "\n";
+        std::cout << "Accuracy: " << accuracy(p) << "\n";
+        std::cout << "Coverage: " << coverage(p) << "\n";
+        for (std::size_t i = 0; i < structure_names.size(); ++i) {
+            std::cout << structure_names[i] << " Hit Rate: " << hit_rate(p.structures[i]) << "\n";
+        }
+
+        std::string prefix = std::getenv("PF_STATS_PREFIX") != nullptr ? std::getenv("PF_STATS_PREFIX") : "pf_stats";
+        std::string base = prefix + "_" + module + "_" + cache_name;
+        write_json(base + ".json", cache_name);
+        write_csv(base + ".csv", cache_name);
+    }
+
+private:
+    struct tracked_line {
+        uint64_t line = 0;                                   // Line number + 1, 0 is empty
+        uint64_t pc = 0;
+        bool filled = false;
+    };
+
+    std::string module;
+    std::vector<std::string> structure_names;
+    phase_counts warmup_counts;
+    phase_counts roi_counts;
+    std::vector<tracked_line> tracked;
+
+    phase_counts& phase(bool warmup) { return warmup ? warmup_counts : roi_counts; }
+
+    void on_outcome(phase_counts& p, uint64_t pf_addr, uint64_t trigger_ip, bool issued) {
+        if (!issued) {
+            ++p.dropped;
+            return;
+        }
+        ++p.issued;
+        p.top_issued.add(trigger_ip);
+        tracked_line& entry = slot(pf_addr);
+        entry = {line_key(pf_addr), trigger_ip, false};
+    }
+
+    static uint64_t line_key(uint64_t addr) { return (addr >> Line_shift) + 1; }
+
+    tracked_line& slot(uint64_t addr) {
+        uint64_t line = addr >> Line_shift;
+        return tracked[(line ^ (line >> 12)) & (Tracked_prefetches - 1)];
+    }
+
+    static double ratio(uint64_t num, uint64_t den) { return den == 0 ? 0.0 : static_cast<double>(num) / static_cast<double>(den); }
+    static double accuracy(const phase_counts& p) { return ratio(p.useful.get(), p.issued.get()); }
+    static double coverage(const phase_counts& p) { return ratio(p.useful.get(), p.useful.get() + p.demand_misses.get()); }
+    static double hit_rate(const structure_counts& s) { return ratio(s.hits.get(), s.hits.get() + s.misses.get()); }
+
+    void write_phase_json(std::ofstream& file, const phase_counts& p) const {
+        file << "{\"accesses\": " << p.accesses.get() << ", \"demand_misses\": " << p.demand_misses.get()
+             << ", \"prefetch_requests\": " << p.prefetch_requests.get() << ", \"issued\": " << p.issued.get()
+             << ", \"dropped\": " << p.dropped.get() << ", \"held\": " << p.held.get() << ", \"useful\": " << p.useful.get()
+             << ", \"late\": " << p.late.get() << ", \"useless\": " << p.useless.get() << ", \"accuracy\": " << accuracy(p) << ", \"coverage\": " << coverage(p)
+             << ", \"structures\": {";
+        for (std::size_t i = 0; i < structure_names.size(); ++i) {
+            file << (i == 0 ? "" : ", ") << "\"" << structure_names[i] << "\": {\"hits\": " << p.structures[i].hits.get()
+                 << ", \"misses\": " << p.structures[i].misses.get() << ", \"hit_rate\": " << hit_rate(p.structures[i]) << "}";
+        }
+        file << "}, \"top_issued_pcs\": [";
+        write_top_json(file, p.top_issued);
+        file << "], \"top_useful_pcs\": [";
+        write_top_json(file, p.top_useful);
+        file << "]}";
+    }
+
+    static void write_top_json(std::ofstream& file, const top_n<Top_pcs>& top) {
+        bool first = true;
+        for (const auto& s : top.sorted()) {
+            file << (first ? "" : ", ") << "{\"pc\": " << s.key << ", \"count\": " << s.count << "}";
+            first = false;
+        }
+    }
+
+    void write_json(const std::string& path, const std::string& cache_name) const {
+        std::ofstream file(path);
+        if (!file) {
+            std::cerr << "Could not write " << path << std::endl;
+            return;
+        }
+        file << "{\"module\": \"" << module << "\", \"cache\": \"" << cache_name << "\", \"warmup\": ";
+        write_phase_json(file, warmup_counts);
+        file << ", \"roi\": ";
+        write_phase_json(file, roi_counts);
+        file << "}\n";
+    }
+
+    // One row per metric: module,cache,phase,metric,value
+    void write_csv(const std::string& path, const std::string& cache_name) const {
+        std::ofstream file(path);
+        if (!file) {
+            std::cerr << "Could not write " << path << std::endl;
+            return;
+        }
+        file << "module,cache,phase,metric,value\n";
+        for (bool warmup : {true, false}) {
+            const phase_counts& p = counts(warmup);
+            std::string row = module + "," + cache_name + "," + (warmup ? "warmup" : "roi") + ",";
+            file << row << "accesses," << p.accesses.get() << "\n";
+            file << row << "demand_misses," << p.demand_misses.get() << "\n";
+            file << row << "prefetch_requests," << p.prefetch_requests.get() << "\n";
+            file << row << "issued," << p.issued.get() << "\n";
+            file << row << "dropped," << p.dropped.get() << "\n";
+            file << row << "held," << p.held.get() << "\n";
+            file << row << "useful," << p.useful.get() << "\n";
+            file << row << "late," << p.late.get() << "\n";
+            file << row << "useless," << p.useless.get() << "\n";
+            file << row << "accuracy," << accuracy(p) << "\n";
+            file << row << "coverage," << coverage(p) << "\n";
+            for (std::size_t i = 0; i < structure_names.size(); ++i) {
+                file << row << structure_names[i] << "_hit_rate," << hit_rate(p.structures[i]) << "\n";
+            }
+            for (const auto& s : p.top_issued.sorted()) {
+                file << row << "issued_pc_" << s.key << "," << s.count << "\n";
+            }
+            for (const auto& s : p.top_useful.sorted()) {
+                file << row << "useful_pc_" << s.key << "," << s.count << "\n";
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,249 @@
+#ifndef COMMON_PF_THROTTLE_H
+#define COMMON_PF_THROTTLE_H
+
+/*
+Feedback directed throttling, so a prefetcher backs off when its prefetches stop paying for themselves.
+
+Every Throttle_interval accesses the controller looks at what the prefetcher's candidates did in that interval:
+  accuracy   (useful + late) / issued
+  lateness   late / (useful + late), a late prefetch is one a demand missed on before it was filled
+  occupancy  the cache's mean MSHR and prefetch queue occupancy, sampled on every access
+and asks for one step along Throttle_levels, following FDP:
+  accuracy >= Accuracy_high              up if late, else stay
+  Accuracy_low <= accuracy < high        up if late and the cache is not busy, else stay
+  accuracy < Accuracy_low                down
+  busy (occupancy >= Occupancy_high)     down unless accuracy >= Accuracy_high
+An interval without issued prefetches stays. The level only moves once Throttle_hysteresis intervals in a row ask
+for the same step, so one noisy interval does not swing it.
+
+A level is a pf_aggressiveness. pf_throttle_issuer applies its degree (candidates let through per access) and fill
+level to any prefetcher. A candidate held further down (common/pf_component.h) takes its place in the degree at
+once, but only counts as issued once on_issued hears it went out. Components with a degree or distance of their own are also handed the level through
+pf_component::throttle whenever it changes. Every interval is kept and written to
+<prefix>_throttle_<module>_<cache>.csv at final stats, prefix as in common/pf_stats.h.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "pf_component.h"
+
+const pf_aggressiveness Throttle_levels[] = {
+    {1, 1, false},                                  // Fills the next level only
+    {1, 1, true},
+    {2, 1, true},
+    {3, 1, true},                                   // Where every prefetcher starts, MISB's and T-SKID's untuned degree
+                                                    // and distance. LSTM delta mode issues K = 3 of its Max_delta_candidates
+    {4, 2, true},
+    {6, 4, true},
+};
+const int Throttle_num_levels = sizeof(Throttle_levels) / sizeof(Throttle_levels[0]);
+const int Throttle_start_level = 3;
+const uint64_t Throttle_interval = 4096;            // Accesses per interval
+const int Throttle_hysteresis = 2;                  // Intervals in a row that must ask for the same step
+const double Accuracy_high = 0.75;
+const double Accuracy_low = 0.40;
+const double Lateness_high = 0.05;
+const double Occupancy_high = 0.75;                 // MSHR or prefetch queue
+const std::size_t Throttle_tracked_lines = 4096;    // Issued lines followed for lateness (power of two)
+
+class pf_throttle {
+public:
+    // One row of the interval trace
+    struct interval {
+        uint64_t cycle = 0;
+        uint64_t issued = 0;
+        uint64_t throttled = 0;                     // Candidates over the level's degree
+        uint64_t useful = 0;
+        uint64_t late = 0;
+        double mshr_occupancy = 0.0;
+        double pq_occupancy = 0.0;
+        int step = 0;                               // Step asked for, -1, 0 or 1
+        int level = 0;                              // Level after the interval
+    };
+
+    explicit pf_throttle(std::string module_ = "prefetcher") : module(std::move(module_)), tracked(Throttle_tracked_lines) {}
+
+    const pf_aggressiveness& level() const { return Throttle_levels[current_level]; }
+
+    // Every access, before the prefetcher runs. True when the level changed, so the caller hands level() on.
+    bool on_access(CACHE* cache, uint64_t addr, bool cache_hit, bool useful_prefetch) {
+        candidates_this_access = 0;
+        accesses++;
+
+        std::vector<double> pq = cache->get_pq_occupancy_ratio();
+        mshr_sum += std::min(cache->get_mshr_occupancy_ratio(), 1.0);
+        pq_sum += pq.empty() ? 0.0 : std::min(*std::max_element(pq.begin(), pq.end()), 1.0);
+
+        tracked_line& entry = slot(addr);
+        bool is_tracked = entry.line == (addr >> LOG2_BLOCK_SIZE) + 1;
+        if (useful_prefetch) {
+            current.useful++;
+        } else if (!cache_hit && is_tracked && !entry.filled) {
+            current.late++;
+        }
+        if (is_tracked && (useful_prefetch || !cache_hit)) {
+            entry.line = 0;
+        }
+
+        if (accesses % Throttle_interval != 0) {
+            return false;
+        }
+        return end_interval(cache->current_cycle);
+    }
+
+    void on_fill(uint64_t addr, bool prefetch) {
+        tracked_line& entry = slot(addr);
+        if (prefetch && entry.line == (addr >> LOG2_BLOCK_SIZE) + 1) {
+            entry.filled = true;
+        }
+    }
+
+    pf_issue_result issue(pf_issuer& next, uint64_t pf_addr, bool fill_this_level, uint32_t metadata, int confidence) {
+        const pf_aggressiveness& l = level();
+        if (candidates_this_access >= l.degree) {
+            current.throttled++;
+            return pf_issue_result::REFUSED;
+        }
+        pf_issue_result result = next.issue(pf_addr, fill_this_level && l.fill_this_level, metadata, confidence);
+        if (result == pf_issue_result::REFUSED) {
+            return result;
+        }
+        candidates_this_access++;
+        if (result == pf_issue_result::ISSUED) {
+            on_issued(pf_addr);
+        }
+        return result;
+    }
+
+    // A prefetch that went out, at once or when a held candidate was retried
+    void on_issued(uint64_t pf_addr) {
+        current.issued++;
+        slot(pf_addr) = {(pf_addr >> LOG2_BLOCK_SIZE) + 1, false};
+    }
+
+    void report(const std::string& cache_name) const {
+        std::vector<uint64_t> time_at(Throttle_num_levels, 0);
+        uint64_t ups = 0, downs = 0, throttled = 0;
+        int previous = Throttle_start_level;
+        for (const interval& i : intervals) {
+            time_at[i.level]++;
+            ups += i.level > previous;
+            downs += i.level < previous;
+            throttled += i.throttled;
+            previous = i.level;
+        }
+
+        std::cout << "----- " << module << " " << cache_name << " Prefetch Throttle -----\n";
+        std::cout << "Intervals: " << intervals.size() << "\n";
+        std::cout << "Level Ups: " << ups << "\n";
+        std::cout << "Level Downs: " << downs << "\n";
+        std::cout << "Final Level: " << current_level << "\n";
+        std::cout << "Candidates Over Degree: " << throttled << "\n";
+        std::cout << "Intervals At Level:";
+        for (int l = 0; l < Throttle_num_levels; ++l) {
+            std::cout << " " << l << ":" << time_at[l];
+        }
+        std::cout << "\n";
+
+        std::string prefix = std::getenv("PF_STATS_PREFIX") != nullptr ? std::getenv("PF_STATS_PREFIX") : "pf_stats";
+        std::ofstream file(prefix + "_throttle_" + module + "_" + cache_name + ".csv");
+        file << "interval,cycle,issued,throttled,useful,late,accuracy,lateness,mshr_occupancy,pq_occupancy,step,level\n";
+        for (std::size_t n = 0; n < intervals.size(); ++n) {
+            const interval& i = intervals[n];
+            file << n << "," << i.cycle << "," << i.issued << "," << i.throttled << "," << i.useful << "," << i.late << ","
+                 << accuracy(i) << "," << lateness(i) << "," << i.mshr_occupancy << "," << i.pq_occupancy << "," << i.step << ","
+                 << i.level << "\n";
+        }
+    }
+
+    const std::vector<interval>& trace() const { return intervals; }
+
+    std::size_t footprint_bytes() const { return tracked.size() * sizeof(tracked_line) + intervals.capacity() * sizeof(interval); }
+
+private:
+    struct tracked_line {
+        uint64_t line = 0;                          // Line number + 1, 0 is empty
+        bool filled = false;
+    };
+
+    std::string module;
+    std::vector<tracked_line> tracked;
+    std::vector<interval> intervals;
+    interval current;
+    int current_level = Throttle_start_level;
+    int pending_step = 0;
+    int pending_intervals = 0;
+    int candidates_this_access = 0;
+    uint64_t accesses = 0;
+    double mshr_sum = 0.0;
+    double pq_sum = 0.0;
+
+    tracked_line& slot(uint64_t addr) {
+        uint64_t line = addr >> LOG2_BLOCK_SIZE;
+        return tracked[(line ^ (line >> 12)) & (Throttle_tracked_lines - 1)];
+    }
+
+    static double ratio(uint64_t num, uint64_t den) { return den == 0 ? 0.0 : static_cast<double>(num) / static_cast<double>(den); }
+    static double accuracy(const interval& i) { return ratio(i.useful + i.late, i.issued); }
+    static double lateness(const interval& i) { return ratio(i.late, i.useful + i.late); }
+
+    int step_for(const interval& i) const {
+        if (i.issued == 0) {
+            return 0;
+        }
+        double a = accuracy(i);
+        bool late = lateness(i) >= Lateness_high;
+        bool busy = std::max(i.mshr_occupancy, i.pq_occupancy) >= Occupancy_high;
+        if (a >= Accuracy_high) {
+            return late ? 1 : 0;
+        }
+        if (a < Accuracy_low || busy) {
+            return -1;
+        }
+        return late ? 1 : 0;
+    }
+
+    bool end_interval(uint64_t cycle) {
+        current.cycle = cycle;
+        current.mshr_occupancy = mshr_sum / Throttle_interval;
+        current.pq_occupancy = pq_sum / Throttle_interval;
+        current.step = step_for(current);
+
+        pending_intervals = current.step != 0 && current.step == pending_step ? pending_intervals + 1 : 1;
+        pending_step = current.step;
+        int previous = current_level;
+        if (pending_step != 0 && pending_intervals >= Throttle_hysteresis) {
+            current_level = std::min(std::max(current_level + pending_step, 0), Throttle_num_levels - 1);
+            pending_intervals = 0;
+        }
+        current.level = current_level;
+
+        intervals.push_back(current);
+        current = interval();
+        mshr_sum = 0.0;
+        pq_sum = 0.0;
+        return current_level != previous;
+    }
+};
+
+// Issuer that runs a prefetcher's candidates through its throttle first
+class pf_throttle_issuer : public pf_issuer {
+public:
+    pf_throttle_issuer(pf_throttle& throttle_, pf_issuer& next_) : throttle(throttle_), next(next_) {}
+
+    pf_issue_result issue(uint64_t pf_addr, bool fill_this_level, uint32_t metadata, int confidence) override {
+        return throttle.issue(next, pf_addr, fill_this_level, metadata, confidence);
+    }
+
+private:
+    pf_throttle& throttle;
+    pf_issuer& next;
+};
+
+#endif
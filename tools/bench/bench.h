@@ -0,0 +1,399 @@
+#ifndef BENCH_BENCH_H
+#define BENCH_BENCH_H
+
+/*
+Microbenchmark support for the prefetcher metadata structures.
+
+Each bench_<module>.cc is a single translation unit that includes its module's .cc file directly, so the
+structures inside it (including ones in anonymous namespaces) can be driven without the ChampSim hooks. The mock
+CACHE from tools/replay stands in for ChampSim's.
+
+For every case the suite reports:
+  - ns/op over a full pass of the keys
+  - p50 / p99 / p99.9 latency of single operations, from a second, individually timed pass
+  - last level cache misses per op from perf_event_open, or n/a where perf is not allowed
+  - bytes and allocations per op, counted by the operator new replacement below
+
+Keys are generated before timing from one of four distributions over a working set of items: uniform, zipfian
+(s = 0.99), streaming (sequential, wrapping) and pointer chasing (one random cycle through the working set).
+
+Options shared by every bench binary:
+  --ops N            operations per case (default 200000, some cases scale this down)
+  --filter TEXT      only run cases whose name contains TEXT
+  --save FILE        write the results as a JSON baseline
+  --baseline FILE    compare ns/op against a saved baseline, exit 1 on a regression
+  --tolerance X      allowed slowdown before a case counts as a regression (default 0.10)
+
+Since operator new is replaced here, this header must be included by exactly one translation unit per binary.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace bench {
+
+std::atomic<uint64_t> allocated_bytes{0};
+std::atomic<uint64_t> allocation_count{0};
+
+} // namespace bench
+
+// Kept out of line, otherwise GCC inlines malloc/free into new/delete pairs and reports them as mismatched
+__attribute__((noinline)) void* operator new(std::size_t size)
+{
+    bench::allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    bench::allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace bench {
+
+enum class pattern { UNIFORM, ZIPFIAN, STREAMING, POINTER_CHASE };
+
+const pattern all_patterns[] = {pattern::UNIFORM, pattern::ZIPFIAN, pattern::STREAMING, pattern::POINTER_CHASE};
+
+inline const char* pattern_name(pattern p)
+{
+    switch (p) {
+    case pattern::UNIFORM: return "uniform";
+    case pattern::ZIPFIAN: return "zipfian";
+    case pattern::STREAMING: return "streaming";
+    case pattern::POINTER_CHASE: return "pointer_chase";
+    }
+    return "unknown";
+}
+
+// Item indices in [0, working_set) following the distribution, deterministic for a given seed
+inline std::vector<uint64_t> make_keys(pattern p, uint64_t count, uint64_t working_set, uint64_t seed = 1)
+{
+    std::mt19937_64 rng(seed);
+    std::vector<uint64_t> keys(count);
+
+    switch (p) {
+    case pattern::UNIFORM: {
+        std::uniform_int_distribution<uint64_t> pick(0, working_set - 1);
+        for (uint64_t& key : keys) {
+            key = pick(rng);
+        }
+        break;
+    }
+    case pattern::ZIPFIAN: {
+        // Inverse CDF over the ranks, then ranks are scattered so hot items are not neighbours
+        std::vector<double> cdf(working_set);
+        double sum = 0.0;
+        for (uint64_t i = 0; i < working_set; ++i) {
+            sum += 1.0 / std::pow(static_cast<double>(i + 1), 0.99);
+            cdf[i] = sum;
+        }
+        std::vector<uint64_t> scatter(working_set);
+        for (uint64_t i = 0; i < working_set; ++i) {
+            scatter[i] = i;
+        }
+        std::shuffle(scatter.begin(), scatter.end(), rng);
+        std::uniform_real_distribution<double> pick(0.0, sum);
+        for (uint64_t& key : keys) {
+            uint64_t rank = std::lower_bound(cdf.begin(), cdf.end(), pick(rng)) - cdf.begin();
+            key = scatter[std::min(rank, working_set - 1)];
+        }
+        break;
+    }
+    case pattern::STREAMING:
+        for (uint64_t i = 0; i < count; ++i) {
+            keys[i] = i % working_set;
+        }
+        break;
+    case pattern::POINTER_CHASE: {
+        // Sattolo's algorithm gives a single cycle, so the chase visits the whole working set
+        std::vector<uint64_t> next(working_set);
+        for (uint64_t i = 0; i < working_set; ++i) {
+            next[i] = i;
+        }
+        for (uint64_t i = working_set - 1; i > 0; --i) {
+            std::uniform_int_distribution<uint64_t> pick(0, i - 1);
+            std::swap(next[i], next[pick(rng)]);
+        }
+        uint64_t at = 0;
+        for (uint64_t& key : keys) {
+            key = at;
+            at = next[at];
+        }
+        break;
+    }
+    }
+    return keys;
+}
+
+// Last level cache misses of this thread, unavailable when perf_event_paranoid or a container forbids it
+class cache_miss_counter {
+public:
+    cache_miss_counter() {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+    ~cache_miss_counter() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    bool available() const { return fd >= 0; }
+
+    void start() {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    int64_t stop() {
+        if (fd < 0) {
+            return -1;
+        }
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        uint64_t count = 0;
+        return read(fd, &count, sizeof(count)) == sizeof(count) ? static_cast<int64_t>(count) : -1;
+    }
+
+private:
+    int fd = -1;
+};
+
+struct result {
+    std::string name;
+    std::string pattern;
+    uint64_t ops = 0;
+    double ns_per_op = 0.0;
+    double p50_ns = 0.0;
+    double p99_ns = 0.0;
+    double p999_ns = 0.0;
+    double cache_misses_per_op = -1.0;              // Negative when perf is unavailable
+    double bytes_per_op = 0.0;
+    double allocations_per_op = 0.0;
+};
+
+class suite {
+public:
+    suite(std::string module_, int argc, char** argv) : module(std::move(module_)) {
+        for (int i = 1; i < argc; ++i) {
+            std::string option = argv[i];
+            std::string value = i + 1 < argc ? argv[i + 1] : "";
+            if (option == "--ops") {
+                default_ops = std::strtoull(value.c_str(), nullptr, 0);
+            } else if (option == "--filter") {
+                filter = value;
+            } else if (option == "--save") {
+                save_path = value;
+            } else if (option == "--baseline") {
+                baseline_path = value;
+            } else if (option == "--tolerance") {
+                tolerance = std::strtod(value.c_str(), nullptr);
+            } else {
+                std::cerr << "unknown option " << option << "\n";
+                std::exit(1);
+            }
+            ++i;
+        }
+        default_ops = std::max<uint64_t>(default_ops, 1000);
+    }
+
+    uint64_t ops() const { return default_ops; }
+
+    // Runs op once per key. ops of 0 uses the suite default.
+    void run(const std::string& name, pattern p, uint64_t working_set, const std::function<void(uint64_t)>& op, uint64_t ops = 0) {
+        if (!filter.empty() && name.find(filter) == std::string::npos) {
+            return;
+        }
+        uint64_t count = ops == 0 ? default_ops : ops;
+        std::vector<uint64_t> keys = make_keys(p, count, working_set);
+
+        result r;
+        r.name = name;
+        r.pattern = pattern_name(p);
+        r.ops = count;
+
+        // Throughput pass
+        uint64_t bytes_before = allocated_bytes.load();
+        uint64_t allocations_before = allocation_count.load();
+        misses.start();
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t key : keys) {
+            op(key);
+        }
+        auto stop = std::chrono::steady_clock::now();
+        int64_t cache_misses = misses.stop();
+        r.ns_per_op = std::chrono::duration<double, std::nano>(stop - start).count() / count;
+        r.bytes_per_op = static_cast<double>(allocated_bytes.load() - bytes_before) / count;
+        r.allocations_per_op = static_cast<double>(allocation_count.load() - allocations_before) / count;
+        r.cache_misses_per_op = cache_misses < 0 ? -1.0 : static_cast<double>(cache_misses) / count;
+
+        // Latency pass, every operation timed on its own minus the cost of reading the clock
+        uint64_t samples = std::min<uint64_t>(count, 100000);
+        std::vector<double> latencies(samples);
+        for (uint64_t i = 0; i < samples; ++i) {
+            auto before = std::chrono::steady_clock::now();
+            op(keys[i]);
+            auto after = std::chrono::steady_clock::now();
+            latencies[i] = std::max(0.0, std::chrono::duration<double, std::nano>(after - before).count() - timer_overhead);
+        }
+        r.p50_ns = percentile(latencies, 0.50);
+        r.p99_ns = percentile(latencies, 0.99);
+        r.p999_ns = percentile(latencies, 0.999);
+
+        print(r);
+        results.push_back(r);
+    }
+
+    // Writes the baseline and compares against the old one, returns the process exit code
+    int finish() {
+        if (!save_path.empty()) {
+            save(save_path);
+        }
+        if (!baseline_path.empty()) {
+            return compare(baseline_path) ? 0 : 1;
+        }
+        return 0;
+    }
+
+private:
+    std::string module;
+    uint64_t default_ops = 200000;
+    std::string filter;
+    std::string save_path;
+    std::string baseline_path;
+    double tolerance = 0.10;
+    cache_miss_counter misses;
+    double timer_overhead = measure_timer_overhead();
+    std::vector<result> results;
+    bool header_printed = false;
+
+    static double measure_timer_overhead() {
+        double best = 1e9;
+        for (int i = 0; i < 1000; ++i) {
+            auto before = std::chrono::steady_clock::now();
+            auto after = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::nano>(after - before).count());
+        }
+        return best;
+    }
+
+    static double percentile(std::vector<double>& values, double q) {
+        std::size_t at = std::min(values.size() - 1, static_cast<std::size_t>(q * values.size()));
+        std::nth_element(values.begin(), values.begin() + at, values.end());
+        return values[at];
+    }
+
+    void print(const result& r) {
+        if (!header_printed) {
+            std::printf("%-44s %-14s %10s %9s %9s %10s %11s %11s %9s\n", "case", "pattern", "ns/op", "p50", "p99",
+                        "p99.9", "llc miss/op", "bytes/op", "allocs/op");
+            header_printed = true;
+        }
+        char misses_text[32];
+        if (r.cache_misses_per_op < 0) {
+            std::snprintf(misses_text, sizeof(misses_text), "n/a");
+        } else {
+            std::snprintf(misses_text, sizeof(misses_text), "%.3f", r.cache_misses_per_op);
+        }
+        std::printf("%-44s %-14s %10.1f %9.1f %9.1f %10.1f %11s %11.1f %9.3f\n", r.name.c_str(), r.pattern.c_str(), r.ns_per_op,
+                    r.p50_ns, r.p99_ns, r.p999_ns, misses_text, r.bytes_per_op, r.allocations_per_op);
+        std::fflush(stdout);
+    }
+
+    // One result object per line, which keeps compare() a line scanner rather than a JSON parser
+    void save(const std::string& path) const {
+        std::ofstream file(path);
+        file << "{\n  \"module\": \"" << module << "\",\n  \"results\": [\n";
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            const result& r = results[i];
+            file << "    {\"name\": \"" << r.name << "\", \"pattern\": \"" << r.pattern << "\", \"ops\": " << r.ops
+                 << ", \"ns_per_op\": " << r.ns_per_op << ", \"p50_ns\": " << r.p50_ns << ", \"p99_ns\": " << r.p99_ns
+                 << ", \"p999_ns\": " << r.p999_ns << ", \"cache_misses_per_op\": "
+                 << (r.cache_misses_per_op < 0 ? std::string("null") : std::to_string(r.cache_misses_per_op))
+                 << ", \"bytes_per_op\": " << r.bytes_per_op << ", \"allocations_per_op\": " << r.allocations_per_op << "}"
+                 << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        file << "  ]\n}\n";
+        std::cout << "Saved baseline " << path << "\n";
+    }
+
+    static std::string field(const std::string& line, const std::string& key) {
+        std::string marker = "\"" + key + "\": ";
+        std::size_t at = line.find(marker);
+        if (at == std::string::npos) {
+            return "";
+        }
+        at += marker.size();
+        if (line[at] == '"') {
+            return line.substr(at + 1, line.find('"', at + 1) - at - 1);
+        }
+        return line.substr(at, line.find_first_of(",}", at) - at);
+    }
+
+    bool compare(const std::string& path) const {
+        std::ifstream file(path);
+        if (!file) {
+            std::cerr << "cannot read baseline " << path << "\n";
+            return false;
+        }
+        std::map<std::string, double> baseline;
+        std::string line;
+        while (std::getline(file, line)) {
+            std::string name = field(line, "name");
+            if (!name.empty()) {
+                baseline[name + "/" + field(line, "pattern")] = std::strtod(field(line, "ns_per_op").c_str(), nullptr);
+            }
+        }
+
+        bool ok = true;
+        for (const result& r : results) {
+            auto found = baseline.find(r.name + "/" + r.pattern);
+            if (found == baseline.end() || found->second <= 0.0) {
+                continue;
+            }
+            double change = r.ns_per_op / found->second - 1.0;
+            if (change > tolerance) {
+                std::printf("REGRESSION %s/%s: %.1f ns/op vs baseline %.1f (%+.1f%%)\n", r.name.c_str(), r.pattern.c_str(),
+                            r.ns_per_op, found->second, 100.0 * change);
+                ok = false;
+            }
+        }
+        std::cout << (ok ? "No regressions against " : "Regressions against ") << path << "\n";
+        return ok;
+    }
+};
+
+} // namespace bench
+
+#endif
@@ -0,0 +1,87 @@
+// Microbenchmarks for the LSTM feature encoding, prediction memo and native inference, see bench.h for the options
+// Build: g++ -std=c++17 -O2 -pthread -Itools/replay -DLSTM_NATIVE_ONLY -o bench_lstm tools/bench/bench_lstm.cc
+// Inference runs on random weights with the layer sizes in lstm.cc, so only the timing is meaningful.
+
+#include "bench.h"
+#include "../../LSTM/lstm.cc"
+
+namespace {
+
+const uint64_t Line_working_set = 65536;            // Distinct lines fed to the encoder and memo
+const int Input_size = Page_number_size + Page_offset_size + Cycle_delta_size + Type_size;
+
+uint64_t address_of(uint64_t key) { return (uint64_t{1} << 32) + (key << LOG2_BLOCK_SIZE); }
+
+std::shared_ptr<const native_lstm::model> random_model()
+{
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> weight(-0.1f, 0.1f);
+    auto fill = [&](std::vector<float>& values, size_t count) {
+        values.resize(count);
+        for (float& v : values) {
+            v = weight(rng);
+        }
+    };
+
+    auto m = std::make_shared<native_lstm::model>();
+    int inputs = Input_size;
+    for (int l = 0; l < Num_lstm_layers; ++l) {
+        native_lstm::layer layer;
+        layer.inputs = inputs;
+        layer.units = Lstm_units[l];
+        fill(layer.kernel, static_cast<size_t>(inputs) * 4 * layer.units);
+        fill(layer.recurrent, static_cast<size_t>(layer.units) * 4 * layer.units);
+        fill(layer.bias, 4 * layer.units);
+        m->layers.push_back(std::move(layer));
+        inputs = Lstm_units[l];
+    }
+    m->outputs = Page_offset_size;
+    fill(m->dense_kernel, static_cast<size_t>(inputs) * m->outputs);
+    fill(m->dense_bias, m->outputs);
+    return m;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    bench::suite suite("lstm", argc, argv);
+    native_weights = random_model();
+    uint64_t inference_ops = std::max<uint64_t>(suite.ops() / 500, 200);
+
+    lstm_state encoder;
+    for (bench::pattern p : bench::all_patterns) {
+        suite.run("process_input1", p, Line_working_set, [&](uint64_t key) {
+            encoder.cycle += 1 + (key & 63);
+            std::vector<float> input = process_input1(encoder, address_of(key), 0);
+            volatile float first = input[0];
+            (void)first;
+        });
+
+        // Memo lookups as cache_operate does them, inserting on a miss
+        prediction_memo memo;
+        std::vector<float> prev_input = process_input1(encoder, address_of(0), 0);
+        suite.run("process_input1 + prediction_memo find/insert", p, Line_working_set, [&](uint64_t key) {
+            std::vector<float> curr_input = process_input1(encoder, address_of(key), 0);
+            uint64_t prev_packed = pack_input(prev_input);
+            uint64_t curr_packed = pack_input(curr_input);
+            if (memo.find(prev_packed, curr_packed) == nullptr) {
+                memo.insert(prev_packed, curr_packed, lstm_prediction());
+            }
+            prev_input = std::move(curr_input);
+        });
+    }
+
+    // Inference cost does not depend on the key distribution
+    std::vector<float> output;
+    lstm_state state;
+    suite.run("run_native_windowed", bench::pattern::UNIFORM, Line_working_set, [&](uint64_t key) {
+        run_native_windowed(*native_weights, state, process_input1(state, address_of(key), 0), output);
+    }, inference_ops);
+
+    suite.run("run_native_stateful", bench::pattern::UNIFORM, Line_working_set, [&](uint64_t key) {
+        run_native_stateful(*native_weights, state, process_input1(state, address_of(key), 0), output);
+    }, inference_ops);
+
+    return suite.finish();
+}
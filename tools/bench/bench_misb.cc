@@ -0,0 +1,38 @@
+// Microbenchmarks for the MISB PS/SP caches and Bloom filter, see bench.h for the options
+// Build: g++ -std=c++17 -O2 -pthread -Itools/replay -o bench_misb tools/bench/bench_misb.cc
+
+#include "bench.h"
+#include "../../MISB/misb.h"
+
+namespace {
+
+const uint64_t Line_working_set = 16384;            // Distinct lines, 16x the 128 x 8 entries of the on-chip caches
+
+uint64_t address_of(uint64_t key) { return (uint64_t{1} << 32) + (key << LOG2_BLOCK_SIZE); }
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    bench::suite suite("misb", argc, argv);
+
+    for (bench::pattern p : bench::all_patterns) {
+        misb::MISBPrefetcher::ps_cache_type ps_cache;
+        suite.run("CompressedCache::write", p, Line_working_set, [&](uint64_t key) {
+            uint64_t line = address_of(key) >> LOG2_BLOCK_SIZE;
+            ps_cache.write(line, line);
+        });
+        suite.run("CompressedCache::read", p, Line_working_set, [&](uint64_t key) {
+            volatile uint64_t structural = ps_cache.read(address_of(key) >> LOG2_BLOCK_SIZE);
+            (void)structural;
+        });
+
+        misb::MISBPrefetcher::bloom_filter_type filter;
+        suite.run("BloomFilter::add", p, Line_working_set, [&](uint64_t key) { filter.add(address_of(key)); });
+        suite.run("BloomFilter::contains", p, Line_working_set, [&](uint64_t key) {
+            volatile bool found = filter.contains(address_of(key));
+            (void)found;
+        });
+    }
+    return suite.finish();
+}
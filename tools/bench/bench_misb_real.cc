@@ -0,0 +1,38 @@
+// Microbenchmarks for the misb_real PS/SP caches, see bench.h for the options
+// The default backing store is several GB, so the benchmark builds with a smaller one:
+// Build: g++ -std=c++17 -O2 -pthread -Itools/replay -DMISB_REAL_DRAM_SIZE=4194304 -o bench_misb_real tools/bench/bench_misb_real.cc
+
+#include "bench.h"
+#include "../../MISB/misb_real.cc"
+
+namespace {
+
+const uint64_t Line_working_set = 16384;            // Distinct lines, must stay inside the backing store
+
+uint64_t address_of(uint64_t key) { return key << LOG2_BLOCK_SIZE; }
+
+static_assert((Line_working_set << LOG2_BLOCK_SIZE) <= dramSize, "benchmark addresses index the backing store");
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    bench::suite suite("misb_real", argc, argv);
+
+    for (bench::pattern p : bench::all_patterns) {
+        // Same geometry as the module's PS_cache and SP_cache
+        metadata_cache ps_cache(dram);
+        metadata_cache sp_cache(dram);
+
+        suite.run("cache_specialized::write", p, Line_working_set, [&](uint64_t key) {
+            uint64_t addr = address_of(key);
+            ps_cache.write(entry<uint64_t>(addr, addr >> LOG2_BLOCK_SIZE), addr);
+        });
+        suite.run("cache_specialized::read", p, Line_working_set, [&](uint64_t key) {
+            uint64_t addr = address_of(key);
+            volatile uint64_t next = ps_cache.read(addr, sp_cache, true, addr >> LOG2_BLOCK_SIZE);
+            (void)next;
+        });
+    }
+    return suite.finish();
+}
@@ -0,0 +1,38 @@
+// Microbenchmarks for the TCP Tag History Table and Pattern History Table, see bench.h for the options
+// Build: g++ -std=c++17 -O2 -pthread -Itools/replay -o bench_tcp tools/bench/bench_tcp.cc
+
+#include "bench.h"
+#include "../../TCP/tcp.h"
+
+namespace {
+
+const uint64_t Tag_working_set = 4096;              // Distinct miss tags
+
+// Tag 0 marks an empty entry, so keys start at 1. Consecutive keys fall in consecutive L1D sets, as lines do.
+uint64_t tag_of(uint64_t key) { return key / tcp::sets_L1D + 1; }
+std::size_t set_of(uint64_t key) { return key % tcp::sets_L1D; }
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    bench::suite suite("tcp", argc, argv);
+
+    for (bench::pattern p : bench::all_patterns) {
+        tcp::TagCorrelatingPrefetcher::HistoryTable tht;
+        suite.run("TagHistoryTable::update", p, Tag_working_set, [&](uint64_t key) {
+            tht.update(set_of(key), tag_of(key));
+        });
+
+        // The PHT links each miss tag to the one before it in the same set, as the prefetcher does
+        tcp::TagCorrelatingPrefetcher::PatternTable pht;
+        suite.run("PatternHistoryTable::update", p, Tag_working_set, [&](uint64_t key) {
+            pht.update(set_of(key), tht.lastTag(set_of(key)), tag_of(key));
+        });
+        suite.run("PatternHistoryTable::lookUp", p, Tag_working_set, [&](uint64_t key) {
+            volatile uint64_t next = pht.lookUp(set_of(key), tag_of(key));
+            (void)next;
+        });
+    }
+    return suite.finish();
+}
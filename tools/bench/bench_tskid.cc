@@ -0,0 +1,44 @@
+// Microbenchmarks for the T-SKID tracker tables, see bench.h for the options
+// Build: g++ -std=c++17 -O2 -pthread -Itools/replay -o bench_tskid tools/bench/bench_tskid.cc
+// The lru_table measured is the stand-in from tools/replay/msl, not ChampSim's.
+
+#include "bench.h"
+#include "../../T_SKID/t_skid.h"
+
+namespace {
+
+const uint64_t Pc_working_set = 2048;               // Distinct PCs, 2x the 256 x 4 IP tracker
+
+uint64_t pc_of(uint64_t key) { return 0x400000 + (key << 2); }
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    bench::suite suite("t_skid", argc, argv);
+    CACHE cache("L2C", replay_config());
+    pf_cache_issuer issuer(&cache);
+
+    for (bench::pattern p : bench::all_patterns) {
+        t_skid::tracker t;
+        suite.run("lru_table::fill", p, Pc_working_set, [&](uint64_t key) { t.table.fill({pc_of(key), key, 1}); });
+        suite.run("lru_table::check_hit", p, Pc_working_set, [&](uint64_t key) {
+            volatile bool hit = t.table.check_hit({pc_of(key), 0, 0}).has_value();
+            (void)hit;
+        });
+
+        suite.run("target_table fill", p, Pc_working_set, [&](uint64_t key) { t.target_table.fill({pc_of(key + 1), pc_of(key)}); });
+        suite.run("addr_pred_table check_hit", p, Pc_working_set, [&](uint64_t key) {
+            volatile bool found = t.addr_pred_table.check_hit(t_skid::tracker::addr_pred_table_entry::key(pc_of(key))).has_value();
+            (void)found;
+        });
+
+        // Whole training path of prefetcher_cache_operate, strided lines per PC
+        t_skid::tracker trained;
+        uint64_t step = 0;
+        suite.run("tracker::initiate_lookahead", p, Pc_working_set, [&](uint64_t key) {
+            trained.initiate_lookahead(pc_of(key), (key << 20) + 2 * (step++ / Pc_working_set), &cache, issuer);
+        });
+    }
+    return suite.finish();
+}
@@ -0,0 +1,165 @@
+#!/usr/bin/env python3
+# Generates common/pf_geometry.h, the table geometry every prefetcher is compiled with, from a ChampSim
+# champsim_config.json. The simulated system (cache sets and ways, DRAM organization) comes from the ChampSim
+# config; the prefetcher tables use the defaults below unless the config has a "prefetcher_geometry" object with
+# the same keys, e.g. "prefetcher_geometry": {"misb": {"ps_sets": 256}}.
+#
+# Usage: python3 tools/gen_pf_geometry.py champsim_config.json > common/pf_geometry.h
+#        python3 tools/gen_pf_geometry.py > common/pf_geometry.h          (ChampSim's default config)
+
+import json
+import sys
+
+# ChampSim's default champsim_config.json, for whatever the given config leaves out
+SYSTEM_DEFAULTS = {
+    'block_size': 64,
+    'page_size': 4096,
+    'L1D': {'sets': 64, 'ways': 12},
+    'L2C': {'sets': 1024, 'ways': 8},
+    'LLC': {'sets': 2048, 'ways': 16},
+    'physical_memory': {'channels': 1, 'ranks': 1, 'banks': 8, 'rows': 65536, 'columns': 128},
+}
+
+# Prefetcher tables: (name in the header, default, comment)
+PREFETCHER_DEFAULTS = {
+    'tcp': [
+        ('Tcp_tht_entries_per_row', 'tht_entries_per_row', 12, 'Tags kept in each THT row'),
+        ('Tcp_pht_ways', 'pht_ways', 12, 'PHT ways per L1D set'),
+        ('Tcp_storage_budget_bits', 'storage_budget_bits', 16 * 1024 * 8, 'THT + PHT'),
+    ],
+    'misb': [
+        ('Misb_ps_sets', 'ps_sets', 128, ''),
+        ('Misb_ps_ways', 'ps_ways', 8, ''),
+        ('Misb_sp_sets', 'sp_sets', 128, ''),
+        ('Misb_sp_ways', 'sp_ways', 8, ''),
+        ('Misb_bloom_bits', 'bloom_bits', 17 * 1024 * 8, ''),
+        ('Misb_run_length', 'run_length', 4, 'Consecutive PS/SP keys one entry maps'),
+        ('Misb_tag_bits', 'tag_bits', 16, 'Partial run tag of a PS/SP entry'),
+        ('Misb_delta_bits', 'delta_bits', 8, 'Signed delta of each mapping in a run, in lines'),
+        ('Misb_structural_address_bits', 'structural_address_bits', 32, 'Structural address field of a PS/SP entry'),
+        ('Misb_stream_chunk', 'stream_chunk', 256, 'Structural addresses a new PC stream is given'),
+        ('Misb_training_entries', 'training_entries', 64, 'PCs whose last structural address the training unit keeps'),
+        ('Misb_lookahead_distance', 'lookahead_distance', 4, 'Structural addresses between an SP hit and its metadata lookahead'),
+        ('Misb_lookahead_keys', 'lookahead_keys', 8, 'Structural addresses a lookahead covers, 0 turns it off'),
+        ('Misb_metadata_line_keys', 'metadata_line_keys', 8, 'Mappings per off-chip metadata line'),
+        ('Misb_fetch_filter_size', 'fetch_filter_size', 64, 'Recent metadata line reads remembered (power of two)'),
+        ('Misb_llc_metadata_sets', 'llc_metadata_sets', 256, 'Metadata lines cached in the LLC when cores share MISB metadata'),
+        ('Misb_llc_metadata_ways', 'llc_metadata_ways', 16, ''),
+        ('Misb_partition_epoch', 'partition_epoch', 8192, 'LLC metadata accesses between utility repartitions'),
+        ('Misb_storage_budget_bytes', 'storage_budget_bytes', 96 * 1024, 'PS + SP caches + bloom filter'),
+    ],
+    'misb_real': [
+        ('Misb_real_sets', 'sets', 128, 'PS and SP cache sets'),
+        ('Misb_real_ways', 'ways', 8, 'PS and SP cache ways'),
+        ('Misb_real_bloom_bits', 'bloom_bits', 17 * 1024 * 8, ''),
+    ],
+    't_skid': [
+        ('T_skid_tracker_sets', 'tracker_sets', 256, 'IP tracker'),
+        ('T_skid_tracker_ways', 'tracker_ways', 4, ''),
+        ('T_skid_target_table_sets', 'target_table_sets', 64, 'Trigger PC to target PC'),
+        ('T_skid_target_table_ways', 'target_table_ways', 4, ''),
+        ('T_skid_addr_pred_table_sets', 'addr_pred_table_sets', 64, 'Last address and stride of each target PC'),
+        ('T_skid_addr_pred_table_ways', 'addr_pred_table_ways', 4, ''),
+        ('T_skid_ipt_size', 'ipt_size', 16, 'In flight prefetches'),
+        ('T_skid_rrpcq_size', 'rrpcq_size', 16, 'Recent request PC queue'),
+        ('T_skid_prefetch_degree', 'prefetch_degree', 3, ''),
+        ('T_skid_stride_bits', 'stride_bits', 16, 'Signed stride field, in lines'),
+        ('T_skid_pc_tag_bits', 'pc_tag_bits', 16, 'Partial PC tag kept in every table'),
+        ('T_skid_storage_budget_bytes', 'storage_budget_bytes', 48 * 1024, 'All tables'),
+    ],
+}
+
+
+def log2(n, what):
+    if n <= 0 or n & (n - 1):
+        raise ValueError(f"{what} must be a power of two, got {n}")
+    return n.bit_length() - 1
+
+
+# A cache's sets and ways, from a top level object or from the "caches" list of newer configs
+def cache_geometry(config, name):
+    geometry = dict(SYSTEM_DEFAULTS[name])
+    found = config.get(name)
+    if not isinstance(found, dict):
+        found = next((c for c in config.get('caches', []) if isinstance(c, dict) and c.get('name', '').endswith(name)), {})
+    geometry.update({k: found[k] for k in ('sets', 'ways') if k in found})
+    return geometry
+
+
+def main():
+    config = {}
+    if len(sys.argv) > 2:
+        sys.exit(f"usage: {sys.argv[0]} [champsim_config.json] > common/pf_geometry.h")
+    if len(sys.argv) == 2:
+        with open(sys.argv[1]) as f:
+            config = json.load(f)
+
+    block_size = config.get('block_size', SYSTEM_DEFAULTS['block_size'])
+    page_size = config.get('page_size', SYSTEM_DEFAULTS['page_size'])
+    memory = dict(SYSTEM_DEFAULTS['physical_memory'])
+    memory.update({k: v for k, v in config.get('physical_memory', {}).items() if k in memory})
+    caches = {name: cache_geometry(config, name) for name in ('L1D', 'L2C', 'LLC')}
+
+    # Every line of DRAM has an address, so the physical address is as wide as the DRAM is large
+    address_bits = log2(block_size, 'block_size')
+    for key in ('channels', 'ranks', 'banks', 'rows', 'columns'):
+        address_bits += log2(memory[key], f"physical_memory.{key}")
+    for name, geometry in caches.items():
+        log2(geometry['sets'], f"{name} sets")
+
+    overrides = config.get('prefetcher_geometry', {})
+    source = sys.argv[1] if len(sys.argv) == 2 else "ChampSim's default configuration"
+
+    out = []
+    out.append('#ifndef COMMON_PF_GEOMETRY_H')
+    out.append('#define COMMON_PF_GEOMETRY_H')
+    out.append('')
+    out.append(f'// Generated by tools/gen_pf_geometry.py from {source}, regenerate rather than edit.')
+    out.append('// Table geometry every prefetcher is compiled with. The tables take these as template arguments, so')
+    out.append('// power of two sets and ways become shifts and masks and way loops have a constant trip count.')
+    out.append('')
+    out.append('#include <cstddef>')
+    out.append('')
+    out.append('// Simulated system')
+    rows = [
+        ('Block_size', block_size, ''),
+        ('Page_size', page_size, ''),
+        ('Physical_address_bits', address_bits, 'log2 of the DRAM size'),
+    ]
+    for name, geometry in caches.items():
+        rows.append((f'{name}_sets', geometry['sets'], ''))
+        rows.append((f'{name}_ways', geometry['ways'], ''))
+    rows += [
+        ('Dram_channels', memory['channels'], ''),
+        ('Dram_ranks', memory['ranks'], ''),
+        ('Dram_banks', memory['banks'], ''),
+        ('Dram_rows', memory['rows'], ''),
+        ('Dram_columns', memory['columns'], 'Lines per row in one bank'),
+    ]
+    out += format_rows(rows)
+
+    for module, entries in PREFETCHER_DEFAULTS.items():
+        module_overrides = overrides.get(module, {})
+        unknown = set(module_overrides) - {key for _, key, _, _ in entries}
+        if unknown:
+            sys.exit(f"unknown prefetcher_geometry.{module} keys: {', '.join(sorted(unknown))}")
+        out.append('')
+        out.append(f'// {module}')
+        out += format_rows([(name, module_overrides.get(key, default), comment) for name, key, default, comment in entries])
+
+    out.append('')
+    out.append('#endif')
+    print('\n'.join(out))
+
+
+def format_rows(rows):
+    width = max(len(f'constexpr std::size_t {name} = {value};') for name, value, _ in rows)
+    lines = []
+    for name, value, comment in rows:
+        line = f'constexpr std::size_t {name} = {value};'
+        lines.append(f'{line:<{width}}   // {comment}' if comment else line)
+    return lines
+
+
+if __name__ == '__main__':
+    main()
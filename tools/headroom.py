@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+# Reports each prefetcher's coverage and IPC as a fraction of the oracle prefetcher's (ORACLE/oracle.cc), run on the
+# same trace. Every argument is the output of one run, a ChampSim log or a tools/replay report.
+#
+# Coverage is the one from the first "<module> <cache> Prefetch Quality (ROI)" block (common/pf_stats.h), so every
+# module is measured the same way. IPC is ChampSim's "CPU n cumulative IPC" of the region of interest, the mean over
+# the CPUs. A replay report has no IPC, its demand latency speedup (baseline / modeled mean demand latency) stands in.
+# With --baseline, a run without a prefetcher, the share of the oracle's IPC gain each prefetcher gets is reported
+# too; a replay report is its own baseline.
+#
+# Usage: python3 tools/headroom.py [--cache L2C] [--baseline no_prefetch.log] oracle.log tcp.log misb.log ...
+
+import argparse
+import re
+import sys
+
+IPC = re.compile(r'^CPU (\d+) cumulative IPC: ([0-9.eE+-]+)')
+QUALITY = re.compile(r'^----- (\S+) (\S+) Prefetch Quality \(ROI\) -----')
+VALUE = re.compile(r'^([A-Za-z ]+): ([0-9.eE+-]+)$')
+
+
+def parse(path, cache):
+    module, coverage, ipc, values = None, None, {}, {}
+    in_quality = False
+    with open(path) as log:
+        for line in log:
+            line = line.rstrip('\n')
+            match = IPC.match(line)
+            if match:
+                ipc[int(match.group(1))] = float(match.group(2))  # the last one is the region of interest
+                continue
+            match = QUALITY.match(line)
+            if match:
+                in_quality = module is None and match.group(2) == cache
+                if in_quality:
+                    module = match.group(1)
+                continue
+            if line.startswith('-----'):
+                in_quality = False
+                continue
+            match = VALUE.match(line)
+            if match:
+                if in_quality and match.group(1) == 'Coverage':
+                    coverage = float(match.group(2))
+                values.setdefault(match.group(1), float(match.group(2)))
+
+    if ipc:
+        performance, baseline = sum(ipc.values()) / len(ipc), None
+    elif values.get('Modeled Mean Demand Latency'):
+        performance, baseline = values['Baseline Mean Demand Latency'] / values['Modeled Mean Demand Latency'], 1.0
+    else:
+        performance, baseline = None, None
+    return {'name': module or path, 'coverage': coverage, 'performance': performance, 'baseline': baseline, 'ipc': bool(ipc)}
+
+
+def fraction(value, oracle):
+    if value is None or not oracle:
+        return '-'
+    return '%.3f' % (value / oracle)
+
+
+def number(value):
+    return '-' if value is None else '%.4f' % value
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Prefetcher coverage and IPC as a fraction of the oracle')
+    parser.add_argument('--cache', default='L2C', help='cache whose prefetch quality is compared (default L2C)')
+    parser.add_argument('--baseline', help='run without a prefetcher, for the share of the oracle IPC gain')
+    parser.add_argument('oracle', help='run of the oracle prefetcher')
+    parser.add_argument('runs', nargs='+', help='runs of the real prefetchers')
+    args = parser.parse_args()
+
+    oracle = parse(args.oracle, args.cache)
+    runs = [parse(path, args.cache) for path in args.runs]
+    if oracle['coverage'] is None:
+        sys.exit('%s has no %s prefetch quality report' % (args.oracle, args.cache))
+    baseline = oracle['baseline']
+    if args.baseline:
+        baseline = parse(args.baseline, args.cache)['performance']
+
+    metric = 'IPC' if oracle['ipc'] else 'Latency Speedup'
+    print('Oracle: %s, coverage %s, %s %s' % (oracle['name'], number(oracle['coverage']), metric, number(oracle['performance'])))
+    print('Prefetcher | Coverage | Of Oracle | %s | Of Oracle | Of Oracle Gain' % metric)
+    for run in runs:
+        gain = '-'
+        if baseline is not None and run['performance'] is not None and oracle['performance'] != baseline:
+            gain = '%.3f' % ((run['performance'] - baseline) / (oracle['performance'] - baseline))
+        print('%s | %s | %s | %s | %s | %s' % (run['name'], number(run['coverage']), fraction(run['coverage'], oracle['coverage']),
+                                               number(run['performance']), fraction(run['performance'], oracle['performance']), gain))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,104 @@
+/*
+Streaming converter from ChampSim L2 text logs (*_l2clog.txt, optionally .xz) to the packed trace format in
+common/l2_trace.h.
+
+Only PREFETCH_TRAIN lines are converted, the same lines LSTM/Preprocess.py reads:
+  PREFETCH_TRAIN <addr> <ip> <hit> <type> <cycle>
+Lines with fewer than six fields are skipped, as Preprocess.py skips them, and fields are read as decimal the way its
+int() reads them.
+
+The input is read line by line, so memory use does not depend on the size of the log. Files ending in .xz are
+decompressed through "xz -dc".
+
+Build:  g++ -std=c++17 -O2 -pthread -o l2clog_to_trace tools/l2clog_to_trace.cc
+Usage:  l2clog_to_trace <input log> <output trace>
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../common/l2_trace.h"
+
+namespace {
+
+bool ends_with(const std::string& text, const std::string& suffix)
+{
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Splits a line on whitespace in place, returning pointers to the fields
+std::size_t split_fields(char* line, char** fields, std::size_t max_fields)
+{
+    std::size_t count = 0;
+    char* save = nullptr;
+    for (char* token = strtok_r(line, " \t\r\n", &save); token != nullptr && count < max_fields; token = strtok_r(nullptr, " \t\r\n", &save)) {
+        fields[count++] = token;
+    }
+    return count;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc != 3) {
+        std::cerr << "usage: " << argv[0] << " <input log[.xz]> <output trace>\n";
+        return 1;
+    }
+    const std::string input_path = argv[1];
+    const std::string output_path = argv[2];
+
+    bool compressed = ends_with(input_path, ".xz");
+    std::FILE* input = compressed ? popen(("xz -dc '" + input_path + "'").c_str(), "r") : std::fopen(input_path.c_str(), "r");
+    if (input == nullptr) {
+        std::cerr << "cannot open " << input_path << "\n";
+        return 1;
+    }
+
+    l2_trace_writer writer;
+    if (!writer.open(output_path)) {
+        std::cerr << "cannot create " << output_path << "\n";
+        return 1;
+    }
+
+    char* line = nullptr;
+    std::size_t capacity = 0;
+    uint64_t lines = 0;
+    uint64_t skipped = 0;
+    constexpr std::size_t MAX_FIELDS = 16;
+    char* fields[MAX_FIELDS];
+
+    while (getline(&line, &capacity, input) != -1) {
+        lines++;
+        if (std::strncmp(line, "PREFETCH_TRAIN", 14) != 0) {
+            continue;
+        }
+        std::size_t count = split_fields(line, fields, MAX_FIELDS);
+        if (count < 6) {
+            skipped++;
+            continue;
+        }
+
+        uint64_t addr = std::strtoull(fields[1], nullptr, 10);
+        uint64_t ip = std::strtoull(fields[2], nullptr, 10);
+        bool hit = std::strtoull(fields[3], nullptr, 10) != 0;
+        uint8_t type = static_cast<uint8_t>(std::strtoul(fields[count - 2], nullptr, 10));
+        uint64_t cycle = std::strtoull(fields[count - 1], nullptr, 10);
+        writer.append(addr, ip, cycle, type, hit);
+    }
+
+    std::free(line);
+    if (compressed) {
+        pclose(input);
+    } else {
+        std::fclose(input);
+    }
+    writer.close();
+
+    std::cout << "lines: " << lines << ", records: " << writer.records() << ", malformed: " << skipped << "\n";
+    return 0;
+}
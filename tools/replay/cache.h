@@ -0,0 +1,292 @@
+#ifndef REPLAY_CACHE_H
+#define REPLAY_CACHE_H
+
+/*
+Mock of the ChampSim CACHE for tools/replay.
+
+The prefetcher modules include "cache.h" and "msl/lru_table.h". Building them with -Itools/replay picks up this
+header instead of ChampSim's, so a module compiles unchanged against the members it actually uses:
+prefetch_line, get_mshr_occupancy_ratio, get_pq_occupancy_ratio, MSHR, current_cycle, warmup,
+get_inflight_tag_check, NUM_SET, NUM_WAY, NAME and cpu.
+
+Behind those members is a small timing model of one cache level:
+  - every replayed access sits in the tag check queue for hit_latency cycles, and until its address translation
+    returns translation_latency cycles after it arrived. ChampSim's L2 gets physical addresses, so the default of 0
+    has every entry translated from the start; a larger value models an L1D, where an access waits for the DTLB
+    with is_translated false. Only the queue sees the translation, the demand latency does not change
+  - a demand miss holds an MSHR entry for miss_latency cycles and then fills (prefetcher_cache_fill, prefetch = 0)
+  - a prefetch holds an MSHR entry until it is ready, then fills into a fully associative LRU prefetch buffer of
+    prefetch_buffer_lines lines (prefetch = 1). With fill_this_level false it is only tracked, and a demand for it
+    costs lower_latency instead of miss_latency
+  - prefetch_line fails when the MSHR is full
+A recorded miss that finds its line ready in the buffer becomes a hit caused by the prefetcher, one that finds it
+still in flight waits for the rest of the fill instead of a full miss.
+*/
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+constexpr unsigned LOG2_BLOCK_SIZE = 6;
+constexpr unsigned BLOCK_SIZE = 1 << LOG2_BLOCK_SIZE;
+constexpr unsigned LOG2_PAGE_SIZE = 12;
+constexpr unsigned PAGE_SIZE = 1 << LOG2_PAGE_SIZE;
+
+enum class access_type : uint8_t { LOAD = 0, RFO, PREFETCH, WRITE, TRANSLATION, NUM_TYPES };
+
+namespace champsim {
+class operable {
+public:
+    uint64_t current_cycle = 0;
+    bool warmup = false;
+};
+} // namespace champsim
+
+struct replay_config {
+    uint32_t sets = 1024;                       // ChampSim default L2C geometry
+    uint32_t ways = 8;
+    uint64_t hit_latency = 10;                  // Cycles for a hit, also the time an access spends in tag check
+    uint64_t translation_latency = 0;           // Cycles until a tag check entry is translated, 0 as in ChampSim's L2
+    uint64_t miss_latency = 200;                // Cycles for a demand miss served below this level
+    uint64_t lower_latency = 40;                // Cycles for a miss on a line prefetched into the next level
+    std::size_t mshr_size = 32;
+    std::size_t prefetch_buffer_lines = 1024;   // Capacity for prefetched lines not yet used by a demand
+};
+
+struct replay_stats {
+    uint64_t accesses = 0;
+    uint64_t recorded_misses = 0;
+    uint64_t prefetch_requests = 0;             // Calls to prefetch_line
+    uint64_t prefetches_issued = 0;             // Accepted and filled into this level
+    uint64_t prefetches_lower = 0;              // Accepted with fill_this_level false
+    uint64_t prefetches_dropped = 0;            // Rejected because the MSHR was full
+    uint64_t prefetches_duplicate = 0;          // Line already prefetched or in flight
+    uint64_t timely_hits = 0;                   // Recorded misses turned into hits
+    uint64_t late_hits = 0;                     // Recorded misses that waited on an in flight prefetch
+    uint64_t lower_hits = 0;                    // Recorded misses served by a prefetch into the next level
+    uint64_t already_cached = 0;                // Prefetched lines first touched by a recorded hit
+    uint64_t useless = 0;                       // Prefetched lines evicted or left without a demand
+    uint64_t baseline_latency = 0;              // Sum of demand latencies without the prefetcher
+    uint64_t modeled_latency = 0;               // Sum of demand latencies with the prefetcher
+};
+
+class CACHE : public champsim::operable {
+public:
+    struct tag_lookup_type {
+        uint64_t address = 0;
+        uint64_t v_address = 0;
+        uint64_t ip = 0;
+        access_type type = access_type::LOAD;
+        bool is_translated = true;              // From translated_cycle on
+        uint64_t event_cycle = 0;
+        uint64_t translated_cycle = 0;          // Mock only, when the translation returns
+    };
+
+    struct mshr_type {
+        uint64_t address = 0;
+        uint64_t v_address = 0;
+        uint64_t ip = 0;
+        access_type type = access_type::LOAD;
+        uint64_t event_cycle = 0;               // Cycle the fill completes
+    };
+
+    const uint32_t cpu = 0;
+    const std::string NAME;
+    const uint32_t NUM_SET;
+    const uint32_t NUM_WAY;
+    std::deque<mshr_type> MSHR;
+
+    replay_stats stats;
+
+    CACHE(std::string name, const replay_config& config_)
+        : NAME(std::move(name)), NUM_SET(config_.sets), NUM_WAY(config_.ways), config(config_) {}
+
+    // ChampSim interface used by the modules //
+
+    bool prefetch_line(uint64_t pf_addr, bool fill_this_level, uint32_t prefetch_metadata) {
+        stats.prefetch_requests++;
+        uint64_t line = pf_addr >> LOG2_BLOCK_SIZE;
+        if (prefetched.count(line) != 0) {
+            stats.prefetches_duplicate++;
+            return true;
+        }
+        if (MSHR.size() >= config.mshr_size) {
+            stats.prefetches_dropped++;
+            return false;
+        }
+
+        uint64_t ready = current_cycle + config.miss_latency;
+        if (fill_this_level) {
+            stats.prefetches_issued++;
+            MSHR.push_back({line << LOG2_BLOCK_SIZE, 0, 0, access_type::PREFETCH, ready});
+            fills.push({ready, line << LOG2_BLOCK_SIZE, true, prefetch_metadata});
+        } else {
+            stats.prefetches_lower++;
+        }
+        insert_prefetched(line, {ready, !fill_this_level, {}});
+        return true;
+    }
+
+    double get_mshr_occupancy_ratio() const { return static_cast<double>(MSHR.size()) / static_cast<double>(config.mshr_size); }
+    std::vector<double> get_pq_occupancy_ratio() const { return {0.0}; }
+    const std::deque<tag_lookup_type>& get_inflight_tag_check() const { return inflight_tag_check; }
+
+    void prefetcher_initialize();
+    uint32_t prefetcher_cache_operate(uint64_t addr, uint64_t ip, uint8_t cache_hit, bool useful_prefetch, uint8_t type, uint32_t metadata_in);
+    uint32_t prefetcher_cache_fill(uint64_t addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_addr, uint32_t metadata_in);
+    void prefetcher_cycle_operate();
+    void prefetcher_final_stats();
+
+    // Replay side //
+
+    // Runs every cycle up to and including cycle. With max_idle_cycles set, longer gaps skip ahead and only tick the
+    // last max_idle_cycles of them; pending fills are still delivered in order.
+    void advance_to(uint64_t cycle, uint64_t max_idle_cycles) {
+        if (max_idle_cycles != 0 && cycle > current_cycle + max_idle_cycles) {
+            uint64_t skip_to = cycle - max_idle_cycles;
+            while (!fills.empty() && fills.top().cycle <= skip_to) {
+                current_cycle = fills.top().cycle;
+                deliver_fill();
+            }
+            current_cycle = skip_to;
+            translate();
+            retire();
+        }
+        while (current_cycle < cycle) {
+            current_cycle++;
+            while (!fills.empty() && fills.top().cycle <= current_cycle) {
+                deliver_fill();
+            }
+            translate();
+            prefetcher_cycle_operate();
+            retire();
+        }
+    }
+
+    // Replays one access at current_cycle. With feedback, recorded misses the prefetcher covered are passed to the
+    // module as hits, as the real cache would; without it the module sees the recorded hit flag.
+    void replay_access(uint64_t addr, uint64_t ip, uint8_t type, bool recorded_hit, bool feedback) {
+        uint64_t line = addr >> LOG2_BLOCK_SIZE;
+        stats.accesses++;
+        inflight_tag_check.push_back({addr, addr, ip, static_cast<access_type>(type), config.translation_latency == 0,
+                                      current_cycle + config.hit_latency, current_cycle + config.translation_latency});
+
+        bool hit = recorded_hit;
+        bool useful = false;
+        bool merged = false;                    // Demand joined an in flight prefetch, no fill of its own
+        uint64_t latency = recorded_hit ? config.hit_latency : config.miss_latency;
+        stats.baseline_latency += latency;
+
+        auto found = prefetched.find(line);
+        if (found != prefetched.end()) {
+            prefetched_line entry = found->second;
+            lru.erase(entry.position);
+            prefetched.erase(found);
+            if (recorded_hit) {
+                stats.already_cached++;
+            } else if (entry.lower_level) {
+                stats.lower_hits++;
+                latency = std::max(config.lower_latency, entry.ready_cycle > current_cycle ? entry.ready_cycle - current_cycle : 0);
+            } else if (entry.ready_cycle <= current_cycle) {
+                stats.timely_hits++;
+                latency = config.hit_latency;
+                hit = true;
+                useful = true;
+            } else {
+                stats.late_hits++;
+                merged = true;
+                latency = std::max(config.hit_latency, entry.ready_cycle - current_cycle);
+            }
+        }
+        stats.modeled_latency += latency;
+        if (!recorded_hit) {
+            stats.recorded_misses++;
+        }
+
+        bool seen_hit = feedback ? hit : recorded_hit;
+        prefetcher_cache_operate(addr, ip, seen_hit, feedback && useful, type, 0);
+
+        // A miss the prefetcher did not already cover brings the line in itself
+        if (!hit && !merged) {
+            uint64_t ready = current_cycle + latency;
+            MSHR.push_back({line << LOG2_BLOCK_SIZE, addr, ip, static_cast<access_type>(type), ready});
+            fills.push({ready, line << LOG2_BLOCK_SIZE, false, 0});
+        }
+    }
+
+    // Prefetched lines never touched by a demand count as useless
+    void finish() {
+        stats.useless += prefetched.size();
+        prefetched.clear();
+        lru.clear();
+    }
+
+    void reset_stats() { stats = replay_stats(); }
+
+private:
+    struct pending_fill {
+        uint64_t cycle;
+        uint64_t address;
+        bool prefetch;
+        uint32_t metadata;
+
+        bool operator>(const pending_fill& other) const { return cycle > other.cycle; }
+    };
+
+    struct prefetched_line {
+        uint64_t ready_cycle;
+        bool lower_level;
+        std::list<uint64_t>::iterator position;
+    };
+
+    const replay_config config;
+    std::deque<tag_lookup_type> inflight_tag_check;
+    std::priority_queue<pending_fill, std::vector<pending_fill>, std::greater<pending_fill>> fills;
+    std::unordered_map<uint64_t, prefetched_line> prefetched;
+    std::list<uint64_t> lru;                    // Most recently prefetched first
+
+    void insert_prefetched(uint64_t line, prefetched_line entry) {
+        if (prefetched.size() >= config.prefetch_buffer_lines) {
+            prefetched.erase(lru.back());
+            lru.pop_back();
+            stats.useless++;
+        }
+        lru.push_front(line);
+        entry.position = lru.begin();
+        prefetched.emplace(line, entry);
+    }
+
+    void deliver_fill() {
+        pending_fill fill = fills.top();
+        fills.pop();
+        uint32_t set = static_cast<uint32_t>((fill.address >> LOG2_BLOCK_SIZE) % NUM_SET);
+        prefetcher_cache_fill(fill.address, set, 0, fill.prefetch, 0, fill.metadata);
+    }
+
+    // Tag check entries whose translation returned this cycle
+    void translate() {
+        for (tag_lookup_type& entry : inflight_tag_check) {
+            entry.is_translated = entry.is_translated || entry.translated_cycle <= current_cycle;
+        }
+    }
+
+    // Completed MSHR entries stay visible for the cycle they finish in, as in ChampSim. A tag check entry leaves once
+    // it is past its tag check and translated.
+    void retire() {
+        for (auto it = MSHR.begin(); it != MSHR.end();) {
+            it = it->event_cycle < current_cycle ? MSHR.erase(it) : it + 1;
+        }
+        while (!inflight_tag_check.empty() && inflight_tag_check.front().event_cycle < current_cycle
+               && inflight_tag_check.front().is_translated) {
+            inflight_tag_check.pop_front();
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,38 @@
+#!/bin/sh
+# Replays each module on the synthetic pattern it is built for (tools/synth_trace.cc) and fails if the module issues
+# no prefetches there. A module that cannot learn its own pattern has a broken address or training path, which the
+# quality numbers of a real trace would only show as a low coverage.
+# T-SKID links target PCs on loads still waiting for their translation, as at an L1D, so it is replayed with a
+# translation latency above the hit latency.
+#
+# Usage: sh tools/replay/check.sh [work dir]      (from the repository root, default work dir /tmp/replay_check)
+
+set -e
+
+WORK=${1:-/tmp/replay_check}
+CXX=${CXX:-g++}
+COUNT=200000
+
+mkdir -p "$WORK"
+$CXX -std=c++17 -O2 -pthread -o "$WORK/synth_trace" tools/synth_trace.cc
+
+failed=0
+# module source : pattern
+for check in T_SKID/t_skid.cc:skid T_SKID/t_skid.cc:stride TCP/TCP.cc:tag MISB/misb.cc:temporal; do
+    source=${check%%:*}
+    pattern=${check#*:}
+    module=$(basename "$source" .cc)
+    case $module in
+        t_skid) options="--translation-latency 30" ;;
+        *) options="" ;;
+    esac
+    [ -x "$WORK/replay_$module" ] || $CXX -std=c++17 -O2 -pthread -Itools/replay -o "$WORK/replay_$module" tools/replay/replay.cc "$source"
+    [ -f "$WORK/$pattern.l2t" ] || "$WORK/synth_trace" --pattern "$pattern" --count $COUNT --l2t "$WORK/$pattern.l2t" > /dev/null
+    if (cd "$WORK" && PF_STATS_PREFIX="$WORK/pf_stats" "./replay_$module" "$pattern.l2t" $options --expect-prefetches 1 > "$module.$pattern.log"); then
+        echo "ok      $module on $pattern"
+    else
+        echo "FAILED  $module on $pattern, see $WORK/$module.$pattern.log"
+        failed=1
+    fi
+done
+exit $failed
@@ -0,0 +1,77 @@
+#ifndef REPLAY_MSL_LRU_TABLE_H
+#define REPLAY_MSL_LRU_TABLE_H
+
+// Stand-in for ChampSim's champsim::msl::lru_table used by tools/replay: a set associative table with LRU
+// replacement, indexed by T::index() and matched on T::tag()
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace champsim::msl {
+
+template <typename T>
+class lru_table {
+public:
+    lru_table(std::size_t sets, std::size_t ways) : NUM_SET(sets), NUM_WAY(ways), blocks(sets * ways) {}
+
+    std::optional<T> check_hit(const T& elem) {
+        block* found = find(elem);
+        if (found == nullptr) {
+            return std::nullopt;
+        }
+        found->last_used = ++access_count;
+        return found->data;
+    }
+
+    void fill(const T& elem) {
+        block* victim = find(elem);
+        if (victim == nullptr) {
+            block* set = set_of(elem);
+            victim = set;
+            for (std::size_t way = 1; way < NUM_WAY && victim->valid; ++way) {
+                if (!set[way].valid || set[way].last_used < victim->last_used) {
+                    victim = &set[way];
+                }
+            }
+        }
+        *victim = {++access_count, elem, true};
+    }
+
+    std::optional<T> invalidate(const T& elem) {
+        block* found = find(elem);
+        if (found == nullptr) {
+            return std::nullopt;
+        }
+        found->valid = false;
+        return found->data;
+    }
+
+private:
+    struct block {
+        uint64_t last_used = 0;
+        T data{};
+        bool valid = false;
+    };
+
+    std::size_t NUM_SET;
+    std::size_t NUM_WAY;
+    uint64_t access_count = 0;
+    std::vector<block> blocks;
+
+    block* set_of(const T& elem) { return &blocks[(static_cast<std::size_t>(elem.index()) % NUM_SET) * NUM_WAY]; }
+
+    block* find(const T& elem) {
+        block* set = set_of(elem);
+        for (std::size_t way = 0; way < NUM_WAY; ++way) {
+            if (set[way].valid && set[way].data.tag() == elem.tag()) {
+                return &set[way];
+            }
+        }
+        return nullptr;
+    }
+};
+
+} // namespace champsim::msl
+
+#endif
@@ -0,0 +1,183 @@
+/*
+Trace replay harness for the prefetcher modules.
+
+Replays a packed L2 access trace (common/l2_trace.h, from the capture hook in lstm.cc or tools/l2clog_to_trace)
+through one prefetcher's hooks against the mock CACHE in tools/replay/cache.h, so an algorithm change can be tried
+in seconds instead of a full ChampSim run. Traces are best captured with no L2 prefetcher (CAPTURE/capture.cc), so
+the recorded misses are the ones a prefetcher has to cover.
+
+One binary per module, since every module defines the CACHE::prefetcher_* hooks:
+  g++ -std=c++17 -O2 -pthread -Itools/replay -o replay_tcp    tools/replay/replay.cc TCP/TCP.cc
+  g++ -std=c++17 -O2 -pthread -Itools/replay -o replay_misb   tools/replay/replay.cc MISB/misb.cc
+  g++ -std=c++17 -O2 -pthread -Itools/replay -o replay_tskid  tools/replay/replay.cc T_SKID/t_skid.cc
+  g++ -std=c++17 -O2 -pthread -Itools/replay -DLSTM_NATIVE_ONLY -o replay_lstm tools/replay/replay.cc LSTM/lstm.cc
+  g++ -std=c++17 -O2 -pthread -Itools/replay -o replay_ensemble tools/replay/replay.cc ENSEMBLE/ensemble.cc
+  g++ -std=c++17 -O2 -pthread -Itools/replay -o replay_oracle tools/replay/replay.cc ORACLE/oracle.cc
+  g++ -std=c++17 -O2 -pthread -Itools/replay -o replay_capture tools/replay/replay.cc CAPTURE/capture.cc
+To compare table geometries of TCP, MISB or T-SKID on one trace in a single run, see tools/replay/sweep.cc.
+
+Usage: replay_<module> <trace.l2t> [options]
+  --warmup N             accesses replayed before the statistics are reset (default 0)
+  --limit N              stop after N accesses, 0 replays the whole trace (default 0)
+  --sets N / --ways N    geometry reported to the module (default 1024 x 8)
+  --hit-latency N        (default 10)
+  --translation-latency N
+                         cycles before a tag check entry is translated, 0 as in ChampSim's L2; T-SKID only links
+                         target PCs on untranslated loads, so it needs more than the hit latency (default 0)
+  --miss-latency N       (default 200)
+  --lower-latency N      latency of a miss covered by a prefetch into the next level (default 40)
+  --mshr N               (default 32)
+  --pf-buffer N          prefetched lines held until used or evicted (default 1024)
+  --max-idle-cycles N    tick at most N cycles of a gap between accesses, 0 ticks every cycle (default 0)
+  --no-feedback          pass the recorded hit flag to the module even when a prefetch covered the miss
+  --expect-prefetches N  exit with status 2 if fewer than N prefetches were issued to either level, for scripted
+                         checks such as tools/replay/check.sh (default 0)
+*/
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "cache.h"
+#include "../../common/l2_trace.h"
+
+namespace {
+
+void usage(const char* name)
+{
+    std::cerr << "usage: " << name << " <trace.l2t> [--warmup N] [--limit N] [--sets N] [--ways N] [--hit-latency N]"
+              << " [--translation-latency N] [--miss-latency N] [--lower-latency N] [--mshr N] [--pf-buffer N] [--max-idle-cycles N] [--no-feedback]"
+              << " [--expect-prefetches N]\n";
+}
+
+double ratio(uint64_t num, uint64_t den)
+{
+    return den == 0 ? 0.0 : static_cast<double>(num) / static_cast<double>(den);
+}
+
+void print_report(const CACHE& cache, uint64_t replayed, double elapsed_ns)
+{
+    const replay_stats& stats = cache.stats;
+    uint64_t used = stats.timely_hits + stats.late_hits + stats.lower_hits;
+
+    std::cout << "----- Replay Results -----\n";
+    std::cout << "Accesses: " << stats.accesses << "\n";
+    std::cout << "Host ns Per Access: " << ratio(static_cast<uint64_t>(elapsed_ns), replayed) << "\n";
+    std::cout << "Recorded Misses: " << stats.recorded_misses << "\n";
+    std::cout << "Prefetch Requests: " << stats.prefetch_requests << "\n";
+    std::cout << "Prefetches Issued: " << stats.prefetches_issued << "\n";
+    std::cout << "Prefetches To Lower Level: " << stats.prefetches_lower << "\n";
+    std::cout << "Prefetches Dropped (MSHR Full): " << stats.prefetches_dropped << "\n";
+    std::cout << "Duplicate Prefetches: " << stats.prefetches_duplicate << "\n";
+    std::cout << "Timely Hits Caused: " << stats.timely_hits << "\n";
+    std::cout << "Late Prefetches: " << stats.late_hits << "\n";
+    std::cout << "Lower Level Hits: " << stats.lower_hits << "\n";
+    std::cout << "Prefetched Lines Already Cached: " << stats.already_cached << "\n";
+    std::cout << "Useless Prefetches: " << stats.useless << "\n";
+    std::cout << "Coverage: " << ratio(used, stats.recorded_misses) << "\n";
+    std::cout << "Accuracy: " << ratio(used, stats.prefetches_issued + stats.prefetches_lower) << "\n";
+    std::cout << "Baseline Mean Demand Latency: " << ratio(stats.baseline_latency, stats.accesses) << "\n";
+    std::cout << "Modeled Mean Demand Latency: " << ratio(stats.modeled_latency, stats.accesses) << "\n";
+    std::cout << "Demand Latency Saved: " << (stats.baseline_latency == 0 ? 0.0 : 1.0 - ratio(stats.modeled_latency, stats.baseline_latency)) << "\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    replay_config config;
+    uint64_t warmup = 0;
+    uint64_t limit = 0;
+    uint64_t max_idle_cycles = 0;
+    uint64_t expect_prefetches = 0;
+    bool feedback = true;
+
+    for (int i = 2; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "--no-feedback") {
+            feedback = false;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        uint64_t value = std::strtoull(argv[++i], nullptr, 0);
+        if (option == "--warmup") {
+            warmup = value;
+        } else if (option == "--limit") {
+            limit = value;
+        } else if (option == "--sets") {
+            config.sets = static_cast<uint32_t>(value);
+        } else if (option == "--ways") {
+            config.ways = static_cast<uint32_t>(value);
+        } else if (option == "--hit-latency") {
+            config.hit_latency = value;
+        } else if (option == "--translation-latency") {
+            config.translation_latency = value;
+        } else if (option == "--miss-latency") {
+            config.miss_latency = value;
+        } else if (option == "--lower-latency") {
+            config.lower_latency = value;
+        } else if (option == "--mshr") {
+            config.mshr_size = value;
+        } else if (option == "--pf-buffer") {
+            config.prefetch_buffer_lines = value;
+        } else if (option == "--max-idle-cycles") {
+            max_idle_cycles = value;
+        } else if (option == "--expect-prefetches") {
+            expect_prefetches = value;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (config.sets == 0 || config.ways == 0 || config.mshr_size == 0 || config.prefetch_buffer_lines == 0) {
+        std::cerr << "sets, ways, mshr and pf-buffer must be at least 1\n";
+        return 1;
+    }
+
+    l2_trace_reader trace;
+    if (!trace.open(argv[1])) {
+        std::cerr << "cannot read trace " << argv[1] << "\n";
+        return 1;
+    }
+    uint64_t total = limit == 0 ? trace.size() : std::min<uint64_t>(limit, trace.size());
+
+    CACHE cache("L2C", config);
+    cache.current_cycle = trace.first_cycle();
+    cache.warmup = warmup != 0;
+    cache.prefetcher_initialize();
+
+    uint64_t cycle = trace.first_cycle();
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < total; ++i) {
+        if (i == warmup && warmup != 0) {
+            cache.reset_stats();
+            cache.warmup = false;
+            start = std::chrono::steady_clock::now();
+        }
+        const l2_access_record& record = trace[i];
+        cycle += record.cycle_delta;
+        cache.advance_to(cycle, max_idle_cycles);
+        cache.replay_access(record.addr, record.ip, record.type, record.hit != 0, feedback);
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    cache.finish();
+
+    cache.prefetcher_final_stats();
+    print_report(cache, total > warmup ? total - warmup : 0, elapsed);
+    uint64_t prefetches = cache.stats.prefetches_issued + cache.stats.prefetches_lower;
+    if (prefetches < expect_prefetches) {
+        std::cerr << "expected at least " << expect_prefetches << " prefetches, " << prefetches << " were issued\n";
+        return 2;
+    }
+    return 0;
+}
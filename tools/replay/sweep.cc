@@ -0,0 +1,488 @@
+/*
+Single pass geometry sweep for the prefetcher components.
+
+Replays one packed L2 trace (common/l2_trace.h) through any number of shadow prefetchers at once, each with its own
+table geometry, its own mock CACHE (tools/replay/cache.h) and the same pipeline (common/pf_pipeline.h) as the module's
+own .cc: throttle, placement, issue and row filters and candidate queue.
+The trace is decoded once: a reader thread cuts it into batches and hands every batch to each shard through a
+lock-free single producer, single consumer queue. A shard is one thread running its share of the points, a whole
+batch per point at a time so that point's tables stay in cache. Every point sees exactly the access stream replay_<module>
+would give it, so a point's results match the standalone replay with the same geometry.
+
+Build (the components are header only, so no module .cc):
+  g++ -std=c++17 -O2 -pthread -Itools/replay -o sweep tools/replay/sweep.cc
+
+Usage: sweep <trace.l2t> [options] <point>...
+  A point is <module>[:key=value,...], keys left out keep the module's default:
+    tcp      rows (THT entries per row), sets (L1D sets), ways (PHT ways per set)
+    misb     ps_sets, ps_ways, sp_sets, sp_ways, run (keys per PS/SP entry, 1 to 16), distance and lookahead (metadata
+             lookahead distance and structural addresses, lookahead=0 turns it off), bloom_bits
+    t_skid   tracker_sets, tracker_ways, target_sets, target_ways, pred_sets, pred_ways, ipt, degree, rrpcq
+  e.g. sweep trace.l2t tcp tcp:rows=8 tcp:rows=16,ways=4 misb:ps_sets=256,sp_sets=256
+
+  --points FILE          more points, one per line, # starts a comment
+  --threads N            shards, 0 uses every core (default 0)
+  --csv FILE             also write the results as CSV
+  --component-stats      run each point's final stats too (cache named L2C_<n>, n the point's position)
+  --warmup, --limit, --sets, --ways, --hit-latency, --translation-latency, --miss-latency, --lower-latency, --mshr,
+  --pf-buffer, --max-idle-cycles and --no-feedback as in tools/replay/replay.cc
+*/
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "cache.h"
+#include "../../common/l2_trace.h"
+#include "../../common/pf_pipeline.h"
+#include "../../MISB/misb.h"
+#include "../../TCP/tcp.h"
+#include "../../T_SKID/t_skid.h"
+
+namespace {
+
+const std::size_t Batch_events = 4096;              // Accesses per batch handed to the shards
+const std::size_t Queue_batches = 64;               // Batches in flight per shard (power of two)
+
+// One decoded access, the cycle is absolute
+struct sweep_event {
+    uint64_t addr;
+    uint64_t ip;
+    uint64_t cycle;
+    uint8_t type;
+    bool hit;
+    bool roi_start;                                 // First access after warmup
+};
+
+using event_batch = std::vector<sweep_event>;
+
+// Lock-free ring from the reader to one shard. A null batch ends the stream.
+class batch_queue {
+public:
+    void push(std::shared_ptr<const event_batch> batch) {
+        std::size_t t = tail.load(std::memory_order_relaxed);
+        while (t - head.load(std::memory_order_acquire) == Queue_batches) {
+            std::this_thread::yield();
+        }
+        slots[t & (Queue_batches - 1)] = std::move(batch);
+        tail.store(t + 1, std::memory_order_release);
+    }
+
+    std::shared_ptr<const event_batch> pop() {
+        std::size_t h = head.load(std::memory_order_relaxed);
+        while (tail.load(std::memory_order_acquire) == h) {
+            std::this_thread::yield();
+        }
+        std::shared_ptr<const event_batch> batch = std::move(slots[h & (Queue_batches - 1)]);
+        head.store(h + 1, std::memory_order_release);
+        return batch;
+    }
+
+private:
+    std::array<std::shared_ptr<const event_batch>, Queue_batches> slots;
+    alignas(64) std::atomic<std::size_t> head{0};   // Next slot the shard reads
+    alignas(64) std::atomic<std::size_t> tail{0};   // Next slot the reader writes
+};
+
+// One shadow prefetcher and the cache it runs against
+struct sweep_point {
+    std::string label;
+    std::unique_ptr<pf_component> component;
+    std::unique_ptr<CACHE> cache;
+    pf_pipeline pipeline;
+
+    sweep_point(std::string label_, const std::string& module, std::unique_ptr<pf_component> component_)
+        : label(std::move(label_)), component(std::move(component_)), pipeline(module, false, component->quality_stats()) {}
+};
+
+// Read only once the shards start, so every shard can look its caches up without locking
+std::unordered_map<const CACHE*, sweep_point*> points_by_cache;
+
+sweep_point& point_of(const CACHE* cache) { return *points_by_cache.at(cache); }
+
+void usage(const char* name)
+{
+    std::cerr << "usage: " << name << " <trace.l2t> [--points FILE] [--threads N] [--csv FILE] [--component-stats] [--warmup N] [--limit N]"
+              << " [--sets N] [--ways N] [--hit-latency N] [--translation-latency N] [--miss-latency N] [--lower-latency N] [--mshr N] [--pf-buffer N]"
+              << " [--max-idle-cycles N] [--no-feedback] <module[:key=value,...]>...\n";
+}
+
+double ratio(uint64_t num, uint64_t den)
+{
+    return den == 0 ? 0.0 : static_cast<double>(num) / static_cast<double>(den);
+}
+
+// Builds the prefetcher a point describes, or returns null with the reason in error
+std::unique_ptr<sweep_point> parse_point(const std::string& text, std::string& error)
+{
+    std::string module = text.substr(0, text.find(':'));
+    std::vector<std::pair<std::string, uint64_t>> settings;
+    if (module.size() < text.size()) {
+        std::stringstream list(text.substr(module.size() + 1));
+        std::string item;
+        while (std::getline(list, item, ',')) {
+            std::size_t equals = item.find('=');
+            if (equals == std::string::npos || equals + 1 == item.size()) {
+                error = "expected key=value, got '" + item + "'";
+                return nullptr;
+            }
+            settings.emplace_back(item.substr(0, equals), std::strtoull(item.c_str() + equals + 1, nullptr, 0));
+        }
+    }
+
+    auto unknown = [&](const std::string& key) {
+        error = "unknown " + module + " setting '" + key + "'";
+        return nullptr;
+    };
+
+    if (module == "tcp") {
+        tcp::Geometry geometry;
+        for (const auto& [key, value] : settings) {
+            int v = static_cast<int>(value);
+            if (key == "rows") {
+                geometry.entriesPerRow_THT = v;
+            } else if (key == "sets") {
+                geometry.sets_L1D = v;
+            } else if (key == "ways") {
+                geometry.waysPerSet_PHT = v;
+            } else {
+                return unknown(key);
+            }
+        }
+        if (geometry.entriesPerRow_THT < 1 || geometry.sets_L1D < 1 || geometry.waysPerSet_PHT < 1) {
+            error = "tcp needs rows, sets and ways of at least 1";
+            return nullptr;
+        }
+        return std::make_unique<sweep_point>(text, module, std::make_unique<tcp::DynamicTagCorrelatingPrefetcher>("tcp", geometry));
+    }
+    if (module == "misb") {
+        misb::geometry geometry;
+        for (const auto& [key, value] : settings) {
+            uint32_t v = static_cast<uint32_t>(value);
+            if (key == "ps_sets") {
+                geometry.ps_sets = v;
+            } else if (key == "ps_ways") {
+                geometry.ps_ways = v;
+            } else if (key == "sp_sets") {
+                geometry.sp_sets = v;
+            } else if (key == "sp_ways") {
+                geometry.sp_ways = v;
+            } else if (key == "run") {
+                geometry.run_length = v;
+            } else if (key == "distance") {
+                geometry.lookahead_distance = v;
+            } else if (key == "lookahead") {
+                geometry.lookahead_keys = v;
+            } else if (key == "bloom_bits") {
+                geometry.bloom_bits = static_cast<int>(value);
+            } else {
+                return unknown(key);
+            }
+        }
+        if (geometry.ps_sets == 0 || geometry.ps_ways == 0 || geometry.sp_sets == 0 || geometry.sp_ways == 0 || geometry.bloom_bits < 1
+            || geometry.run_length == 0 || geometry.run_length > 16) {
+            error = "misb sizes must be at least 1, and run at most 16";
+            return nullptr;
+        }
+        return std::make_unique<sweep_point>(text, module, std::make_unique<misb::dynamic_prefetcher>("misb", geometry));
+    }
+    if (module == "t_skid") {
+        t_skid::tracker::geometry geometry;
+        for (const auto& [key, value] : settings) {
+            if (key == "tracker_sets") {
+                geometry.tracker_sets = value;
+            } else if (key == "tracker_ways") {
+                geometry.tracker_ways = value;
+            } else if (key == "target_sets") {
+                geometry.target_table_sets = value;
+            } else if (key == "target_ways") {
+                geometry.target_table_ways = value;
+            } else if (key == "pred_sets") {
+                geometry.addr_pred_table_sets = value;
+            } else if (key == "pred_ways") {
+                geometry.addr_pred_table_ways = value;
+            } else if (key == "ipt") {
+                geometry.ipt_size = value;
+            } else if (key == "degree") {
+                geometry.prefetch_degree = static_cast<int>(value);
+            } else if (key == "rrpcq") {
+                geometry.rrpcq_size = value;
+            } else {
+                return unknown(key);
+            }
+        }
+        if (geometry.tracker_sets == 0 || geometry.tracker_ways == 0 || geometry.target_table_sets == 0 || geometry.target_table_ways == 0
+            || geometry.addr_pred_table_sets == 0 || geometry.addr_pred_table_ways == 0 || geometry.ipt_size == 0 || geometry.prefetch_degree < 1
+            || geometry.prefetch_degree >= (1 << t_skid::tracker::DEGREE_BITS)) {
+            error = "t_skid table sets, ways, ipt and degree must be at least 1, and degree below 16";
+            return nullptr;
+        }
+        return std::make_unique<sweep_point>(text, module, std::make_unique<t_skid::tracker>("t_skid", geometry));
+    }
+    error = "unknown module '" + module + "', expected tcp, misb or t_skid";
+    return nullptr;
+}
+
+void run_shard(const std::vector<sweep_point*>& points, batch_queue& queue, uint64_t max_idle_cycles, bool feedback)
+{
+    while (std::shared_ptr<const event_batch> batch = queue.pop()) {
+        for (sweep_point* point : points) {
+            CACHE& cache = *point->cache;
+            for (const sweep_event& e : *batch) {
+                if (e.roi_start) {
+                    cache.reset_stats();
+                    cache.warmup = false;
+                }
+                cache.advance_to(e.cycle, max_idle_cycles);
+                cache.replay_access(e.addr, e.ip, e.type, e.hit, feedback);
+            }
+        }
+    }
+}
+
+void print_results(const std::vector<std::unique_ptr<sweep_point>>& points, std::ostream& out, bool csv)
+{
+    const char* sep = csv ? "," : " | ";
+    out << (csv ? "" : "----- Sweep Results -----\n");
+    out << "Point" << sep << "Issued" << sep << "To Lower Level" << sep << "Timely" << sep << "Late" << sep << "Lower Level Hits" << sep
+        << "Useless" << sep << "Coverage" << sep << "Accuracy" << sep << "Demand Latency Saved\n";
+    for (const auto& point : points) {
+        const replay_stats& s = point->cache->stats;
+        uint64_t used = s.timely_hits + s.late_hits + s.lower_hits;
+        double saved = s.baseline_latency == 0 ? 0.0 : 1.0 - ratio(s.modeled_latency, s.baseline_latency);
+        out << (csv ? "\"" + point->label + "\"" : point->label) << sep << s.prefetches_issued << sep << s.prefetches_lower << sep
+            << s.timely_hits << sep << s.late_hits << sep << s.lower_hits << sep << s.useless << sep << ratio(used, s.recorded_misses) << sep
+            << ratio(used, s.prefetches_issued + s.prefetches_lower) << sep << saved << "\n";
+    }
+}
+
+} // namespace
+
+// The points stand in for the module, each hook goes to the point that owns the cache
+void CACHE::prefetcher_initialize()
+{
+    sweep_point& point = point_of(this);
+    point.component->initialize(this);
+    point.component->throttle(point.pipeline.level());
+}
+
+uint32_t CACHE::prefetcher_cache_operate(uint64_t addr, uint64_t ip, uint8_t cache_hit, bool useful_prefetch, uint8_t type, uint32_t metadata_in)
+{
+    sweep_point& point = point_of(this);
+    if (point.pipeline.on_access(this, addr, cache_hit, useful_prefetch)) {
+        point.component->throttle(point.pipeline.level());
+    }
+    pf_pipeline::issuer issuer(point.pipeline, this, addr, ip);
+    point.component->operate(this, addr, ip, cache_hit, useful_prefetch, type, metadata_in, issuer);
+    return metadata_in;
+}
+
+uint32_t CACHE::prefetcher_cache_fill(uint64_t addr, uint32_t, uint32_t, uint8_t prefetch, uint64_t evicted_addr, uint32_t metadata_in)
+{
+    sweep_point& point = point_of(this);
+    point.pipeline.on_fill(addr, prefetch, evicted_addr);
+    point.component->fill(this, addr, prefetch, evicted_addr);
+    return metadata_in;
+}
+
+void CACHE::prefetcher_cycle_operate()
+{
+    sweep_point& point = point_of(this);
+    point.component->cycle(this);
+    point.pipeline.cycle(this);
+}
+
+void CACHE::prefetcher_final_stats()
+{
+    sweep_point& point = point_of(this);
+    std::cout << "===== " << NAME << ": " << point.label << " =====\n";
+    point.component->final_stats(this);
+    point.pipeline.report(NAME);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    replay_config config;
+    uint64_t warmup = 0;
+    uint64_t limit = 0;
+    uint64_t max_idle_cycles = 0;
+    unsigned threads = 0;
+    bool feedback = true;
+    bool component_stats = false;
+    std::string csv_path;
+    std::vector<std::string> point_texts;
+
+    for (int i = 2; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option.rfind("--", 0) != 0) {
+            point_texts.push_back(option);
+            continue;
+        }
+        if (option == "--no-feedback") {
+            feedback = false;
+            continue;
+        }
+        if (option == "--component-stats") {
+            component_stats = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        std::string argument = argv[++i];
+        uint64_t value = std::strtoull(argument.c_str(), nullptr, 0);
+        if (option == "--points") {
+            std::ifstream file(argument);
+            if (!file) {
+                std::cerr << "cannot read points file " << argument << "\n";
+                return 1;
+            }
+            std::string line;
+            while (std::getline(file, line)) {
+                line = line.substr(0, line.find('#'));
+                std::stringstream words(line);
+                std::string word;
+                while (words >> word) {
+                    point_texts.push_back(word);
+                }
+            }
+        } else if (option == "--csv") {
+            csv_path = argument;
+        } else if (option == "--threads") {
+            threads = static_cast<unsigned>(value);
+        } else if (option == "--warmup") {
+            warmup = value;
+        } else if (option == "--limit") {
+            limit = value;
+        } else if (option == "--sets") {
+            config.sets = static_cast<uint32_t>(value);
+        } else if (option == "--ways") {
+            config.ways = static_cast<uint32_t>(value);
+        } else if (option == "--hit-latency") {
+            config.hit_latency = value;
+        } else if (option == "--translation-latency") {
+            config.translation_latency = value;
+        } else if (option == "--miss-latency") {
+            config.miss_latency = value;
+        } else if (option == "--lower-latency") {
+            config.lower_latency = value;
+        } else if (option == "--mshr") {
+            config.mshr_size = value;
+        } else if (option == "--pf-buffer") {
+            config.prefetch_buffer_lines = value;
+        } else if (option == "--max-idle-cycles") {
+            max_idle_cycles = value;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (point_texts.empty()) {
+        std::cerr << "no points to sweep\n";
+        usage(argv[0]);
+        return 1;
+    }
+    if (config.sets == 0 || config.ways == 0 || config.mshr_size == 0 || config.prefetch_buffer_lines == 0) {
+        std::cerr << "sets, ways, mshr and pf-buffer must be at least 1\n";
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<sweep_point>> points;
+    for (const std::string& text : point_texts) {
+        std::string error;
+        std::unique_ptr<sweep_point> point = parse_point(text, error);
+        if (!point) {
+            std::cerr << "bad point " << text << ": " << error << "\n";
+            return 1;
+        }
+        points.push_back(std::move(point));
+    }
+
+    l2_trace_reader trace;
+    if (!trace.open(argv[1])) {
+        std::cerr << "cannot read trace " << argv[1] << "\n";
+        return 1;
+    }
+    uint64_t total = limit == 0 ? trace.size() : std::min<uint64_t>(limit, trace.size());
+
+    for (std::size_t n = 0; n < points.size(); ++n) {
+        sweep_point& point = *points[n];
+        point.cache = std::make_unique<CACHE>("L2C_" + std::to_string(n), config);
+        points_by_cache[point.cache.get()] = &point;
+        point.cache->current_cycle = trace.first_cycle();
+        point.cache->warmup = warmup != 0;
+        point.cache->prefetcher_initialize();
+    }
+
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = static_cast<unsigned>(std::min<std::size_t>(threads, points.size()));
+    std::vector<std::vector<sweep_point*>> shards(threads);
+    for (std::size_t n = 0; n < points.size(); ++n) {
+        shards[n % threads].push_back(points[n].get());
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<batch_queue> queues(threads);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back(run_shard, std::cref(shards[t]), std::ref(queues[t]), max_idle_cycles, feedback);
+    }
+
+    uint64_t cycle = trace.first_cycle();
+    for (uint64_t i = 0; i < total;) {
+        auto batch = std::make_shared<event_batch>();
+        batch->reserve(Batch_events);
+        for (; i < total && batch->size() < Batch_events; ++i) {
+            const l2_access_record& record = trace[i];
+            cycle += record.cycle_delta;
+            batch->push_back({record.addr, record.ip, cycle, record.type, record.hit != 0, i == warmup && warmup != 0});
+        }
+        std::shared_ptr<const event_batch> shared = std::move(batch);
+        for (batch_queue& queue : queues) {
+            queue.push(shared);
+        }
+    }
+    for (batch_queue& queue : queues) {
+        queue.push(nullptr);
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (const auto& point : points) {
+        point->cache->finish();
+        if (component_stats) {
+            point->cache->prefetcher_final_stats();
+        }
+    }
+
+    std::cout << "Accesses: " << total << ", Points: " << points.size() << ", Shards: " << threads << ", Seconds: " << elapsed_s << "\n";
+    print_results(points, std::cout, false);
+    if (!csv_path.empty()) {
+        std::ofstream csv(csv_path);
+        print_results(points, csv, true);
+        if (!csv) {
+            std::cerr << "cannot write " << csv_path << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
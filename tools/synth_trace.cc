@@ -0,0 +1,445 @@
+/*
+Synthetic access pattern generator for evaluating the prefetchers on one behaviour at a time.
+
+Each pattern is aimed at the prefetcher built for it:
+  stride     constant or multi-stride loops over a fixed footprint                  (T-SKID, LSTM deltas)
+  tag        repeating sequence of tags (pages) with a configurable period           (TCP)
+  temporal   per-PC streams over irregular addresses that repeat                     (MISB)
+  skid       trigger/target PC pairs, the target access skid cycles after its trigger (T-SKID)
+  mix        weighted mixture of the above, e.g. --mix stride:1,tag:1,temporal:2
+
+Outputs, any combination:
+  --l2t FILE        packed L2 access stream (common/l2_trace.h), for tools/replay and NN_train2.py --input
+  --champsim FILE   ChampSim input_instr trace, compressed through xz when FILE ends in .xz
+
+In the L2 stream the hit flag comes from an LRU model of --cache-lines lines. In the ChampSim trace every access is
+a load, and non-memory instructions fill the cycles between accesses (one per cycle, at most --max-filler).
+Output is deterministic for a given set of options and --seed.
+
+Build:  g++ -std=c++17 -O2 -pthread -o synth_trace tools/synth_trace.cc
+Usage:  synth_trace --pattern stride --count 1000000 --l2t stride.l2t --champsim stride.champsimtrace.xz
+
+Options (defaults in brackets):
+  --pattern NAME      stride, tag, temporal, skid or mix [stride]
+  --count N           accesses to generate [1000000]
+  --seed N            [1]
+  --gap N             cycles between accesses [20]
+  --strides LIST      comma separated line strides, cycled in order [1]
+  --footprint N       lines a stride loop covers before it wraps [65536]
+  --period N          tags in the repeating tag sequence, period x 64 lines is the footprint [512]
+  --pcs N             temporal streams / trigger-target pairs [8]
+  --stream-length N   addresses per temporal stream before it repeats [4096]
+  --skid N            cycles from a trigger access to its target [200]
+  --mix LIST          pattern:weight pairs for --pattern mix [stride:1,tag:1,temporal:1,skid:1]
+  --cache-lines N     lines in the LRU model that sets the hit flag [16384]
+  --max-filler N      most filler instructions between two accesses [64]
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../common/l2_trace.h"
+
+namespace {
+
+constexpr unsigned LOG2_BLOCK_SIZE = 6;
+constexpr unsigned LOG2_PAGE_SIZE = 12;
+
+struct options {
+    std::string pattern = "stride";
+    uint64_t count = 1000000;
+    uint64_t seed = 1;
+    uint64_t gap = 20;
+    std::vector<int64_t> strides = {1};
+    uint64_t footprint = 65536;
+    uint64_t period = 512;
+    uint64_t pcs = 8;
+    uint64_t stream_length = 4096;
+    uint64_t skid = 200;
+    std::string mix = "stride:1,tag:1,temporal:1,skid:1";
+    uint64_t cache_lines = 16384;
+    uint64_t max_filler = 64;
+    std::string l2t_path;
+    std::string champsim_path;
+};
+
+struct access_event {
+    uint64_t cycle;
+    uint64_t sequence;                              // Keeps events of the same cycle in the order they were made
+    uint64_t ip;
+    uint64_t addr;
+
+    bool operator>(const access_event& other) const {
+        return cycle != other.cycle ? cycle > other.cycle : sequence > other.sequence;
+    }
+};
+
+using event_queue = std::priority_queue<access_event, std::vector<access_event>, std::greater<access_event>>;
+
+// A pattern adds the accesses it makes at cycle to the queue, possibly some for later cycles
+class pattern_source {
+public:
+    virtual ~pattern_source() = default;
+    virtual void emit(uint64_t cycle, std::mt19937_64& rng, event_queue& queue, uint64_t& sequence) = 0;
+};
+
+// Each pattern gets its own region of the address space and of the PCs, so mixed streams do not alias
+uint64_t region_base(int region) { return (static_cast<uint64_t>(region) + 1) << 36; }
+uint64_t region_ip(int region) { return 0x400000 + (static_cast<uint64_t>(region) << 16); }
+
+class stride_source : public pattern_source {
+public:
+    stride_source(int region, const std::vector<int64_t>& strides_, uint64_t footprint_)
+        : base(region_base(region)), ip(region_ip(region)), strides(strides_), footprint(footprint_) {}
+
+    void emit(uint64_t cycle, std::mt19937_64&, event_queue& queue, uint64_t& sequence) override {
+        queue.push({cycle, sequence++, ip + 4 * next_stride, base + (line << LOG2_BLOCK_SIZE)});
+        int64_t stride = strides[next_stride];
+        next_stride = (next_stride + 1) % strides.size();
+        line = static_cast<uint64_t>((static_cast<int64_t>(line) + stride) % static_cast<int64_t>(footprint) + static_cast<int64_t>(footprint)) % footprint;
+    }
+
+private:
+    uint64_t base;
+    uint64_t ip;
+    std::vector<int64_t> strides;
+    uint64_t footprint;
+    uint64_t line = 0;
+    std::size_t next_stride = 0;
+};
+
+// Tag = page number: the sequence of pages repeats every period accesses while the line within the page walks forward
+class tag_source : public pattern_source {
+public:
+    tag_source(int region, uint64_t period, std::mt19937_64& rng) : ip(region_ip(region)) {
+        std::uniform_int_distribution<uint64_t> page(0, (uint64_t{1} << 24) - 1);
+        for (uint64_t i = 0; i < period; ++i) {
+            tags.push_back((region_base(region) >> LOG2_PAGE_SIZE) + page(rng));
+        }
+    }
+
+    void emit(uint64_t cycle, std::mt19937_64&, event_queue& queue, uint64_t& sequence) override {
+        uint64_t lines_per_page = uint64_t{1} << (LOG2_PAGE_SIZE - LOG2_BLOCK_SIZE);
+        uint64_t tag = tags[step % tags.size()];
+        uint64_t index = (step / tags.size()) % lines_per_page;
+        queue.push({cycle, sequence++, ip, (tag << LOG2_PAGE_SIZE) | (index << LOG2_BLOCK_SIZE)});
+        step++;
+    }
+
+private:
+    uint64_t ip;
+    std::vector<uint64_t> tags;
+    uint64_t step = 0;
+};
+
+// Every PC replays its own fixed list of random lines; which PC runs next is random
+class temporal_source : public pattern_source {
+public:
+    temporal_source(int region, uint64_t pcs, uint64_t length, std::mt19937_64& rng) : base_ip(region_ip(region)) {
+        std::uniform_int_distribution<uint64_t> line(0, (uint64_t{1} << 28) - 1);
+        streams.resize(pcs);
+        for (auto& stream : streams) {
+            for (uint64_t i = 0; i < length; ++i) {
+                stream.push_back(region_base(region) + (line(rng) << LOG2_BLOCK_SIZE));
+            }
+        }
+        position.assign(pcs, 0);
+    }
+
+    void emit(uint64_t cycle, std::mt19937_64& rng, event_queue& queue, uint64_t& sequence) override {
+        std::uniform_int_distribution<std::size_t> pick(0, streams.size() - 1);
+        std::size_t pc = pick(rng);
+        queue.push({cycle, sequence++, base_ip + 4 * pc, streams[pc][position[pc]]});
+        position[pc] = (position[pc] + 1) % streams[pc].size();
+    }
+
+private:
+    uint64_t base_ip;
+    std::vector<std::vector<uint64_t>> streams;
+    std::vector<std::size_t> position;
+};
+
+// A trigger PC touches its own line, and skid cycles later the paired target PC makes its next strided access
+class skid_source : public pattern_source {
+public:
+    skid_source(int region, uint64_t pairs, uint64_t skid_) : base_ip(region_ip(region)), base(region_base(region)), skid(skid_) {
+        next_target.assign(pairs, 0);
+    }
+
+    void emit(uint64_t cycle, std::mt19937_64& rng, event_queue& queue, uint64_t& sequence) override {
+        std::uniform_int_distribution<std::size_t> pick(0, next_target.size() - 1);
+        std::size_t pair = pick(rng);
+        uint64_t pair_base = base + (uint64_t{pair} << 30);
+        queue.push({cycle, sequence++, base_ip + 8 * pair, pair_base + ((next_target[pair] % 64) << LOG2_BLOCK_SIZE)});
+        uint64_t target_line = (next_target[pair] * (pair + 1)) % (uint64_t{1} << 20);
+        queue.push({cycle + skid, sequence++, base_ip + 8 * pair + 4, pair_base + (uint64_t{1} << 26) + (target_line << LOG2_BLOCK_SIZE)});
+        next_target[pair]++;
+    }
+
+private:
+    uint64_t base_ip;
+    uint64_t base;
+    uint64_t skid;
+    std::vector<uint64_t> next_target;
+};
+
+std::unique_ptr<pattern_source> make_source(const std::string& name, int region, const options& opt, std::mt19937_64& rng)
+{
+    if (name == "stride") {
+        return std::make_unique<stride_source>(region, opt.strides, opt.footprint);
+    }
+    if (name == "tag") {
+        return std::make_unique<tag_source>(region, opt.period, rng);
+    }
+    if (name == "temporal") {
+        return std::make_unique<temporal_source>(region, opt.pcs, opt.stream_length, rng);
+    }
+    if (name == "skid") {
+        return std::make_unique<skid_source>(region, opt.pcs, opt.skid);
+    }
+    return nullptr;
+}
+
+// Fully associative LRU of cache_lines lines, decides the hit flag of the L2 stream
+class lru_model {
+public:
+    explicit lru_model(uint64_t capacity_) : capacity(capacity_) {}
+
+    bool access(uint64_t line) {
+        auto found = lines.find(line);
+        if (found != lines.end()) {
+            order.splice(order.begin(), order, found->second);
+            return true;
+        }
+        if (lines.size() >= capacity) {
+            lines.erase(order.back());
+            order.pop_back();
+        }
+        order.push_front(line);
+        lines[line] = order.begin();
+        return false;
+    }
+
+private:
+    uint64_t capacity;
+    std::list<uint64_t> order;
+    std::unordered_map<uint64_t, std::list<uint64_t>::iterator> lines;
+};
+
+// ChampSim's trace_instr_format.h input_instr
+struct input_instr {
+    uint64_t ip = 0;
+    uint8_t is_branch = 0;
+    uint8_t branch_taken = 0;
+    uint8_t destination_registers[2] = {};
+    uint8_t source_registers[4] = {};
+    uint64_t destination_memory[2] = {};
+    uint64_t source_memory[4] = {};
+};
+
+static_assert(sizeof(input_instr) == 64, "ChampSim reads 64 byte input_instr records");
+
+class champsim_writer {
+public:
+    bool open(const std::string& path, uint64_t max_filler_) {
+        max_filler = max_filler_;
+        compressed = path.size() > 3 && path.compare(path.size() - 3, 3, ".xz") == 0;
+        file = compressed ? popen(("xz -c > '" + path + "'").c_str(), "w") : std::fopen(path.c_str(), "wb");
+        return file != nullptr;
+    }
+
+    ~champsim_writer() {
+        if (file != nullptr) {
+            compressed ? pclose(file) : std::fclose(file);
+        }
+    }
+
+    // One load, preceded by a filler instruction for each idle cycle since the previous load
+    void load(uint64_t cycle, uint64_t ip, uint64_t addr) {
+        uint64_t idle = cycle > last_cycle + 1 ? cycle - last_cycle - 1 : 0;
+        for (uint64_t i = 0; i < std::min(idle, max_filler); ++i) {
+            input_instr filler;
+            filler.ip = filler_ip;
+            filler.destination_registers[0] = 3;
+            filler.source_registers[0] = 3;
+            write(filler);
+            filler_ip = filler_ip + 4 < 0x100000 + 4096 ? filler_ip + 4 : 0x100000;
+        }
+        input_instr instr;
+        instr.ip = ip;
+        instr.destination_registers[0] = 2;
+        instr.source_registers[0] = 1;
+        instr.source_memory[0] = addr;
+        write(instr);
+        last_cycle = cycle;
+    }
+
+    uint64_t instructions = 0;
+
+private:
+    std::FILE* file = nullptr;
+    bool compressed = false;
+    uint64_t max_filler = 0;
+    uint64_t last_cycle = 0;
+    uint64_t filler_ip = 0x100000;
+
+    void write(const input_instr& instr) {
+        std::fwrite(&instr, sizeof(instr), 1, file);
+        instructions++;
+    }
+};
+
+std::vector<std::string> split(const std::string& text, char separator)
+{
+    std::vector<std::string> parts;
+    std::stringstream stream(text);
+    std::string part;
+    while (std::getline(stream, part, separator)) {
+        if (!part.empty()) {
+            parts.push_back(part);
+        }
+    }
+    return parts;
+}
+
+bool parse_options(int argc, char** argv, options& opt)
+{
+    for (int i = 1; i < argc; i += 2) {
+        if (i + 1 >= argc) {
+            return false;
+        }
+        std::string option = argv[i];
+        std::string value = argv[i + 1];
+        uint64_t number = std::strtoull(value.c_str(), nullptr, 0);
+        if (option == "--pattern") {
+            opt.pattern = value;
+        } else if (option == "--count") {
+            opt.count = number;
+        } else if (option == "--seed") {
+            opt.seed = number;
+        } else if (option == "--gap") {
+            opt.gap = number;
+        } else if (option == "--strides") {
+            opt.strides.clear();
+            for (const std::string& stride : split(value, ',')) {
+                opt.strides.push_back(std::strtoll(stride.c_str(), nullptr, 0));
+            }
+        } else if (option == "--footprint") {
+            opt.footprint = number;
+        } else if (option == "--period") {
+            opt.period = number;
+        } else if (option == "--pcs") {
+            opt.pcs = number;
+        } else if (option == "--stream-length") {
+            opt.stream_length = number;
+        } else if (option == "--skid") {
+            opt.skid = number;
+        } else if (option == "--mix") {
+            opt.mix = value;
+        } else if (option == "--cache-lines") {
+            opt.cache_lines = number;
+        } else if (option == "--max-filler") {
+            opt.max_filler = number;
+        } else if (option == "--l2t") {
+            opt.l2t_path = value;
+        } else if (option == "--champsim") {
+            opt.champsim_path = value;
+        } else {
+            return false;
+        }
+    }
+    return !opt.strides.empty() && opt.footprint > 0 && opt.period > 0 && opt.pcs > 0 && opt.stream_length > 0 && opt.cache_lines > 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    options opt;
+    if (!parse_options(argc, argv, opt) || (opt.l2t_path.empty() && opt.champsim_path.empty())) {
+        std::cerr << "usage: " << argv[0] << " --pattern stride|tag|temporal|skid|mix --count N [--l2t FILE] [--champsim FILE] [options]\n"
+                  << "see the comment at the top of tools/synth_trace.cc for the pattern options\n";
+        return 1;
+    }
+
+    std::mt19937_64 rng(opt.seed);
+    std::vector<std::unique_ptr<pattern_source>> sources;
+    std::vector<double> weights;
+    std::vector<std::pair<std::string, double>> parts;
+    if (opt.pattern == "mix") {
+        for (const std::string& item : split(opt.mix, ',')) {
+            std::size_t colon = item.find(':');
+            parts.push_back({item.substr(0, colon), colon == std::string::npos ? 1.0 : std::strtod(item.c_str() + colon + 1, nullptr)});
+        }
+    } else {
+        parts.push_back({opt.pattern, 1.0});
+    }
+    for (std::size_t i = 0; i < parts.size(); ++i) {
+        std::unique_ptr<pattern_source> source = make_source(parts[i].first, static_cast<int>(i), opt, rng);
+        if (!source || parts[i].second <= 0.0) {
+            std::cerr << "unknown pattern or weight: " << parts[i].first << "\n";
+            return 1;
+        }
+        sources.push_back(std::move(source));
+        weights.push_back(parts[i].second);
+    }
+    std::discrete_distribution<std::size_t> pick_source(weights.begin(), weights.end());
+
+    l2_trace_writer l2t;
+    if (!opt.l2t_path.empty() && !l2t.open(opt.l2t_path)) {
+        std::cerr << "cannot create " << opt.l2t_path << "\n";
+        return 1;
+    }
+    champsim_writer champsim;
+    if (!opt.champsim_path.empty() && !champsim.open(opt.champsim_path, opt.max_filler)) {
+        std::cerr << "cannot create " << opt.champsim_path << "\n";
+        return 1;
+    }
+
+    lru_model cache(opt.cache_lines);
+    uint64_t hits = 0;
+    auto write = [&](const access_event& event) {
+        bool hit = cache.access(event.addr >> LOG2_BLOCK_SIZE);
+        hits += hit;
+        if (!opt.l2t_path.empty()) {
+            l2t.append(event.addr, event.ip, event.cycle, 0, hit);
+        }
+        if (!opt.champsim_path.empty()) {
+            champsim.load(event.cycle, event.ip, event.addr);
+        }
+    };
+
+    // Sources are asked for accesses gap cycles apart; whatever has come due by then is written in cycle order
+    event_queue queue;
+    uint64_t sequence = 0;
+    uint64_t written = 0;
+    for (uint64_t cycle = opt.gap; written < opt.count; cycle += opt.gap) {
+        sources[pick_source(rng)]->emit(cycle, rng, queue, sequence);
+        while (!queue.empty() && queue.top().cycle <= cycle && written < opt.count) {
+            write(queue.top());
+            queue.pop();
+            written++;
+        }
+    }
+
+    l2t.close();
+    std::cout << "Accesses: " << written << "\n";
+    std::cout << "Hit Rate: " << (written == 0 ? 0.0 : static_cast<double>(hits) / written) << "\n";
+    if (!opt.champsim_path.empty()) {
+        std::cout << "ChampSim Instructions: " << champsim.instructions << "\n";
+    }
+    return 0;
+}